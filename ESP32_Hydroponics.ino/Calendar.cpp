@@ -0,0 +1,417 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * Calendar.cpp
+ *
+ * Weekkalender met vensters per weekdag, elk met een eigen AAN/UIT-tijd
+ * (en doelvolume in volume modus). Een actief venster gaat voor de
+ * dag- en nachtcyclus; buiten de vensters geldt de normale regeling.
+ *
+ * Bij elke wijziging van de kalender worden alle vensters omgezet naar
+ * één gesorteerde lijst van overgangen in de week (minuut van de week plus
+ * het venster dat vanaf daar geldt, bij overlap het eerste in de lijst).
+ * Het actieve venster opzoeken is dan een binaire zoekactie; daarna wordt
+ * alleen nog vergeleken met het tijdstip van de volgende overgang. Dat
+ * tijdstip wordt met mktime in lokale tijd berekend, zodat zomer- en
+ * wintertijd vanzelf kloppen. Na een synchronisatie of wijziging van de
+ * tijdzone (getClockGeneration) wordt opnieuw opgezocht.
+ *
+ * buildCalendarTransitions, findCalendarTransition en calendarTransitionEpoch
+ * gebruiken geen hardware of klok en zijn los te testen met de tijdzone uit
+ * SettingsImpl.cpp.
+ */
+
+#include "Calendar.h"
+
+#define MINUTES_PER_DAY 1440
+
+static const char* const calendarDayNames[7] = {"zo", "ma", "di", "wo", "do", "vr", "za"};
+
+static CalendarTransition transitions[CALENDAR_MAX_TRANSITIONS];
+static int transitionCount = 0;
+static int activeWindow = -1;             // Index in settings.calendar, -1 = geen
+static bool calendarStateValid = false;
+static uint32_t calendarGeneration = 0;   // getClockGeneration() bij het laatste opzoeken
+static time_t nextCalendarEpoch = 0;      // Volgende overgang, 0 = geen
+static unsigned long calendarLookups = 0;
+static unsigned long calendarSwitches = 0;
+
+// Lengte van een venster in minuten; einde niet na begin = tot de volgende dag
+static uint16_t windowLength(const CalendarWindow &window) {
+  return window.end > window.start ? window.end - window.start : window.end + MINUTES_PER_DAY - window.start;
+}
+
+// Valt deze minuut van de week binnen het venster?
+static bool windowCovers(const CalendarWindow &window, uint16_t minute) {
+  uint16_t length = windowLength(window);
+  
+  for (int day = 0; day < 7; day++) {
+    if (!(window.days & (1 << day))) {
+      continue;
+    }
+    uint16_t start = day * MINUTES_PER_DAY + window.start;
+    if ((minute + CALENDAR_MINUTES_PER_WEEK - start) % CALENDAR_MINUTES_PER_WEEK < length) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Zet de vensters om naar een gesorteerde lijst van overgangen; geeft het aantal
+int buildCalendarTransitions(const CalendarWindow* windows, int count, CalendarTransition* out) {
+  uint16_t points[CALENDAR_MAX_TRANSITIONS];
+  int pointCount = 0;
+  
+  if (count > CALENDAR_MAX_WINDOWS) {
+    count = CALENDAR_MAX_WINDOWS;
+  }
+  
+  // Begin en einde van elk venster op elke dag
+  for (int i = 0; i < count; i++) {
+    uint16_t length = windowLength(windows[i]);
+    for (int day = 0; day < 7; day++) {
+      if (windows[i].days & (1 << day)) {
+        uint16_t start = day * MINUTES_PER_DAY + windows[i].start;
+        points[pointCount++] = start;
+        points[pointCount++] = (start + length) % CALENDAR_MINUTES_PER_WEEK;
+      }
+    }
+  }
+  
+  // Sorteren (insertion sort, hooguit 112 punten en alleen bij wijzigingen)
+  for (int i = 1; i < pointCount; i++) {
+    uint16_t value = points[i];
+    int j = i - 1;
+    while (j >= 0 && points[j] > value) {
+      points[j + 1] = points[j];
+      j--;
+    }
+    points[j + 1] = value;
+  }
+  
+  // Per punt het geldende venster; punten zonder wissel vallen weg
+  int result = 0;
+  for (int i = 0; i < pointCount; i++) {
+    if (i > 0 && points[i] == points[i - 1]) {
+      continue;
+    }
+    
+    int8_t window = -1;
+    for (int w = 0; w < count; w++) {
+      if (windowCovers(windows[w], points[i])) {
+        window = w;
+        break;
+      }
+    }
+    
+    if (result > 0 && out[result - 1].window == window) {
+      continue;
+    }
+    out[result].minute = points[i];
+    out[result].window = window;
+    result++;
+  }
+  
+  // Zelfde venster aan het eind en begin van de week: geen echte overgang op zondag
+  if (result > 1 && out[0].window == out[result - 1].window) {
+    for (int i = 1; i < result; i++) {
+      out[i - 1] = out[i];
+    }
+    result--;
+  }
+  return result;
+}
+
+// Index van de overgang die op deze minuut van de week geldt (binair zoeken)
+int findCalendarTransition(const CalendarTransition* list, int count, uint16_t minute) {
+  int low = 0;
+  int high = count - 1;
+  int found = count - 1;   // Vóór de eerste overgang geldt de laatste van vorige week
+  
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (list[mid].minute <= minute) {
+      found = mid;
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return found;
+}
+
+// Epoch-tijd waarop opnieuw gekeken moet worden: de eerstvolgende keer dat de
+// lokale klok op deze minuut van de week staat, of eerder rond een tijdwissel
+time_t calendarTransitionEpoch(time_t now, const struct tm &local, uint16_t toMinute) {
+  uint16_t minute = local.tm_wday * MINUTES_PER_DAY + local.tm_hour * 60 + local.tm_min;
+  int delta = (toMinute + CALENDAR_MINUTES_PER_WEEK - minute) % CALENDAR_MINUTES_PER_WEEK;
+  if (delta == 0) {
+    delta = CALENDAR_MINUTES_PER_WEEK;
+  }
+  
+  // In lokale tijd optellen; mktime normaliseert en kiest zomer- of wintertijd
+  struct tm target = local;
+  target.tm_min += delta;
+  target.tm_sec = 0;
+  target.tm_isdst = -1;
+  time_t next = mktime(&target);
+  
+  // Zit er een overgang naar zomer- of wintertijd tussen, dan opnieuw kijken
+  // op het eerste kwartier (wisselmoment): bij wintertijd komt een uur terug
+  struct tm check;
+  localtime_r(&next, &check);
+  if (check.tm_isdst != local.tm_isdst) {
+    time_t quarter = (now / 900 + 1) * 900;
+    if (quarter < next) {
+      next = quarter;
+    }
+  }
+  return next;
+}
+
+// Actief venster en volgende overgang opnieuw bepalen
+static void updateCalendarState() {
+  struct tm local;
+  int window = -1;
+  
+  nextCalendarEpoch = 0;
+  calendarGeneration = getClockGeneration();
+  
+  if (transitionCount > 0 && getClockTime(local)) {
+    time_t now = getClockEpoch();
+    uint16_t minute = local.tm_wday * MINUTES_PER_DAY + local.tm_hour * 60 + local.tm_min;
+    int index = findCalendarTransition(transitions, transitionCount, minute);
+    window = transitions[index].window;
+    
+    if (transitionCount > 1) {
+      time_t next = calendarTransitionEpoch(now, local, transitions[(index + 1) % transitionCount].minute);
+      // Een tijdstip dat door de wintertijd al voorbij is: over een minuut opnieuw kijken
+      nextCalendarEpoch = next > now ? next : now + 60;
+    }
+  }
+  calendarLookups++;
+  calendarStateValid = true;
+  
+  if (window != activeWindow) {
+    activeWindow = window;
+    calendarSwitches++;
+    
+    if (window >= 0) {
+      Serial.print("Kalendervenster ");
+      Serial.print(window + 1);
+      Serial.println(" actief");
+    } else {
+      Serial.println("Geen kalendervenster actief");
+    }
+  }
+}
+
+// Controleer de kalender en zet de vensters om naar overgangen
+void setupCalendar() {
+  String error;
+  
+  if (settings.calendarCount > CALENDAR_MAX_WINDOWS) {
+    settings.calendarCount = 0;
+    markSettingDirty(&settings.calendarCount);
+    saveSettings();
+  }
+  for (int i = 0; i < settings.calendarCount; i++) {
+    if (!validateCalendarWindow(settings.calendar[i], error)) {
+      Serial.print("Kalender ongeldig (");
+      Serial.print(error);
+      Serial.println("), kalender uitgeschakeld");
+      settings.calendarCount = 0;
+      markSettingDirty(&settings.calendarCount);
+      saveSettings();
+      break;
+    }
+  }
+  
+  rebuildCalendar();
+  
+  Serial.print("Kalender: ");
+  Serial.print(settings.calendarCount);
+  Serial.print(" vensters, ");
+  Serial.print(transitionCount);
+  Serial.println(" overgangen per week");
+}
+
+// Na een wijziging van settings.calendar de overgangen opnieuw opbouwen
+void rebuildCalendar() {
+  transitionCount = buildCalendarTransitions(settings.calendar, settings.calendarCount, transitions);
+  calendarStateValid = false;
+}
+
+// Index van het actieve venster, -1 als er geen venster geldt of de tijd onbekend is
+int getActiveCalendarIndex() {
+  if (!calendarStateValid || calendarGeneration != getClockGeneration() ||
+      (nextCalendarEpoch != 0 && getClockEpoch() >= nextCalendarEpoch)) {
+    updateCalendarState();
+  }
+  return activeWindow;
+}
+
+const CalendarWindow* getActiveCalendarWindow() {
+  int index = getActiveCalendarIndex();
+  return index >= 0 ? &settings.calendar[index] : NULL;
+}
+
+// Vanuit de hoofdlus: bij het begin of einde van een venster direct de pompcyclus aanpassen
+void checkCalendar() {
+  int before = activeWindow;
+  if (getActiveCalendarIndex() != before) {
+    updatePumpCycleTimes();
+  }
+}
+
+// Seconden tot de volgende overgang in de kalender, -1 als er geen is
+long getSecondsToCalendarTransition() {
+  getActiveCalendarIndex();
+  if (nextCalendarEpoch == 0) {
+    return -1;
+  }
+  return (long)(nextCalendarEpoch - getClockEpoch());
+}
+
+bool validateCalendarWindow(const CalendarWindow &window, String &error) {
+  if (window.days == 0 || (window.days & 0x80)) {
+    error = "Geen geldige dagen opgegeven";
+    return false;
+  }
+  if (window.start >= MINUTES_PER_DAY || window.end >= MINUTES_PER_DAY) {
+    error = "Begin- en eindtijd moeten tussen 00:00 en 23:59 liggen";
+    return false;
+  }
+  if (window.aan == 0) {
+    error = "AAN-tijd moet minimaal 1 seconde zijn";
+    return false;
+  }
+  return true;
+}
+
+// "HH:MM" naar minuten na middernacht, -1 als ongeldig
+static int parseClockMinutes(const char* text) {
+  int hour, minute;
+  if (text == NULL || sscanf(text, "%d:%d", &hour, &minute) != 2 ||
+      hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+    return -1;
+  }
+  return hour * 60 + minute;
+}
+
+// Venster uit JSON: {"days":["ma","di"],"start":"22:00","end":"06:00","aan":60,"uit":1740,"liters":2.5}
+bool parseCalendarWindow(JsonObjectConst item, CalendarWindow &window, String &error) {
+  memset(&window, 0, sizeof(window));
+  
+  JsonArrayConst days = item["days"];
+  for (JsonVariantConst day : days) {
+    const char* name = day.as<const char*>();
+    int found = -1;
+    for (int d = 0; d < 7 && name != NULL; d++) {
+      if (strcasecmp(name, calendarDayNames[d]) == 0) {
+        found = d;
+        break;
+      }
+    }
+    if (found < 0) {
+      error = "Onbekende dag (gebruik ma, di, wo, do, vr, za, zo)";
+      return false;
+    }
+    window.days |= 1 << found;
+  }
+  
+  int start = parseClockMinutes(item["start"]);
+  int end = parseClockMinutes(item["end"]);
+  if (start < 0 || end < 0) {
+    error = "Begin- en eindtijd als \"UU:MM\" opgeven";
+    return false;
+  }
+  window.start = start;
+  window.end = end;
+  
+  long on = item["aan"] | 0L;
+  long off = item["uit"] | 0L;
+  float liters = item["liters"] | 0.0f;
+  if (on < 0 || on > 65535 || off < 0 || off > 65535 || liters < 0 || liters > 6553.5) {
+    error = "Ongeldige cyclustijd of doelvolume";
+    return false;
+  }
+  window.aan = on;
+  window.uit = off;
+  window.deciliters = (uint16_t)(liters * 10 + 0.5f);
+  
+  return validateCalendarWindow(window, error);
+}
+
+// Vervang de hele kalender; wordt via het journaal als één geheel opgeslagen
+bool setCalendarWindows(const CalendarWindow* windows, int count, String &error) {
+  if (count < 0 || count > CALENDAR_MAX_WINDOWS) {
+    error = "Maximaal " + String(CALENDAR_MAX_WINDOWS) + " vensters";
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    if (!validateCalendarWindow(windows[i], error)) {
+      return false;
+    }
+  }
+  
+  memset(settings.calendar, 0, sizeof(settings.calendar));
+  memcpy(settings.calendar, windows, count * sizeof(CalendarWindow));
+  settings.calendarCount = count;
+  markSettingDirty(&settings.calendarCount);
+  saveSettings();
+  
+  rebuildCalendar();
+  updatePumpCycleTimes();
+  return true;
+}
+
+static String formatClockMinutes(uint16_t minutes) {
+  char buffer[12];
+  snprintf(buffer, sizeof(buffer), "%02d:%02d", minutes / 60, minutes % 60);
+  return String(buffer);
+}
+
+String getCalendarJson() {
+  DynamicJsonDocument doc(3072);
+  
+  doc["active"] = getActiveCalendarIndex();
+  doc["nextTransitionIn"] = getSecondsToCalendarTransition();
+  doc["maxWindows"] = CALENDAR_MAX_WINDOWS;
+  doc["transitions"] = transitionCount;
+  doc["lookups"] = calendarLookups;
+  doc["switches"] = calendarSwitches;
+  
+  JsonArray list = doc.createNestedArray("windows");
+  for (int i = 0; i < settings.calendarCount; i++) {
+    const CalendarWindow &window = settings.calendar[i];
+    JsonObject item = list.createNestedObject();
+    
+    JsonArray days = item.createNestedArray("days");
+    for (int d = 0; d < 7; d++) {
+      if (window.days & (1 << d)) {
+        days.add(calendarDayNames[d]);
+      }
+    }
+    item["start"] = formatClockMinutes(window.start);
+    item["end"] = formatClockMinutes(window.end);
+    item["aan"] = window.aan;
+    item["uit"] = window.uit;
+    item["liters"] = window.deciliters / 10.0;
+  }
+  
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
@@ -0,0 +1,48 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * Calendar.h
+ *
+ * Header voor de weekkalender: vensters per weekdag met een eigen pompcyclus
+ */
+
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include "Settings.h"
+
+#define CALENDAR_MINUTES_PER_WEEK 10080
+#define CALENDAR_MAX_TRANSITIONS (CALENDAR_MAX_WINDOWS * 7 * 2)
+
+// Moment in de week vanaf waar een venster (of geen) geldt
+struct CalendarTransition {
+  uint16_t minute;       // Minuut van de week, 0 = zondag 00:00
+  int8_t window;         // Index in settings.calendar, -1 = geen venster
+};
+
+// Functieprototypes
+void rebuildCalendar();
+int getActiveCalendarIndex();
+long getSecondsToCalendarTransition();
+bool validateCalendarWindow(const CalendarWindow &window, String &error);
+bool parseCalendarWindow(JsonObjectConst item, CalendarWindow &window, String &error);
+bool setCalendarWindows(const CalendarWindow* windows, int count, String &error);
+String getCalendarJson();
+
+// Zonder hardware of klok, ook op een pc te testen
+int buildCalendarTransitions(const CalendarWindow* windows, int count, CalendarTransition* out);
+int findCalendarTransition(const CalendarTransition* list, int count, uint16_t minute);
+time_t calendarTransitionEpoch(time_t now, const struct tm &local, uint16_t toMinute);
+
+#endif // CALENDAR_H
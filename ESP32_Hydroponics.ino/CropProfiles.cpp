@@ -0,0 +1,282 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * CropProfiles.cpp
+ *
+ * Gewasprofielen. Bij een gewaswissel hoeven de acht cyclustijden en twee
+ * temperatuurgrenzen niet opnieuw ingevoerd te worden: ze staan als
+ * benoemd profiel in NVS (één compact record per profiel) en worden bij
+ * opstarten in RAM geladen. Activeren leest daardoor geen flash: de waarden
+ * van het geladen profiel worden in één keer in de instellingen gezet,
+ * waarna de pompcyclus één keer opnieuw berekend wordt. Het wegschrijven
+ * van de gewijzigde instellingen gaat via het journaal van SettingsStore,
+ * zodat ook na een stroomonderbreking nooit een half profiel actief is.
+ */
+
+#include "CropProfiles.h"
+#include <Preferences.h>
+
+Preferences profilePrefs;
+static CropProfile profiles[CROP_PROFILE_SLOTS];   // Alle profielen, bij opstarten geladen
+static bool profileUsed[CROP_PROFILE_SLOTS];
+static int activeProfileIndex = -1;                // Profiel waarvan de instellingen nu gelden
+static unsigned long profileActivations = 0;
+
+static void profileKey(int slot, char* key, size_t size) {
+  snprintf(key, size, "p%d", slot);
+}
+
+// Laad alle profielen in RAM
+void setupCropProfiles() {
+  profilePrefs.begin(CROP_PROFILE_NAMESPACE, false);
+  
+  int count = 0;
+  for (int slot = 0; slot < CROP_PROFILE_SLOTS; slot++) {
+    char key[8];
+    profileKey(slot, key, sizeof(key));
+    
+    profileUsed[slot] = profilePrefs.getBytesLength(key) == sizeof(CropProfile) &&
+                        profilePrefs.getBytes(key, &profiles[slot], sizeof(CropProfile)) == sizeof(CropProfile) &&
+                        memchr(profiles[slot].name, '\0', sizeof(profiles[slot].name)) != NULL &&
+                        profiles[slot].name[0] != '\0';
+    if (profileUsed[slot]) {
+      count++;
+    }
+  }
+  
+  // Het actieve profiel bestaat mogelijk niet meer
+  if (memchr(settings.activeProfile, '\0', sizeof(settings.activeProfile)) == NULL) {
+    settings.activeProfile[0] = '\0';
+    markSettingDirty(&settings.activeProfile);
+    saveSettings();
+  }
+  activeProfileIndex = findCropProfile(settings.activeProfile);
+  
+  Serial.print("Gewasprofielen geladen: ");
+  Serial.print(count);
+  if (activeProfileIndex >= 0) {
+    Serial.print(", actief: ");
+    Serial.print(settings.activeProfile);
+  }
+  Serial.println();
+}
+
+// Zoek een profiel op naam (hoofdletterongevoelig), -1 als het niet bestaat
+int findCropProfile(const char* name) {
+  if (name == NULL || name[0] == '\0') {
+    return -1;
+  }
+  
+  for (int slot = 0; slot < CROP_PROFILE_SLOTS; slot++) {
+    if (profileUsed[slot] && strcasecmp(profiles[slot].name, name) == 0) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+// Kopie van een opgeslagen profiel
+bool getCropProfile(const char* name, CropProfile &profile) {
+  int slot = findCropProfile(name);
+  if (slot < 0) {
+    return false;
+  }
+  profile = profiles[slot];
+  return true;
+}
+
+// Vul een profiel met de huidige instellingen (naam blijft leeg)
+void cropProfileFromSettings(CropProfile &profile) {
+  memset(&profile, 0, sizeof(profile));
+  profile.temp_laag_grens = settings.temp_laag_grens;
+  profile.temp_hoog_grens = settings.temp_hoog_grens;
+  profile.temp_laag_aan = settings.temp_laag_aan;
+  profile.temp_laag_uit = settings.temp_laag_uit;
+  profile.temp_midden_aan = settings.temp_midden_aan;
+  profile.temp_midden_uit = settings.temp_midden_uit;
+  profile.temp_hoog_aan = settings.temp_hoog_aan;
+  profile.temp_hoog_uit = settings.temp_hoog_uit;
+  profile.nacht_aan = settings.nacht_aan;
+  profile.nacht_uit = settings.nacht_uit;
+}
+
+// Controleer naam, grenzen en cyclustijden
+bool validateCropProfile(const CropProfile &profile, String &error) {
+  if (profile.name[0] == '\0') {
+    error = "Profielnaam ontbreekt";
+    return false;
+  }
+  if (!(profile.temp_laag_grens >= 0 && profile.temp_laag_grens < profile.temp_hoog_grens && profile.temp_hoog_grens <= 50)) {
+    error = "Temperatuurgrenzen ongeldig (0-50 °C, laag onder hoog)";
+    return false;
+  }
+  
+  const uint16_t onTimes[] = {profile.temp_laag_aan, profile.temp_midden_aan, profile.temp_hoog_aan, profile.nacht_aan};
+  for (int i = 0; i < 4; i++) {
+    if (onTimes[i] == 0) {
+      error = "AAN-tijd moet minimaal 1 seconde zijn";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Sla een profiel op (nieuw of overschrijven op naam)
+bool saveCropProfile(const CropProfile &profile) {
+  int slot = findCropProfile(profile.name);
+  
+  if (slot < 0) {
+    for (int i = 0; i < CROP_PROFILE_SLOTS; i++) {
+      if (!profileUsed[i]) {
+        slot = i;
+        break;
+      }
+    }
+  }
+  if (slot < 0) {
+    return false;
+  }
+  
+  char key[8];
+  profileKey(slot, key, sizeof(key));
+  if (profilePrefs.putBytes(key, &profile, sizeof(profile)) != sizeof(profile)) {
+    return false;
+  }
+  
+  profiles[slot] = profile;
+  profileUsed[slot] = true;
+  
+  // Het actieve profiel is gewijzigd: de nieuwe waarden direct toepassen
+  if (slot == activeProfileIndex) {
+    activateCropProfile(profile.name);
+  }
+  return true;
+}
+
+// Verwijder een profiel
+bool deleteCropProfile(const char* name) {
+  int slot = findCropProfile(name);
+  if (slot < 0) {
+    return false;
+  }
+  
+  char key[8];
+  profileKey(slot, key, sizeof(key));
+  profilePrefs.remove(key);
+  profileUsed[slot] = false;
+  
+  // De instellingen blijven zoals ze zijn, alleen zonder profielnaam
+  if (slot == activeProfileIndex) {
+    activeProfileIndex = -1;
+    settings.activeProfile[0] = '\0';
+    markSettingDirty(&settings.activeProfile);
+    saveSettings();
+  }
+  return true;
+}
+
+// Activeer een profiel: waarden in één keer overnemen en de pompcyclus herberekenen
+bool activateCropProfile(const char* name) {
+  int slot = findCropProfile(name);
+  if (slot < 0) {
+    return false;
+  }
+  
+  const CropProfile &profile = profiles[slot];
+  settings.temp_laag_grens = profile.temp_laag_grens;
+  settings.temp_hoog_grens = profile.temp_hoog_grens;
+  settings.temp_laag_aan = profile.temp_laag_aan;
+  settings.temp_laag_uit = profile.temp_laag_uit;
+  settings.temp_midden_aan = profile.temp_midden_aan;
+  settings.temp_midden_uit = profile.temp_midden_uit;
+  settings.temp_hoog_aan = profile.temp_hoog_aan;
+  settings.temp_hoog_uit = profile.temp_hoog_uit;
+  settings.nacht_aan = profile.nacht_aan;
+  settings.nacht_uit = profile.nacht_uit;
+  strncpy(settings.activeProfile, profile.name, sizeof(settings.activeProfile) - 1);
+  settings.activeProfile[sizeof(settings.activeProfile) - 1] = '\0';
+  
+  markSettingDirty(&settings.temp_laag_grens);
+  markSettingDirty(&settings.temp_hoog_grens);
+  markSettingDirty(&settings.temp_laag_aan);
+  markSettingDirty(&settings.temp_laag_uit);
+  markSettingDirty(&settings.temp_midden_aan);
+  markSettingDirty(&settings.temp_midden_uit);
+  markSettingDirty(&settings.temp_hoog_aan);
+  markSettingDirty(&settings.temp_hoog_uit);
+  markSettingDirty(&settings.nacht_aan);
+  markSettingDirty(&settings.nacht_uit);
+  markSettingDirty(&settings.activeProfile);
+  
+  activeProfileIndex = slot;
+  profileActivations++;
+  
+  saveSettings();
+  updatePumpCycleTimes();
+  
+  Serial.print("Gewasprofiel geactiveerd: ");
+  Serial.println(profile.name);
+  return true;
+}
+
+// Na handmatig wijzigen van de instellingen geldt het profiel niet meer
+void checkActiveCropProfile() {
+  if (activeProfileIndex < 0) {
+    return;
+  }
+  
+  CropProfile current;
+  cropProfileFromSettings(current);
+  memcpy(current.name, profiles[activeProfileIndex].name, sizeof(current.name));
+  
+  if (memcmp(&current, &profiles[activeProfileIndex], sizeof(current)) != 0) {
+    activeProfileIndex = -1;
+    settings.activeProfile[0] = '\0';
+    markSettingDirty(&settings.activeProfile);
+  }
+}
+
+// Lijst van alle profielen
+String getCropProfilesJson() {
+  DynamicJsonDocument doc(2048);
+  
+  doc["active"] = activeProfileIndex >= 0 ? profiles[activeProfileIndex].name : "";
+  doc["activations"] = profileActivations;
+  doc["maxProfiles"] = CROP_PROFILE_SLOTS;
+  
+  JsonArray list = doc.createNestedArray("profiles");
+  for (int slot = 0; slot < CROP_PROFILE_SLOTS; slot++) {
+    if (!profileUsed[slot]) {
+      continue;
+    }
+    
+    const CropProfile &profile = profiles[slot];
+    JsonObject item = list.createNestedObject();
+    item["name"] = profile.name;
+    item["temp_laag_grens"] = profile.temp_laag_grens;
+    item["temp_hoog_grens"] = profile.temp_hoog_grens;
+    item["temp_laag_aan"] = profile.temp_laag_aan;
+    item["temp_laag_uit"] = profile.temp_laag_uit;
+    item["temp_midden_aan"] = profile.temp_midden_aan;
+    item["temp_midden_uit"] = profile.temp_midden_uit;
+    item["temp_hoog_aan"] = profile.temp_hoog_aan;
+    item["temp_hoog_uit"] = profile.temp_hoog_uit;
+    item["nacht_aan"] = profile.nacht_aan;
+    item["nacht_uit"] = profile.nacht_uit;
+  }
+  
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
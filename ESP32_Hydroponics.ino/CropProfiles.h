@@ -0,0 +1,55 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * CropProfiles.h
+ *
+ * Header voor gewasprofielen: benoemde sets van cyclustijden en
+ * temperatuurgrenzen die met één verzoek geactiveerd worden
+ */
+
+#ifndef CROP_PROFILES_H
+#define CROP_PROFILES_H
+
+#include "Settings.h"
+
+#define CROP_PROFILE_NAMESPACE "profiles"   // NVS namespace voor de profielen
+#define CROP_PROFILE_SLOTS 8                // Maximaal aantal profielen
+
+// Compact profielrecord zoals opgeslagen in NVS (48 bytes)
+struct CropProfile {
+  char name[CROP_PROFILE_NAME_LEN];  // Naam, bijv. "Sla" of "Tomaat"
+  float temp_laag_grens;
+  float temp_hoog_grens;
+  uint16_t temp_laag_aan;            // Cyclustijden in seconden
+  uint16_t temp_laag_uit;
+  uint16_t temp_midden_aan;
+  uint16_t temp_midden_uit;
+  uint16_t temp_hoog_aan;
+  uint16_t temp_hoog_uit;
+  uint16_t nacht_aan;
+  uint16_t nacht_uit;
+};
+
+// Functieprototypes
+int findCropProfile(const char* name);
+bool getCropProfile(const char* name, CropProfile &profile);
+void cropProfileFromSettings(CropProfile &profile);
+bool validateCropProfile(const CropProfile &profile, String &error);
+bool saveCropProfile(const CropProfile &profile);
+bool deleteCropProfile(const char* name);
+bool activateCropProfile(const char* name);
+void checkActiveCropProfile();
+String getCropProfilesJson();
+
+#endif // CROP_PROFILES_H
@@ -23,8 +23,11 @@ unsigned long pumpStopTime = 0;   // Tijdstip waarop de pomp is uitgeschakeld
 unsigned long pumpRunTime = 0;    // Totale draaitijd van de pomp (seconden)
 int currentCycleOn = 0;           // Huidige AAN tijd in seconden
 int currentCycleOff = 0;          // Huidige UIT tijd in seconden
+#ifdef ENABLE_FLOW_SENSOR
+  float currentCycleLiters = 0.0; // Huidig doelvolume per AAN-fase in volume modus
+#endif
 bool manualOverride = false;      // Handmatige besturing actief
-TempSettings settings;            // Instellingen geladen uit EEPROM
+TempSettings settings;            // Instellingen geladen uit NVS
 
 void setup() {
   // Start seriële communicatie
@@ -33,9 +36,15 @@ void setup() {
   Serial.println("© AXISKOM kennisplatform (https://axiskom.nl)");
   Serial.println("Opstarten...");
   
-  // Laad instellingen uit EEPROM
+  // Tijd van voor een herstart terugzetten, zodat de planning niet op NTP hoeft te wachten
+  restoreClockHoldover();
+  
+  // Laad instellingen uit NVS
   loadSettings();
   
+  // Laad gewasprofielen
+  setupCropProfiles();
+  
   // Configureer pompaansturing
   pinMode(RELAY_PIN, OUTPUT);
   digitalWrite(RELAY_PIN, LOW); // Pomp uit bij opstarten
@@ -43,11 +52,13 @@ void setup() {
   // Initialiseer DS18B20 temperatuursensor
   setupTemperatureSensor();
   
-  // Initialiseer WiFi
+  // Start WiFi verbinding (wacht niet; checkWiFiConnection() handelt de rest af)
   setupWiFi();
   
   // Initialiseer NTP tijd synchronisatie
   setupTime();
+  onNightModeChange(nightModeChanged);
+  setupCalendar();
   
   // Initialiseer optionele modules
   
@@ -59,6 +70,14 @@ void setup() {
     setupEmailNotification();
   #endif
   
+  #if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+    setupWebhook();
+  #endif
+  
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    setupMqtt();
+  #endif
+  
   // Initialiseer webserver
   setupWebServer();
   
@@ -69,8 +88,7 @@ void setup() {
   updatePumpCycleTimes();
   
   Serial.println("Systeem geïnitialiseerd en klaar voor gebruik!");
-  Serial.print("Je kunt de webinterface openen op: http://");
-  Serial.println(WiFi.localIP());
+  Serial.println("De webinterface is bereikbaar op het IP-adres dat na het verbinden met WiFi wordt getoond");
 }
 
 void loop() {
@@ -80,6 +98,9 @@ void loop() {
   // Beheer tijd synchronisatie
   checkTimeSync();
   
+  // Begin of einde van een kalendervenster direct toepassen
+  checkCalendar();
+  
   // Verwerk webserver verzoeken
   handleWebClient();
   
@@ -106,6 +127,18 @@ void loop() {
   #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
     checkFlowRate();
   #endif
+  
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+    // Verstuur gebundelde waarschuwingen als het venster is verstreken
+    emailNotificationLoop();
+  #endif
+  
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    mqttLoop();
+  #endif
+  
+  // Schrijf gewijzigde instellingen gebundeld weg
+  settingsStoreLoop();
 }
 
 // Update pomp draaitijd statistieken
@@ -115,6 +148,11 @@ void updateRuntime() {
   }
 }
 
+// Bij de overgang tussen dag en nacht direct de nieuwe cyclustijden toepassen
+void nightModeChanged(bool night) {
+  updatePumpCycleTimes();
+}
+
 // Stel de pomp in op handmatige besturing
 void setPumpManual(bool state) {
   manualOverride = true;
@@ -0,0 +1,161 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * EmailDigest.cpp
+ *
+ * Bundelt waarschuwingen die binnen hetzelfde tijdvenster optreden tot één
+ * overzichtsmail. Per soort waarschuwing (zelfde onderwerp) wordt bijgehouden
+ * hoe vaak ze optrad, wanneer voor het eerst en voor het laatst, en van welk
+ * onderdeel ze komt. Zo kost een reeks meldingen één SMTP-sessie in plaats
+ * van één per melding, en gaat er geen melding stilzwijgend verloren.
+ *
+ * Het tijdvenster zelf wordt bewaakt door EmailNotification.cpp.
+ */
+
+#include "EmailDigest.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+
+// Verzamelde gegevens per soort waarschuwing
+struct DigestSlot {
+  uint32_t hash;
+  char title[DIGEST_TITLE_LEN];
+  char subsystem[DIGEST_SUBSYSTEM_LEN];
+  uint16_t count;
+  time_t firstTime;               // 0 als de tijd nog niet bekend was
+  time_t lastTime;
+  unsigned long firstMillis;
+  unsigned long lastMillis;
+};
+
+static DigestSlot digestSlots[DIGEST_SLOTS];
+static int digestUsed = 0;
+static uint32_t digestOverflow = 0;    // Meldingen zonder vrij slot in dit venster
+static uint32_t digestsBuilt = 0;
+static uint32_t digestAlertsTotal = 0;
+
+// FNV-1a hash van het onderwerp
+static uint32_t digestHash(const char* text) {
+  uint32_t hash = 2166136261UL;
+  while (*text) {
+    hash ^= (uint8_t)*text++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// Tijdstip als tekst; zonder tijdsynchronisatie de looptijd sinds opstarten
+static void digestTimeString(char* buffer, size_t size, time_t t, unsigned long ms) {
+  if (t > 1577836800) {  // 1-1-2020
+    struct tm timeinfo;
+    localtime_r(&t, &timeinfo);
+    strftime(buffer, size, "%H:%M:%S", &timeinfo);
+  } else {
+    snprintf(buffer, size, "+%lus", ms / 1000);
+  }
+}
+
+// Neem een waarschuwing op in het lopende overzicht
+void emailDigestAdd(const char* subject, const char* subsystem) {
+  uint32_t hash = digestHash(subject);
+  time_t now = time(nullptr);
+  unsigned long nowMillis = millis();
+  
+  digestAlertsTotal++;
+  
+  for (int i = 0; i < digestUsed; i++) {
+    if (digestSlots[i].hash == hash) {
+      digestSlots[i].count++;
+      digestSlots[i].lastTime = now;
+      digestSlots[i].lastMillis = nowMillis;
+      return;
+    }
+  }
+  
+  if (digestUsed >= DIGEST_SLOTS) {
+    digestOverflow++;
+    return;
+  }
+  
+  DigestSlot &slot = digestSlots[digestUsed++];
+  slot.hash = hash;
+  strncpy(slot.title, subject, sizeof(slot.title) - 1);
+  slot.title[sizeof(slot.title) - 1] = '\0';
+  strncpy(slot.subsystem, subsystem, sizeof(slot.subsystem) - 1);
+  slot.subsystem[sizeof(slot.subsystem) - 1] = '\0';
+  slot.count = 1;
+  slot.firstTime = now;
+  slot.lastTime = now;
+  slot.firstMillis = nowMillis;
+  slot.lastMillis = nowMillis;
+}
+
+// Staan er waarschuwingen klaar voor een overzicht?
+bool emailDigestPending() {
+  return digestUsed > 0 || digestOverflow > 0;
+}
+
+// Schrijf de overzichtstekst en leeg het overzicht. Geeft het totaal aantal
+// gebundelde meldingen terug.
+uint32_t emailDigestBuild(char* message, size_t size) {
+  uint32_t total = digestOverflow;
+  for (int i = 0; i < digestUsed; i++) {
+    total += digestSlots[i].count;
+  }
+  
+  size_t len = snprintf(message, size, "Overzicht van %lu waarschuwing(en) in de afgelopen periode:\n\n",
+                        (unsigned long)total);
+  
+  for (int i = 0; i < digestUsed && len < size; i++) {
+    const DigestSlot &slot = digestSlots[i];
+    char first[16];
+    char last[16];
+    digestTimeString(first, sizeof(first), slot.firstTime, slot.firstMillis);
+    digestTimeString(last, sizeof(last), slot.lastTime, slot.lastMillis);
+    
+    if (slot.count > 1) {
+      len += snprintf(message + len, size - len, "[%s] %s\n  %ux, eerste %s, laatste %s\n",
+                      slot.subsystem, slot.title, slot.count, first, last);
+    } else {
+      len += snprintf(message + len, size - len, "[%s] %s\n  om %s\n",
+                      slot.subsystem, slot.title, first);
+    }
+  }
+  
+  if (digestOverflow > 0 && len < size) {
+    snprintf(message + len, size - len, "\nEn nog %lu melding(en) van andere soorten.\n",
+             (unsigned long)digestOverflow);
+  }
+  
+  digestUsed = 0;
+  digestOverflow = 0;
+  digestsBuilt++;
+  
+  return total;
+}
+
+// Voeg overzicht status toe aan een JSON object
+void addEmailDigestJson(JsonObject obj) {
+  uint32_t pending = digestOverflow;
+  for (int i = 0; i < digestUsed; i++) {
+    pending += digestSlots[i].count;
+  }
+  
+  obj["pending"] = pending;
+  obj["kinds"] = digestUsed;
+  obj["sent"] = digestsBuilt;
+  obj["alertsTotal"] = digestAlertsTotal;
+}
+
+#endif // defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
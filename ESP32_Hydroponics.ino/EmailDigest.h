@@ -0,0 +1,37 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * EmailDigest.h
+ *
+ * Header voor het bundelen van e-mailwaarschuwingen in een overzicht
+ */
+
+#ifndef EMAIL_DIGEST_H
+#define EMAIL_DIGEST_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+  #define DIGEST_SLOTS 8                  // Aantal verschillende waarschuwingen per overzicht
+  #define DIGEST_TITLE_LEN 64
+  #define DIGEST_SUBSYSTEM_LEN 12
+  
+  // Functieprototypes
+  void emailDigestAdd(const char* subject, const char* subsystem);
+  bool emailDigestPending();
+  uint32_t emailDigestBuild(char* message, size_t size);
+  void addEmailDigestJson(JsonObject obj);
+#endif
+
+#endif // EMAIL_DIGEST_H
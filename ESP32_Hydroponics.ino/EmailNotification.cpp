@@ -18,40 +18,369 @@
  */
 
 #include "EmailNotification.h"
+#include "EmailOutbox.h"
+#include "EmailDigest.h"
+#include "EmailTemplate.h"
+#include "Notification.h"
 
 #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
 
-// E-mail client instances
+// E-mail client instances (alleen gebruikt door de e-mail taak)
 SMTPSession smtp;
 Session_Config config;
 
 // E-mail variabelen
 bool emailClientReady = false;
 unsigned long lastEmailSent = 0;
+unsigned long lastEmailQueued = 0;
 unsigned long emailServiceStartTime = 0;
-String lastEmailError = "";
-const unsigned long MIN_EMAIL_INTERVAL = 300000; // 5 minuten tussen e-mails
+char lastEmailError[EMAIL_ERROR_LEN] = "";
+const unsigned long MIN_EMAIL_INTERVAL = 300000; // Venster waarin waarschuwingen gebundeld worden
+const unsigned long EMAIL_STARTUP_DELAY = 120000; // Geen e-mails in de eerste 2 minuten
 
-// Constanten voor Gmail SMTP-server
-#define GMAIL_SMTP_SERVER "smtp.gmail.com"
-#define GMAIL_SMTP_PORT 465
+// SMTP-server: standaard Gmail, met TLS vanaf het begin op poort 465 (op
+// poort 587 kiest ESP_Mail_Client zelf STARTTLS). Een andere server kan met
+// -DEMAIL_SMTP_SERVER=... en -DEMAIL_SMTP_PORT=...; de verzendketen zelf wordt
+// op de PC getest tegen een nagebootste server (test/test_email.cpp).
+#ifndef EMAIL_SMTP_SERVER
+  #define EMAIL_SMTP_SERVER "smtp.gmail.com"
+#endif
+#ifndef EMAIL_SMTP_PORT
+  #define EMAIL_SMTP_PORT 465
+#endif
+
+// Wachtrij en taak. Een bericht wordt in de loop() samengesteld (met de
+// meetwaarden van dat moment) en als vast blok in de wachtrij gezet; de
+// taak doet de trage TLS-verbinding en het versturen zodat loop(), de
+// webserver en de pompregeling nooit blokkeren.
+#define EMAIL_QUEUE_LENGTH 4
+#define EMAIL_MAX_ATTEMPTS 3
+#define EMAIL_RETRY_DELAY 15000     // Eerste herhaalpoging na 15 s, daarna verdubbeld
+#define EMAIL_TCP_TIMEOUT 10        // Seconden per TCP-stap
+#define EMAIL_TASK_STACK 8192
+#define EMAIL_TASK_PRIORITY 1       // Net boven idle, onder de Arduino loop-taak
+#define EMAIL_SESSION_IDLE 10000    // Sessie zo lang openhouden na het laatste bericht
+#define EMAIL_SESSION_MAX_MAILS 20  // Daarna toch opnieuw verbinden
+
+static QueueHandle_t emailQueue = NULL;
+static TaskHandle_t emailTaskHandle = NULL;
+static SemaphoreHandle_t emailStatusMutex = NULL;
+
+// Status, gedeeld tussen de e-mail taak en de webserver (beschermd door emailStatusMutex)
+static bool emailSending = false;
+static uint32_t emailsSent = 0;
+static uint32_t emailsFailed = 0;
+static uint32_t emailsDropped = 0;
+static uint32_t emailRetries = 0;
+static unsigned long lastSendDuration = 0;
+
+// Grootste vrije heap-blok rond het versturen (de TLS-handshake heeft een
+// groot aaneengesloten blok nodig)
+static size_t heapBlockBefore = 0;
+static size_t heapBlockAfter = 0;
+static size_t heapBlockMin = 0;
+
+// SMTP-sessie hergebruik (alleen gebruikt door de e-mail taak, statistiek
+// beschermd door emailStatusMutex). Een TLS-sessie hervatten met een ticket
+// of sessie-ID kan niet: ESP_Mail_Client maakt de TLS-client zelf aan in
+// connect() en ruimt hem op in closeSession(), zonder API om de sessie te
+// bewaren en terug te geven. Na het sluiten kost elke verbinding dus weer een
+// volledige handshake; de sessie openhouden is het hergebruik dat hier kan.
+static bool sessionOpen = false;
+static uint16_t sessionMails = 0;
+static uint32_t sessionConnects = 0;
+static uint32_t sessionReuses = 0;
+static unsigned long lastConnectDuration = 0;
+static unsigned long totalConnectDuration = 0;
+
+// Eén buffer voor het samenstellen van berichten. Samenstellen gebeurt
+// alleen vanuit de loop() (waarschuwingen, overzicht, webserver), dus er is
+// geen gelijktijdig gebruik; de wachtrij neemt een kopie.
+static EmailJob composeBuffer;
+
+// Zet de foutmelding thread-safe
+static void setEmailError(const char* error) {
+  if (emailStatusMutex != NULL) {
+    xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+  }
+  strncpy(lastEmailError, error, EMAIL_ERROR_LEN - 1);
+  lastEmailError[EMAIL_ERROR_LEN - 1] = '\0';
+  if (emailStatusMutex != NULL) {
+    xSemaphoreGive(emailStatusMutex);
+  }
+}
+
+// Stel een bericht samen in composeBuffer, met de systeemgegevens van dit moment
+static EmailJob& composeEmailJob(const char* subject, const char* message, bool highPriority, bool isTest) {
+  EmailJob& job = composeBuffer;
+  
+  strncpy(job.subject, subject, sizeof(job.subject) - 1);
+  job.subject[sizeof(job.subject) - 1] = '\0';
+  
+  renderEmailTemplate(job.body, sizeof(job.body), EMAIL_TPL_ALERT_BODY, message);
+  
+  job.highPriority = highPriority;
+  job.isTest = isTest;
+  job.queuedAt = millis();
+  job.outboxSeq = 0;
+  return job;
+}
+
+// Zet een samengesteld bericht in de wachtrij van de e-mail taak
+bool enqueueEmailJob(const EmailJob& job) {
+  if (emailQueue == NULL) {
+    return false;
+  }
+  
+  // Niet wachten: een volle wachtrij mag de loop() niet ophouden
+  if (xQueueSend(emailQueue, &job, 0) != pdTRUE) {
+    xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+    emailsDropped++;
+    xSemaphoreGive(emailStatusMutex);
+    setEmailError("E-mail wachtrij vol");
+    Serial.println("FOUT: E-mail wachtrij vol, bericht niet verzonden");
+    return false;
+  }
+  
+  return true;
+}
+
+// Aantal vrije plaatsen in de wachtrij
+int getEmailQueueSpace() {
+  if (emailQueue == NULL) {
+    return 0;
+  }
+  return uxQueueSpacesAvailable(emailQueue);
+}
+
+// Verstuur één bericht; wordt alleen vanuit de e-mail taak aangeroepen
+static bool deliverEmail(const EmailJob& job) {
+  if (WiFi.status() != WL_CONNECTED) {
+    setEmailError("Geen WiFi-verbinding");
+    return false;
+  }
+  
+  // Bereid het bericht voor
+  SMTP_Message emailMessage;
+  
+  // Stel de bericht headers in
+  emailMessage.sender.name = "ESP32 Hydro Controller";
+  emailMessage.sender.email = settings.emailUsername;
+  emailMessage.subject = job.subject;
+  emailMessage.addRecipient("Hydroponisch Systeem", settings.emailRecipient);
+  
+  // Stel de tekst in
+  emailMessage.text.content = job.body;
+  emailMessage.text.charSet = "utf-8";
+  emailMessage.text.transfer_encoding = Content_Transfer_Encoding::enc_7bit;
+  emailMessage.priority = job.highPriority ? esp_mail_smtp_priority::esp_mail_smtp_priority_high
+                                           : esp_mail_smtp_priority::esp_mail_smtp_priority_normal;
+  
+  size_t blockBefore = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  bool sent = false;
+  
+  // Hergebruik een open sessie; een sessie die de server intussen heeft
+  // gesloten merken we pas bij het verzenden, dan direct één keer opnieuw
+  // verbinden zonder op de herhaaltimer te wachten
+  for (int pass = 0; pass < 2 && !sent; pass++) {
+    bool reused = sessionOpen && smtp.connected() && smtp.isLoggedIn();
+    
+    if (!reused) {
+      if (sessionOpen) {
+        smtp.closeSession();
+        sessionOpen = false;
+      }
+      
+      unsigned long connectStart = millis();
+      if (!smtp.connect(&config)) {
+        setEmailError("Kan niet verbinden met e-mailserver");
+        break;
+      }
+      
+      unsigned long connectTime = millis() - connectStart;
+      sessionOpen = true;
+      sessionMails = 0;
+      
+      xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+      sessionConnects++;
+      lastConnectDuration = connectTime;
+      totalConnectDuration += connectTime;
+      xSemaphoreGive(emailStatusMutex);
+    }
+    
+    // Sessie na het verzenden niet sluiten
+    if (MailClient.sendMail(&smtp, &emailMessage, false)) {
+      sent = true;
+      sessionMails++;
+      if (reused) {
+        xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+        sessionReuses++;
+        xSemaphoreGive(emailStatusMutex);
+      }
+    } else {
+      setEmailError(smtp.errorReason().c_str());
+      smtp.closeSession();
+      sessionOpen = false;
+      if (!reused) {
+        break;
+      }
+    }
+  }
+  
+  // Na een vast aantal berichten de sessie vernieuwen
+  if (sessionOpen && sessionMails >= EMAIL_SESSION_MAX_MAILS) {
+    smtp.closeSession();
+    sessionOpen = false;
+  }
+  
+  size_t blockAfter = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  
+  xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+  heapBlockBefore = blockBefore;
+  heapBlockAfter = blockAfter;
+  if (heapBlockMin == 0 || blockBefore < heapBlockMin) {
+    heapBlockMin = blockBefore;
+  }
+  xSemaphoreGive(emailStatusMutex);
+  
+  if (settings.emailDebug) {
+    Serial.printf("Grootste vrije heap-blok: %u bytes voor, %u bytes na verzenden\n",
+                  (unsigned)blockBefore, (unsigned)blockAfter);
+  }
+  
+  return sent;
+}
+
+// E-mail taak: haalt berichten uit de wachtrij en verstuurt ze met herhaalpogingen
+static void emailTask(void* parameter) {
+  EmailJob job;
+  
+  for (;;) {
+    // Met een open sessie maar kort wachten op het volgende bericht; komt
+    // er niets, dan de sessie netjes sluiten en weer onbeperkt wachten
+    TickType_t wait = sessionOpen ? pdMS_TO_TICKS(EMAIL_SESSION_IDLE) : portMAX_DELAY;
+    if (xQueueReceive(emailQueue, &job, wait) != pdTRUE) {
+      if (sessionOpen) {
+        smtp.closeSession();
+        sessionOpen = false;
+        if (settings.emailDebug) {
+          Serial.println("SMTP sessie gesloten na inactiviteit");
+        }
+      }
+      continue;
+    }
+    
+    xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+    emailSending = true;
+    xSemaphoreGive(emailStatusMutex);
+    
+    // Bericht uit de outbox: pas nu als uitgesteld markeren
+    emailOutboxPrepareSend(job);
+    
+    bool sent = false;
+    unsigned long retryDelay = EMAIL_RETRY_DELAY;
+    
+    for (int attempt = 1; attempt <= EMAIL_MAX_ATTEMPTS && !sent; attempt++) {
+      unsigned long start = millis();
+      Serial.printf("E-mail verzenden (poging %d/%d): %s\n", attempt, EMAIL_MAX_ATTEMPTS, job.subject);
+      
+      sent = deliverEmail(job);
+      
+      xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+      lastSendDuration = millis() - start;
+      if (sent) {
+        emailsSent++;
+        lastEmailError[0] = '\0';
+        // Testmails tellen niet mee voor het normale alarm interval
+        if (!job.isTest) {
+          lastEmailSent = millis();
+        }
+      } else if (attempt < EMAIL_MAX_ATTEMPTS) {
+        emailRetries++;
+      }
+      xSemaphoreGive(emailStatusMutex);
+      
+      if (sent) {
+        Serial.printf("E-mail succesvol verzonden (%lu ms)\n", lastSendDuration);
+      } else if (attempt < EMAIL_MAX_ATTEMPTS) {
+        Serial.printf("FOUT: Verzenden mislukt, nieuwe poging over %lu s\n", retryDelay / 1000);
+        vTaskDelay(pdMS_TO_TICKS(retryDelay));
+        retryDelay *= 2;
+      }
+    }
+    
+    xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+    if (!sent) {
+      emailsFailed++;
+    }
+    emailSending = false;
+    xSemaphoreGive(emailStatusMutex);
+    
+    if (!sent) {
+      Serial.print("FOUT: E-mail niet verzonden - Reden: ");
+      Serial.println(lastEmailError);
+    }
+    
+    // Waarschuwingen gaan niet verloren: een nieuw bericht gaat bij mislukken
+    // de outbox in, een bericht uit de outbox blijft daar tot het verzonden is
+    emailOutboxSendResult(job, sent);
+  }
+}
+
+// Meldingskanaal: waarschuwingen via e-mail (met bundeling en outbox)
+static bool emailSinkDeliver(const AlertEvent& event) {
+  return sendEmailAlert(event.subject, event.message, event.subsystem, event.critical);
+}
+
+static void emailSinkStatus(JsonObject obj) {
+  xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+  obj["sent"] = emailsSent;
+  obj["failed"] = emailsFailed;
+  obj["dropped"] = emailsDropped;
+  obj["lastLatencyMs"] = lastSendDuration;
+  obj["avgConnectMs"] = sessionConnects > 0 ? totalConnectDuration / sessionConnects : 0;
+  xSemaphoreGive(emailStatusMutex);
+  obj["queued"] = uxQueueMessagesWaiting(emailQueue);
+}
+
+static const NotificationSink emailSink = { "email", emailSinkDeliver, emailSinkStatus };
 
 // Initialiseer e-mail notificatie
 void setupEmailNotification() {
   Serial.println("E-mail notificatie module initialiseren");
   
+  // Wachtrij, mutex en taak worden altijd aangemaakt zodat de status
+  // opvraagbaar is, ook als de instellingen nog niet compleet zijn
+  if (emailQueue == NULL) {
+    emailQueue = xQueueCreate(EMAIL_QUEUE_LENGTH, sizeof(EmailJob));
+    emailStatusMutex = xSemaphoreCreateMutex();
+  }
+  
+  if (emailQueue == NULL || emailStatusMutex == NULL) {
+    Serial.println("FOUT: Kan e-mail wachtrij niet aanmaken");
+    emailClientReady = false;
+    setEmailError("Onvoldoende geheugen voor e-mail wachtrij");
+    return;
+  }
+  
+  registerNotificationSink(&emailSink);
+  
+  // Laad de outbox, ook zonder geldige instellingen blijven bewaarde
+  // waarschuwingen staan tot ze verzonden kunnen worden
+  setupEmailOutbox();
+  
   // Controleer of e-mailinstellingen zijn geconfigureerd
   if (strlen(settings.emailUsername) < 5 || strlen(settings.emailPassword) < 5 || 
       strlen(settings.emailRecipient) < 5) {
     Serial.println("FOUT: E-mailinstellingen niet correct geconfigureerd");
     emailClientReady = false;
-    lastEmailError = "E-mailinstellingen niet correct geconfigureerd";
+    setEmailError("E-mailinstellingen niet correct geconfigureerd");
     return;
   }
 
   // Configureer de sessie
-  config.server.host_name = GMAIL_SMTP_SERVER;
-  config.server.port = GMAIL_SMTP_PORT;
+  config.server.host_name = EMAIL_SMTP_SERVER;
+  config.server.port = EMAIL_SMTP_PORT;
   config.login.email = settings.emailUsername;
   config.login.password = settings.emailPassword;
   config.login.user_domain = "ESP32_Hydro";
@@ -61,11 +390,25 @@ void setupEmailNotification() {
   config.time.gmt_offset = 1; // CET tijdzone (Nederland)
   config.time.day_light_offset = 1; // Zomertijd correctie
 
+  // Begrens hoe lang een hangende verbinding de taak kan vasthouden
+  smtp.setTCPTimeout(EMAIL_TCP_TIMEOUT);
+
   // Debug modus instellen als nodig
   if (settings.emailDebug) {
     smtp.debug(1);
   }
   
+  // Start de verzendtaak op core 0, weg van de Arduino loop() op core 1
+  if (emailTaskHandle == NULL) {
+    if (xTaskCreatePinnedToCore(emailTask, "email", EMAIL_TASK_STACK, NULL,
+                                EMAIL_TASK_PRIORITY, &emailTaskHandle, 0) != pdPASS) {
+      Serial.println("FOUT: Kan e-mail taak niet starten");
+      emailClientReady = false;
+      setEmailError("Kan e-mail taak niet starten");
+      return;
+    }
+  }
+  
   emailClientReady = true;
   emailServiceStartTime = millis();
   Serial.println("E-mail client geïnitialiseerd");
@@ -73,230 +416,181 @@ void setupEmailNotification() {
 
 // Verkrijg de laatste e-mail foutmelding
 String getLastEmailError() {
-  if (lastEmailError.length() > 0) {
-    return lastEmailError;
+  char error[EMAIL_ERROR_LEN];
+  if (emailStatusMutex != NULL) {
+    xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+  }
+  strcpy(error, lastEmailError);
+  if (emailStatusMutex != NULL) {
+    xSemaphoreGive(emailStatusMutex);
+  }
+  
+  if (error[0] != '\0') {
+    return String(error);
   }
   
   if (!emailClientReady) return "E-mail client niet geïnitialiseerd";
-  if (millis() - emailServiceStartTime < 120000) return "Systeem nog in opstarttijd";
-  if (millis() - lastEmailSent < MIN_EMAIL_INTERVAL) return "Te korte tijd sinds laatste e-mail";
-  return "Onbekende fout";
+  return "";
 }
 
-// Stuur waarschuwing bij flowprobleem
-bool sendFlowAlertEmail() {
-  // Deze functie wordt alleen aangeroepen als er een flowprobleem is
-  String subject = "WAARSCHUWING: Geen waterstroming in ";
-  subject += settings.systeemnaam;
-  
-  String message = "Er is geen waterstroming gedetecteerd terwijl de pomp aan staat!\n\n";
-  message += "Controleer onmiddellijk op mogelijke problemen zoals:\n";
-  message += "- Verstopte leidingen\n";
-  message += "- Lucht in het systeem\n";
-  message += "- Pomp defect\n";
-  message += "- Waterreservoir leeg\n\n";
-  message += "Dit kan schade veroorzaken aan je planten of systeemcomponenten.";
-  
-  bool result = sendEmailAlert(subject.c_str(), message.c_str());
-  if (result) {
-    Serial.println("Flow probleem e-mail verzonden");
-  } else {
-    Serial.println("Kon geen flow probleem e-mail verzenden - Reden: " + getLastEmailError());
+// Verstuur een samengesteld bericht: zonder WiFi direct naar de outbox,
+// die na herstel van de verbinding wordt verzonden
+static bool dispatchEmailJob(const EmailJob& job) {
+  if (WiFi.status() != WL_CONNECTED) {
+    Serial.println("Geen WiFi-verbinding, waarschuwing bewaard in outbox");
+    return emailOutboxStore(job);
   }
-  return result;
+  return enqueueEmailJob(job);
 }
 
-// Verstuur een e-mailalert met het opgegeven onderwerp en bericht
-bool sendEmailAlert(const char* subject, const char* message) {
-  // Reset de laatste foutmelding
-  lastEmailError = "";
-  
-  // Test internetverbinding
-  if (WiFi.status() != WL_CONNECTED) {
-    lastEmailError = "Geen WiFi-verbinding";
-    Serial.println("FOUT: Geen WiFi-verbinding, kan geen e-mail versturen");
-    return false;
-  }
-  
+// Meld een waarschuwing. De eerste waarschuwing na een rustige periode wordt
+// direct verzonden en opent een venster van MIN_EMAIL_INTERVAL; alles wat
+// daarbinnen volgt wordt gebundeld en aan het eind van het venster als één
+// overzicht verzonden (zie emailNotificationLoop). Kritieke waarschuwingen
+// gaan altijd direct, buiten het venster om.
+// Geeft true terug als de waarschuwing is geaccepteerd; het versturen zelf
+// gebeurt asynchroon en is te volgen via getEmailStatusJson().
+bool sendEmailAlert(const char* subject, const char* message, const char* subsystem, bool critical) {
   if (!emailClientReady) {
-    lastEmailError = "E-mail client niet geïnitialiseerd";
+    setEmailError("E-mail client niet geïnitialiseerd");
     Serial.println("FOUT: E-mail client niet geïnitialiseerd");
     return false;
   }
   
-  // Wacht ten minste 2 minuten na opstarten voordat de eerste waarschuwing wordt verzonden
-  if (millis() - emailServiceStartTime < 120000) {
-    lastEmailError = "Systeem nog in opstarttijd";
-    Serial.println("WAARSCHUWING: E-mail service nog in opstarttijd, wacht nog even");
-    return false;
-  }
+  bool startup = millis() - emailServiceStartTime < EMAIL_STARTUP_DELAY;
+  bool windowOpen = lastEmailQueued != 0 && millis() - lastEmailQueued < MIN_EMAIL_INTERVAL;
   
-  // Controleer of er niet te snel achter elkaar e-mails worden verstuurd
-  if (millis() - lastEmailSent < MIN_EMAIL_INTERVAL) {
-    lastEmailError = "Te korte tijd sinds laatste e-mail";
-    Serial.println("WAARSCHUWING: Te veel e-mails in korte tijd, wacht minimaal 5 minuten tussen notificaties");
-    return false;
+  // In de opstarttijd of binnen het venster: opnemen in het overzicht
+  if (startup || (windowOpen && !critical)) {
+    emailDigestAdd(subject, subsystem);
+    Serial.print("Waarschuwing opgenomen in overzicht: ");
+    Serial.println(subject);
+    return true;
   }
   
-  // Bereid het bericht voor
-  SMTP_Message emailMessage;
+  EmailJob& job = composeEmailJob(subject, message, true, false);
   
-  // Stel de bericht headers in
-  emailMessage.sender.name = "ESP32 Hydro Controller";
-  emailMessage.sender.email = settings.emailUsername;
-  emailMessage.subject = subject;
-  emailMessage.addRecipient("Hydroponisch Systeem", settings.emailRecipient);
-  
-  // Haal datum en tijd op
-  String currentDateTime = getFullDateTimeString();
-  
-  // Maak de inhoud van het bericht
-  String textContent = String(message);
-  textContent += "\n\n---------------------------\n";
-  textContent += "Systeem: ";
-  textContent += settings.systeemnaam;
-  textContent += "\nTijdstip: ";
-  textContent += currentDateTime;
-  textContent += "\nHuidige temperatuur: ";
-  textContent += String(currentTemp);
-  textContent += "°C\n";
-  
-  #ifdef ENABLE_FLOW_SENSOR
-  textContent += "Huidige waterstroming: ";
-  textContent += String(flowRate);
-  textContent += " L/min\n";
-  textContent += "Totaal doorgestroomd: ";
-  textContent += String(totalLiters);
-  textContent += " L\n";
-  #endif
-  
-  // Stel de tekst in
-  emailMessage.text.content = textContent.c_str();
-  emailMessage.text.charSet = "utf-8";
-  emailMessage.text.transfer_encoding = Content_Transfer_Encoding::enc_7bit;
-  emailMessage.priority = esp_mail_smtp_priority::esp_mail_smtp_priority_high;
-  
-  // Verbind met de server en verzend de e-mail
-  Serial.println("E-mail verzenden...");
-  
-  // Verbind met de server
-  if (!smtp.connect(&config)) {
-    lastEmailError = "Kan niet verbinden met e-mailserver";
-    Serial.println("FOUT: Kan niet verbinden met e-mailserver");
-    return false;
+  if (!dispatchEmailJob(job)) {
+    // Wachtrij vol: niet weggooien maar meenemen in het volgende overzicht
+    emailDigestAdd(subject, subsystem);
+    return true;
   }
   
-  // Verzend het bericht
-  if (!MailClient.sendMail(&smtp, &emailMessage)) {
-    lastEmailError = String(smtp.errorReason());
-    Serial.println("FOUT: Verzenden e-mail mislukt");
-    Serial.println(smtp.errorReason());
-    return false;
+  // Een kritieke waarschuwing opent geen nieuw venster; het lopende
+  // overzicht wordt gewoon op tijd verzonden
+  if (!critical || lastEmailQueued == 0) {
+    lastEmailQueued = millis();
   }
-  
-  Serial.println("E-mail succesvol verzonden");
-  lastEmailSent = millis();
   return true;
 }
 
-// Verstuur test e-mail
-bool sendTestEmail() {
-  // Deze functie omzeilt de interval check voor test doeleinden
-  String subject = "Test Email - ESP32 Hydro Systeem";
-  String message = "Dit is een test e-mail van je ESP32 Hydroponisch Systeem Controller.\n";
-  message += "Als je deze e-mail ontvangt, is de e-mailconfiguratie correct.";
-  
-  // Reset de laatste foutmelding
-  lastEmailError = "";
+// Verstuur het overzicht zodra het venster is verstreken
+void emailNotificationLoop() {
+  if (!emailClientReady || !emailDigestPending()) {
+    return;
+  }
   
-  // Test internetverbinding
-  if (WiFi.status() != WL_CONNECTED) {
-    lastEmailError = "Geen WiFi-verbinding";
-    Serial.println("FOUT: Geen WiFi-verbinding, kan geen e-mail versturen");
-    return false;
+  if (millis() - emailServiceStartTime < EMAIL_STARTUP_DELAY) {
+    return;
   }
   
-  if (!emailClientReady) {
-    lastEmailError = "E-mail client niet geïnitialiseerd";
-    Serial.println("FOUT: E-mail client niet geïnitialiseerd");
-    return false;
+  if (lastEmailQueued != 0 && millis() - lastEmailQueued < MIN_EMAIL_INTERVAL) {
+    return;
   }
   
-  // Bereid het bericht voor
-  SMTP_Message emailMessage;
+  // Laat het overzicht wachten als de wachtrij vol zit
+  if (WiFi.status() == WL_CONNECTED && getEmailQueueSpace() == 0) {
+    return;
+  }
   
-  // Stel de bericht headers in
-  emailMessage.sender.name = "ESP32 Hydro Controller";
-  emailMessage.sender.email = settings.emailUsername;
-  emailMessage.subject = subject.c_str();
-  emailMessage.addRecipient("Hydroponisch Systeem", settings.emailRecipient);
+  static char digest[EMAIL_BODY_LEN];
+  uint32_t count = emailDigestBuild(digest, sizeof(digest) - 200);  // Ruimte voor de systeemgegevens
   
-  // Haal datum en tijd op
-  String currentDateTime = getFullDateTimeString();
-  
-  // Maak de inhoud van het bericht
-  String textContent = message;
-  textContent += "\n\n---------------------------\n";
-  textContent += "Systeem: ";
-  textContent += settings.systeemnaam;
-  textContent += "\nTijdstip: ";
-  textContent += currentDateTime;
-  textContent += "\nHuidige temperatuur: ";
-  textContent += String(currentTemp);
-  textContent += "°C\n";
-  
-  #ifdef ENABLE_FLOW_SENSOR
-  textContent += "Huidige waterstroming: ";
-  textContent += String(flowRate);
-  textContent += " L/min\n";
-  textContent += "Totaal doorgestroomd: ";
-  textContent += String(totalLiters);
-  textContent += " L\n";
-  #endif
+  char countText[12];
+  char subject[EMAIL_SUBJECT_LEN];
+  snprintf(countText, sizeof(countText), "%lu", (unsigned long)count);
+  renderEmailTemplate(subject, sizeof(subject), EMAIL_TPL_DIGEST_SUBJECT, countText);
   
-  // Stel de tekst in
-  emailMessage.text.content = textContent.c_str();
-  emailMessage.text.charSet = "utf-8";
-  emailMessage.text.transfer_encoding = Content_Transfer_Encoding::enc_7bit;
-  emailMessage.priority = esp_mail_smtp_priority::esp_mail_smtp_priority_normal;
+  EmailJob& job = composeEmailJob(subject, digest, true, false);
   
-  // Verbind met de server en verzend de e-mail
-  Serial.println("Test e-mail verzenden...");
+  if (!dispatchEmailJob(job)) {
+    Serial.println("FOUT: Overzicht kon niet worden verzonden");
+  } else {
+    Serial.print("Overzicht verzonden met waarschuwingen: ");
+    Serial.println(count);
+  }
   
-  // Verbind met de server
-  if (!smtp.connect(&config)) {
-    lastEmailError = "Kan niet verbinden met e-mailserver";
-    Serial.println("FOUT: Kan niet verbinden met e-mailserver");
+  lastEmailQueued = millis();
+}
+
+// Verstuur test e-mail
+bool sendTestEmail() {
+  // Deze functie omzeilt de opstarttijd en de interval check voor test doeleinden
+  if (!emailClientReady) {
+    setEmailError("E-mail client niet geïnitialiseerd");
+    Serial.println("FOUT: E-mail client niet geïnitialiseerd");
     return false;
   }
   
-  // Verzend het bericht
-  if (!MailClient.sendMail(&smtp, &emailMessage)) {
-    lastEmailError = String(smtp.errorReason());
-    Serial.println("FOUT: Verzenden test e-mail mislukt");
-    Serial.println(smtp.errorReason());
+  if (WiFi.status() != WL_CONNECTED) {
+    setEmailError("Geen WiFi-verbinding");
+    Serial.println("FOUT: Geen WiFi-verbinding, kan geen e-mail versturen");
     return false;
   }
   
-  Serial.println("Test e-mail succesvol verzonden");
-  // We updaten lastEmailSent NIET voor testmails om het normale alarm systeem niet te beïnvloeden
-  return true;
+  EmailJob& job = composeEmailJob(EMAIL_TPL_TEST_SUBJECT, EMAIL_TPL_TEST_MESSAGE, false, true);
+  
+  bool result = enqueueEmailJob(job);
+  if (result) {
+    Serial.println("Test e-mail in wachtrij geplaatst");
+  }
+  return result;
 }
 
 // Genereer JSON met e-mail status
 String getEmailStatusJson() {
-  DynamicJsonDocument doc(512);
+  DynamicJsonDocument doc(1024);
   
   doc["emailReady"] = emailClientReady;
-  doc["lastEmailSent"] = lastEmailSent;
-  doc["lastEmailError"] = lastEmailError;
+  doc["lastEmailError"] = getLastEmailError();
+  
+  if (emailStatusMutex != NULL) {
+    xSemaphoreTake(emailStatusMutex, portMAX_DELAY);
+    doc["lastEmailSent"] = lastEmailSent;
+    doc["sending"] = emailSending;
+    doc["sent"] = emailsSent;
+    doc["failed"] = emailsFailed;
+    doc["dropped"] = emailsDropped;
+    doc["retries"] = emailRetries;
+    doc["lastSendMs"] = lastSendDuration;
+    doc["heapBlockBefore"] = heapBlockBefore;
+    doc["heapBlockAfter"] = heapBlockAfter;
+    doc["heapBlockMin"] = heapBlockMin;
+    doc["sessionOpen"] = sessionOpen;
+    doc["connects"] = sessionConnects;
+    doc["sessionReuses"] = sessionReuses;
+    doc["lastConnectMs"] = lastConnectDuration;
+    doc["avgConnectMs"] = sessionConnects > 0 ? totalConnectDuration / sessionConnects : 0;
+    xSemaphoreGive(emailStatusMutex);
+    
+    doc["queued"] = uxQueueMessagesWaiting(emailQueue);
+    doc["queueSize"] = EMAIL_QUEUE_LENGTH;
+    
+    JsonObject outbox = doc.createNestedObject("outbox");
+    addEmailOutboxJson(outbox);
+    
+    JsonObject digest = doc.createNestedObject("digest");
+    addEmailDigestJson(digest);
+  } else {
+    doc["lastEmailSent"] = lastEmailSent;
+  }
   
   // Bereken tijd sinds laatste e-mail
-  unsigned long timeSince = millis() - lastEmailSent;
+  unsigned long timeSince = millis() - lastEmailQueued;
   unsigned long minutesSince = timeSince / 60000;
   
   doc["minutesSinceLastEmail"] = minutesSince;
-  doc["canSendEmail"] = (timeSince > MIN_EMAIL_INTERVAL);
+  doc["digestWindowOpen"] = (lastEmailQueued != 0 && timeSince < MIN_EMAIL_INTERVAL);
   
   String response;
   serializeJson(doc, response);
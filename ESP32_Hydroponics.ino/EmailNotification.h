@@ -25,18 +25,28 @@
 #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
   #include <ESP_Mail_Client.h>
   
+  #define EMAIL_SUBJECT_LEN 96
+  #define EMAIL_BODY_LEN 640
+  #define EMAIL_ERROR_LEN 96
+  
+  // Een volledig samengesteld bericht zoals het in de wachtrij staat
+  struct EmailJob {
+    char subject[EMAIL_SUBJECT_LEN];
+    char body[EMAIL_BODY_LEN];
+    bool highPriority;
+    bool isTest;
+    unsigned long queuedAt;
+    uint32_t outboxSeq;    // Volgnummer in de outbox, 0 = nieuw bericht
+  };
+  
   // Externe variabelen
   extern bool emailClientReady;
-  extern unsigned long lastEmailSent;
-  extern String lastEmailError;
+  extern char lastEmailError[];
   
   // Functieprototypes
-  void setupEmailNotification();
-  bool sendFlowAlertEmail();
-  bool sendTestEmail();
-  bool sendEmailAlert(const char* subject, const char* message);
-  String getLastEmailError();
-  String getEmailStatusJson();
+  bool sendEmailAlert(const char* subject, const char* message, const char* subsystem = "Systeem", bool critical = false);
+  bool enqueueEmailJob(const EmailJob& job);
+  int getEmailQueueSpace();
   
   // Hernoem de setupEmailClient functie naar setupEmailNotification voor compatibiliteit
   #define setupEmailClient setupEmailNotification
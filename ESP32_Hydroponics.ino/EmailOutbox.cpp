@@ -0,0 +1,422 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * EmailOutbox.cpp
+ *
+ * Persistente outbox voor waarschuwingen die niet direct verzonden kunnen
+ * worden (geen WiFi, server onbereikbaar). Elke waarschuwing wordt met het
+ * oorspronkelijke tijdstip opgeslagen in een vaste ronde van OUTBOX_SLOTS
+ * sleutels in NVS, zodat ze ook een herstart overleeft. Herhalingen van
+ * dezelfde waarschuwing (zelfde onderwerp) worden samengevoegd tot één
+ * bericht met een teller. Is de outbox vol, dan vervalt de oudste.
+ *
+ * Na herstel van de WiFi-verbinding wordt de outbox rustig geleegd: één
+ * bericht tegelijk en hooguit één per OUTBOX_FLUSH_INTERVAL, oudste eerst,
+ * zodat de e-mail taak en de SMTP-server niet in één keer overspoeld worden.
+ * Het interval is korter dan de tijd dat de e-mail taak een SMTP-sessie
+ * openhoudt, zodat de hele outbox één TLS-verbinding kost. Het record blijft
+ * in NVS staan tot de e-mail taak meldt dat het bericht verzonden is;
+ * mislukt het verzenden, dan blijft het record ongewijzigd (zelfde tijdstip,
+ * teller en samenvoegsleutel) voor een volgende poging. De markering "[Uitgesteld]" en
+ * het oorspronkelijke tijdstip worden pas bij het verzenden toegevoegd.
+ */
+
+#include "EmailOutbox.h"
+#include <Preferences.h>
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+
+// Outbox record zoals opgeslagen in NVS
+struct OutboxRecord {
+  uint32_t seq;            // Volgnummer, laagste is het oudste
+  uint32_t hash;           // Hash van het onderwerp voor het samenvoegen
+  uint32_t firstEpoch;     // Tijdstip van de eerste melding (0 = tijd onbekend)
+  uint32_t lastEpoch;      // Tijdstip van de laatste herhaling
+  uint16_t count;          // Aantal keer gemeld
+  bool highPriority;
+  EmailJob job;            // Het bericht zoals het oorspronkelijk is samengesteld
+};
+
+// Index in RAM, zodat zoeken geen flash leest
+struct OutboxSlot {
+  bool used;
+  uint32_t seq;
+  uint32_t hash;
+  bool sending;                // Aangeboden aan de e-mail taak, uitslag nog niet bekend
+  unsigned long sendingSince;
+};
+
+Preferences outboxPrefs;
+static OutboxSlot outboxSlots[OUTBOX_SLOTS];
+static SemaphoreHandle_t outboxMutex = NULL;
+static uint32_t outboxSeq = 0;
+static bool outboxReady = false;
+
+// Leeg-planning
+static unsigned long outboxNextFlush = 0;
+
+// Statistieken sinds opstarten
+static uint32_t outboxStored = 0;
+static uint32_t outboxMerged = 0;
+static uint32_t outboxDropped = 0;
+static uint32_t outboxFlushed = 0;
+
+// FNV-1a hash van het onderwerp
+static uint32_t outboxHash(const char* text) {
+  uint32_t hash = 2166136261UL;
+  while (*text) {
+    hash ^= (uint8_t)*text++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// Huidige tijd als epoch, 0 als de tijd nog niet gesynchroniseerd is
+static uint32_t outboxNow() {
+  time_t now = time(nullptr);
+  return (now > 1577836800) ? (uint32_t)now : 0;  // 1-1-2020
+}
+
+static void outboxKey(char* key, size_t size, int slot) {
+  snprintf(key, size, "m%d", slot);
+}
+
+// Laad de index van de outbox uit NVS
+void setupEmailOutbox() {
+  if (outboxReady) {
+    return;
+  }
+  
+  outboxMutex = xSemaphoreCreateMutex();
+  if (outboxMutex == NULL) {
+    Serial.println("FOUT: Kan outbox niet initialiseren");
+    return;
+  }
+  
+  outboxPrefs.begin(OUTBOX_NAMESPACE, false);
+  
+  int pending = 0;
+  for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+    char key[8];
+    outboxKey(key, sizeof(key), slot);
+    
+    OutboxRecord record;
+    outboxSlots[slot].used = false;
+    outboxSlots[slot].sending = false;
+    
+    if (outboxPrefs.getBytes(key, &record, sizeof(record)) != sizeof(record)) {
+      continue;
+    }
+    
+    outboxSlots[slot].used = true;
+    outboxSlots[slot].seq = record.seq;
+    outboxSlots[slot].hash = record.hash;
+    if (record.seq > outboxSeq) {
+      outboxSeq = record.seq;
+    }
+    pending++;
+  }
+  
+  outboxReady = true;
+  
+  if (pending > 0) {
+    Serial.print("Outbox bevat ");
+    Serial.print(pending);
+    Serial.println(" niet verzonden waarschuwing(en)");
+  }
+}
+
+// Bewaar een waarschuwing in de outbox. Wordt aangeroepen vanuit de loop()
+// en vanuit de e-mail taak, daarom beschermd door outboxMutex.
+bool emailOutboxStore(const EmailJob& job) {
+  if (!outboxReady) {
+    return false;
+  }
+  
+  uint32_t hash = outboxHash(job.subject);
+  uint32_t now = outboxNow();
+  bool result = false;
+  
+  xSemaphoreTake(outboxMutex, portMAX_DELAY);
+  
+  OutboxRecord record;
+  char key[8];
+  int target = -1;
+  
+  // Zelfde waarschuwing al aanwezig? Dan alleen teller en tijdstip bijwerken.
+  // Niet bij een bericht dat net verzonden wordt: die herhaling zou na het
+  // verzenden met het record verdwijnen.
+  for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+    if (outboxSlots[slot].used && !outboxSlots[slot].sending && outboxSlots[slot].hash == hash) {
+      outboxKey(key, sizeof(key), slot);
+      if (outboxPrefs.getBytes(key, &record, sizeof(record)) == sizeof(record)) {
+        target = slot;
+      }
+      break;
+    }
+  }
+  
+  if (target >= 0) {
+    record.count++;
+    record.lastEpoch = now;
+    result = outboxPrefs.putBytes(key, &record, sizeof(record)) == sizeof(record);
+    if (result) {
+      outboxMerged++;
+    }
+  } else {
+    // Zoek een vrij slot, anders vervalt het oudste bericht (niet het bericht dat net verzonden wordt)
+    for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+      if (!outboxSlots[slot].used) {
+        target = slot;
+        break;
+      }
+      if (!outboxSlots[slot].sending && (target < 0 || outboxSlots[slot].seq < outboxSlots[target].seq)) {
+        target = slot;
+      }
+    }
+    
+    if (outboxSlots[target].used) {
+      outboxDropped++;
+      Serial.println("WAARSCHUWING: Outbox vol, oudste waarschuwing vervalt");
+    }
+    
+    record.seq = ++outboxSeq;
+    record.hash = hash;
+    record.firstEpoch = now;
+    record.lastEpoch = now;
+    record.count = 1;
+    record.highPriority = job.highPriority;
+    record.job = job;
+    record.job.outboxSeq = 0;
+    
+    outboxKey(key, sizeof(key), target);
+    result = outboxPrefs.putBytes(key, &record, sizeof(record)) == sizeof(record);
+    if (result) {
+      outboxSlots[target].used = true;
+      outboxSlots[target].seq = record.seq;
+      outboxSlots[target].hash = hash;
+      outboxSlots[target].sending = false;
+      outboxStored++;
+    } else {
+      outboxSlots[target].used = false;
+    }
+  }
+  
+  xSemaphoreGive(outboxMutex);
+  
+  if (!result) {
+    Serial.println("FOUT: Kon waarschuwing niet in outbox opslaan");
+  }
+  return result;
+}
+
+// WiFi is (opnieuw) verbonden: begin na een korte wachttijd met legen
+void emailOutboxOnReconnect() {
+  outboxNextFlush = millis() + OUTBOX_SETTLE_DELAY;
+  
+  if (getEmailOutboxCount() > 0) {
+    Serial.println("WiFi hersteld, outbox wordt verzonden");
+  }
+}
+
+// Verstuur hoogstens één bewaarde waarschuwing per OUTBOX_FLUSH_INTERVAL
+void processEmailOutbox() {
+  if (!outboxReady || !emailClientReady || WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  
+  if ((long)(millis() - outboxNextFlush) < 0) {
+    return;
+  }
+  
+  // Laat de wachtrij eerst leeglopen voordat er oude berichten bij komen
+  if (getEmailQueueSpace() < 2) {
+    return;
+  }
+  
+  xSemaphoreTake(outboxMutex, portMAX_DELAY);
+  
+  // Eén bericht tegelijk; blijft de uitslag uit, dan later opnieuw aanbieden
+  for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+    if (outboxSlots[slot].used && outboxSlots[slot].sending) {
+      if (millis() - outboxSlots[slot].sendingSince < OUTBOX_SEND_TIMEOUT) {
+        xSemaphoreGive(outboxMutex);
+        return;
+      }
+      outboxSlots[slot].sending = false;
+    }
+  }
+  
+  // Oudste bericht eerst
+  int oldest = -1;
+  for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+    if (outboxSlots[slot].used && (oldest < 0 || outboxSlots[slot].seq < outboxSlots[oldest].seq)) {
+      oldest = slot;
+    }
+  }
+  
+  if (oldest < 0) {
+    xSemaphoreGive(outboxMutex);
+    return;
+  }
+  
+  char key[8];
+  outboxKey(key, sizeof(key), oldest);
+  
+  OutboxRecord record;
+  bool valid = outboxPrefs.getBytes(key, &record, sizeof(record)) == sizeof(record) &&
+               record.seq == outboxSlots[oldest].seq;
+  
+  if (!valid) {
+    // Onleesbaar record: opruimen
+    outboxPrefs.remove(key);
+    outboxSlots[oldest].used = false;
+    xSemaphoreGive(outboxMutex);
+    return;
+  }
+  
+  // Het bericht gaat ongewijzigd naar de e-mail taak; het record blijft staan
+  EmailJob job = record.job;
+  job.highPriority = record.highPriority;
+  job.isTest = false;
+  job.queuedAt = millis();
+  job.outboxSeq = record.seq;
+  
+  if (enqueueEmailJob(job)) {
+    outboxSlots[oldest].sending = true;
+    outboxSlots[oldest].sendingSince = millis();
+  }
+  
+  xSemaphoreGive(outboxMutex);
+  
+  outboxNextFlush = millis() + OUTBOX_FLUSH_INTERVAL;
+}
+
+// Zoek het slot van een outbox record op volgnummer (onder outboxMutex)
+static int findOutboxSlot(uint32_t seq) {
+  for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+    if (outboxSlots[slot].used && outboxSlots[slot].seq == seq) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+static void formatOutboxTime(char* buffer, size_t size, uint32_t epoch) {
+  if (epoch == 0) {
+    snprintf(buffer, size, "onbekend");
+    return;
+  }
+  time_t t = epoch;
+  struct tm timeinfo;
+  localtime_r(&t, &timeinfo);
+  strftime(buffer, size, "%d-%m-%Y %H:%M:%S", &timeinfo);
+}
+
+// E-mail taak, vlak voor het verzenden: markeer een bericht uit de outbox als
+// uitgesteld en voeg het oorspronkelijke tijdstip en de herhalingen toe
+void emailOutboxPrepareSend(EmailJob& job) {
+  if (job.outboxSeq == 0 || !outboxReady) {
+    return;
+  }
+  
+  xSemaphoreTake(outboxMutex, portMAX_DELAY);
+  
+  OutboxRecord record;
+  int slot = findOutboxSlot(job.outboxSeq);
+  bool valid = false;
+  if (slot >= 0) {
+    char key[8];
+    outboxKey(key, sizeof(key), slot);
+    valid = outboxPrefs.getBytes(key, &record, sizeof(record)) == sizeof(record);
+  }
+  
+  xSemaphoreGive(outboxMutex);
+  
+  if (!valid) {
+    return;
+  }
+  
+  snprintf(job.subject, sizeof(job.subject), "[Uitgesteld] %s", record.job.subject);
+  
+  char first[24];
+  char last[24];
+  formatOutboxTime(first, sizeof(first), record.firstEpoch);
+  formatOutboxTime(last, sizeof(last), record.lastEpoch);
+  
+  size_t len = strlen(job.body);
+  if (record.count > 1) {
+    snprintf(job.body + len, sizeof(job.body) - len,
+             "\nUitgesteld bericht, eerste melding: %s\nHerhaald: %u keer, laatste: %s\n",
+             first, record.count, last);
+  } else {
+    snprintf(job.body + len, sizeof(job.body) - len,
+             "\nUitgesteld bericht, oorspronkelijk gemeld: %s\n", first);
+  }
+}
+
+// E-mail taak, na de laatste poging. Een nieuw bericht gaat bij mislukken de
+// outbox in (testmails niet); een bericht uit de outbox wordt pas na
+// verzenden verwijderd en blijft anders ongewijzigd staan.
+void emailOutboxSendResult(const EmailJob& job, bool sent) {
+  if (job.outboxSeq == 0) {
+    if (!sent && !job.isTest) {
+      emailOutboxStore(job);
+    }
+    return;
+  }
+  
+  if (!outboxReady) {
+    return;
+  }
+  
+  xSemaphoreTake(outboxMutex, portMAX_DELAY);
+  
+  int slot = findOutboxSlot(job.outboxSeq);
+  if (slot >= 0) {
+    if (sent) {
+      char key[8];
+      outboxKey(key, sizeof(key), slot);
+      outboxPrefs.remove(key);
+      outboxSlots[slot].used = false;
+      outboxFlushed++;
+    }
+    outboxSlots[slot].sending = false;
+  }
+  
+  xSemaphoreGive(outboxMutex);
+}
+
+// Aantal waarschuwingen in de outbox
+int getEmailOutboxCount() {
+  int count = 0;
+  for (int slot = 0; slot < OUTBOX_SLOTS; slot++) {
+    if (outboxSlots[slot].used) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Voeg outbox status toe aan een JSON object
+void addEmailOutboxJson(JsonObject obj) {
+  obj["pending"] = getEmailOutboxCount();
+  obj["size"] = OUTBOX_SLOTS;
+  obj["stored"] = outboxStored;
+  obj["merged"] = outboxMerged;
+  obj["dropped"] = outboxDropped;
+  obj["flushed"] = outboxFlushed;
+}
+
+#endif // defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
@@ -0,0 +1,43 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * EmailOutbox.h
+ *
+ * Header voor de persistente outbox van e-mailwaarschuwingen
+ */
+
+#ifndef EMAIL_OUTBOX_H
+#define EMAIL_OUTBOX_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+  #include "EmailNotification.h"
+  
+  #define OUTBOX_NAMESPACE "outbox"       // NVS namespace voor de outbox
+  #define OUTBOX_SLOTS 6                  // Maximaal aantal bewaarde waarschuwingen
+  #define OUTBOX_SETTLE_DELAY 10000       // Wachttijd na herstel van WiFi
+  #define OUTBOX_FLUSH_INTERVAL 5000      // Minimale tijd tussen twee uitgestelde e-mails, korter dan EMAIL_SESSION_IDLE
+  #define OUTBOX_SEND_TIMEOUT 600000      // Geen uitslag van de e-mail taak binnen 10 minuten: opnieuw aanbieden
+  
+  // Functieprototypes
+  void setupEmailOutbox();
+  bool emailOutboxStore(const EmailJob& job);
+  void emailOutboxPrepareSend(EmailJob& job);
+  void emailOutboxSendResult(const EmailJob& job, bool sent);
+  int getEmailOutboxCount();
+  void addEmailOutboxJson(JsonObject obj);
+#endif
+
+#endif // EMAIL_OUTBOX_H
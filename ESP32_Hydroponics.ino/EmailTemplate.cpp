@@ -0,0 +1,120 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * EmailTemplate.cpp
+ *
+ * Vaste e-mailsjablonen in flash en een kleine renderer die ze zonder
+ * heap-allocaties in een opgegeven buffer invult. Ondersteunde velden:
+ *   {SYS}    systeemnaam
+ *   {TIME}   huidige datum en tijd
+ *   {TEMP}   huidige temperatuur
+ *   {FLOW}   huidige waterstroming
+ *   {LITERS} totaal doorgestroomd sinds reset
+ *   {MSG}    de door de aanroeper meegegeven tekst
+ * Onbekende velden worden letterlijk overgenomen. De uitvoer wordt afgekapt
+ * op de buffergrootte en is altijd afgesloten met een nul.
+ */
+
+#include "EmailTemplate.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+
+const char EMAIL_TPL_ALERT_BODY[] PROGMEM =
+  "{MSG}\n\n"
+  "---------------------------\n"
+  "Systeem: {SYS}\n"
+  "Tijdstip: {TIME}\n"
+  "Huidige temperatuur: {TEMP}°C\n"
+  "Huidige waterstroming: {FLOW} L/min\n"
+  "Totaal doorgestroomd: {LITERS} L\n";
+
+const char EMAIL_TPL_TEST_SUBJECT[] PROGMEM = "Test Email - ESP32 Hydro Systeem";
+
+const char EMAIL_TPL_TEST_MESSAGE[] PROGMEM =
+  "Dit is een test e-mail van je ESP32 Hydroponisch Systeem Controller.\n"
+  "Als je deze e-mail ontvangt, is de e-mailconfiguratie correct.";
+
+const char EMAIL_TPL_DIGEST_SUBJECT[] PROGMEM = "Overzicht: {MSG} waarschuwing(en) in {SYS}";
+
+// Kopieer tekst naar de uitvoer, afgekapt op de ruimte die er is
+static size_t appendText(char* out, size_t size, size_t len, const char* text) {
+  while (*text && len + 1 < size) {
+    out[len++] = *text++;
+  }
+  return len;
+}
+
+// Vul een sjabloon in. Geeft de lengte van de uitvoer terug.
+size_t renderEmailTemplate(char* out, size_t size, const char* tpl, const char* message) {
+  if (size == 0) {
+    return 0;
+  }
+  
+  size_t len = 0;
+  char field[24];
+  
+  while (*tpl && len + 1 < size) {
+    if (*tpl != '{') {
+      out[len++] = *tpl++;
+      continue;
+    }
+    
+    // Zoek het einde van de veldnaam
+    const char* end = strchr(tpl, '}');
+    if (end == NULL || end - tpl > 8) {
+      out[len++] = *tpl++;
+      continue;
+    }
+    
+    size_t nameLen = end - tpl - 1;
+    const char* name = tpl + 1;
+    
+    if (nameLen == 3 && strncmp(name, "SYS", 3) == 0) {
+      len = appendText(out, size, len, settings.systeemnaam);
+    } else if (nameLen == 3 && strncmp(name, "MSG", 3) == 0) {
+      len = appendText(out, size, len, message ? message : "");
+    } else if (nameLen == 4 && strncmp(name, "TIME", 4) == 0) {
+      // Niet-blokkerend: geen wachten op tijdsynchronisatie
+      time_t now = time(nullptr);
+      if (now > 1577836800) {  // 1-1-2020
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+        strftime(field, sizeof(field), "%d-%m-%Y %H:%M:%S", &timeinfo);
+        len = appendText(out, size, len, field);
+      } else {
+        len = appendText(out, size, len, "Datum/tijd niet beschikbaar");
+      }
+    } else if (nameLen == 4 && strncmp(name, "TEMP", 4) == 0) {
+      snprintf(field, sizeof(field), "%.2f", currentTemp);
+      len = appendText(out, size, len, field);
+    } else if (nameLen == 4 && strncmp(name, "FLOW", 4) == 0) {
+      snprintf(field, sizeof(field), "%.2f", flowRate);
+      len = appendText(out, size, len, field);
+    } else if (nameLen == 6 && strncmp(name, "LITERS", 6) == 0) {
+      snprintf(field, sizeof(field), "%.2f", totalLiters);
+      len = appendText(out, size, len, field);
+    } else {
+      // Onbekend veld: letterlijk overnemen
+      out[len++] = *tpl++;
+      continue;
+    }
+    
+    tpl = end + 1;
+  }
+  
+  out[len] = '\0';
+  return len;
+}
+
+#endif // defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
@@ -0,0 +1,36 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * EmailTemplate.h
+ *
+ * Header voor de vaste e-mailsjablonen
+ */
+
+#ifndef EMAIL_TEMPLATE_H
+#define EMAIL_TEMPLATE_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+  // Sjablonen in flash
+  extern const char EMAIL_TPL_ALERT_BODY[];
+  extern const char EMAIL_TPL_TEST_SUBJECT[];
+  extern const char EMAIL_TPL_TEST_MESSAGE[];
+  extern const char EMAIL_TPL_DIGEST_SUBJECT[];
+  
+  // Functieprototypes
+  size_t renderEmailTemplate(char* out, size_t size, const char* tpl, const char* message);
+#endif
+
+#endif // EMAIL_TEMPLATE_H
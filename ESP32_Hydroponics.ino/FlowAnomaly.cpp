@@ -0,0 +1,280 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowAnomaly.cpp
+ *
+ * Streaming anomaliedetectie voor de waterstroming. Per pomptoestand (aan/uit)
+ * wordt een basislijn geleerd met een langzaam exponentieel gewogen gemiddelde
+ * en variantie, naast een snelle variant die het recente gedrag volgt. Drie
+ * afwijkingen worden los van elkaar gemeld:
+ *
+ * - Drift: het recente gemiddelde wijkt structureel af (verstopt filter, of
+ *   stroming terwijl de pomp uit staat)
+ * - Val: meerdere samples op rij ver onder de basislijn (lek, leiding los)
+ * - Ruis: de recente variantie is veel groter dan normaal (lucht in systeem)
+ *
+ * Geheugen en rekentijd per sample zijn constant. De rekenkern
+ * (flowEwmaUpdate/flowStatsUpdate) gebruikt geen hardware en kan met
+ * opgenomen pulsreeksen op een PC worden nagespeeld.
+ */
+
+#include "FlowAnomaly.h"
+#include "FlowSensor.h"
+#include "FlowRamp.h"
+#include "Notification.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+
+// Statistiek per pomptoestand
+FlowStateStats pumpOnStats = {};
+FlowStateStats pumpOffStats = {};
+
+// Samenvoegen van meetintervallen tot samples van 1 seconde
+float windowLiters = 0.0;
+unsigned long windowMs = 0;
+bool windowPumpState = false;
+
+// Werk een EWMA gemiddelde en variantie bij (incrementele vorm, O(1))
+void flowEwmaUpdate(FlowEwma &ewma, float sample, float alpha) {
+  float diff = sample - ewma.mean;
+  float increment = alpha * diff;
+  ewma.mean += increment;
+  ewma.variance = (1.0 - alpha) * (ewma.variance + diff * increment);
+}
+
+// Pas hysterese toe op één alarmklasse: direct actief, pas hersteld na
+// ANOMALY_CLEAR_SAMPLES samples op rij onder de (lagere) hersteldrempel
+static void applyHysteresis(FlowStateStats &stats, uint8_t bit, int index, bool raised, bool holding) {
+  if (raised) {
+    stats.active |= bit;
+    stats.clearCount[index] = 0;
+  } else if (stats.active & bit) {
+    if (holding) {
+      stats.clearCount[index] = 0;
+    } else if (++stats.clearCount[index] >= ANOMALY_CLEAR_SAMPLES) {
+      stats.active &= ~bit;
+      stats.clearCount[index] = 0;
+    }
+  }
+}
+
+// Verwerk één sample en geef de actieve afwijkingen terug als bitmasker
+uint8_t flowStatsUpdate(FlowStateStats &stats, float sampleLPM) {
+  stats.samples++;
+  
+  // Inleren: de basislijn is het gewone gemiddelde van alle samples tot nu toe,
+  // zodat een afwijkend eerste sample (vullen, aanloop) geen blijvende invloed heeft
+  if (stats.samples <= ANOMALY_WARMUP_SAMPLES) {
+    float alpha = 1.0 / stats.samples;
+    flowEwmaUpdate(stats.baseline, sampleLPM, alpha);
+    flowEwmaUpdate(stats.fast, sampleLPM, max(alpha, (float)ANOMALY_FAST_ALPHA));
+    return 0;
+  }
+  
+  flowEwmaUpdate(stats.fast, sampleLPM, ANOMALY_FAST_ALPHA);
+  
+  float baseMean = stats.baseline.mean;
+  float baseSigma = sqrtf(stats.baseline.variance);
+  float driftLimit = max((float)ANOMALY_DRIFT_MIN_LPM, fabsf(baseMean) * (float)ANOMALY_DRIFT_FRACTION);
+  float deviation = fabsf(stats.fast.mean - baseMean);
+  float noiseFloor = ANOMALY_NOISE_MIN_LPM * ANOMALY_NOISE_MIN_LPM;
+  
+  // Val: sample ver onder de basislijn
+  float dropLimit = min(baseMean * (float)(1.0 - ANOMALY_DROP_FRACTION),
+                        baseMean - (float)ANOMALY_DROP_SIGMA * baseSigma);
+  if (baseMean > ANOMALY_DRIFT_MIN_LPM && sampleLPM < dropLimit) {
+    if (stats.lowStreak < 255) {
+      stats.lowStreak++;
+    }
+  } else {
+    stats.lowStreak = 0;
+  }
+  
+  // Drift: recent gemiddelde structureel verschoven
+  bool drift = deviation > driftLimit;
+  
+  // Val: meerdere samples op rij onder de valdrempel
+  bool drop = stats.lowStreak >= ANOMALY_DROP_SAMPLES;
+  
+  // Ruis: recente variantie veel groter dan de geleerde. Een sprong in het
+  // niveau geeft ook kortstondig een hoge variantie, die telt als val of drift.
+  bool noisy = stats.fast.variance > noiseFloor &&
+               stats.fast.variance > ANOMALY_NOISE_RATIO * stats.baseline.variance;
+  bool noise = !drift && !drop && stats.lowStreak == 0 && noisy;
+  
+  // Hersteld pas ruim onder de drempel, zodat een waarde rond de grens niet blijft wisselen
+  bool driftHolding = deviation > driftLimit * (float)ANOMALY_CLEAR_MARGIN;
+  bool noiseHolding = stats.fast.variance > noiseFloor &&
+                      stats.fast.variance > ANOMALY_NOISE_RATIO * ANOMALY_CLEAR_MARGIN * stats.baseline.variance;
+  applyHysteresis(stats, FLOW_ANOMALY_DRIFT, 0, drift, driftHolding);
+  applyHysteresis(stats, FLOW_ANOMALY_DROP, 1, drop, stats.lowStreak > 0);
+  applyHysteresis(stats, FLOW_ANOMALY_NOISE, 2, noise, noiseHolding);
+  
+  // Leer de basislijn alleen van normaal gedrag, anders wordt een
+  // langzame verstopping gewoon de nieuwe norm
+  if (!drift && !drop && !noise && stats.lowStreak == 0 && deviation < driftLimit * (float)ANOMALY_LEARN_FRACTION) {
+    flowEwmaUpdate(stats.baseline, sampleLPM, ANOMALY_BASE_ALPHA);
+  }
+  
+  // Een drift die lang en rustig aanhoudt is een nieuw niveau (ander filter,
+  // andere opvoerhoogte): na een uur melden alsnog langzaam het gemiddelde
+  // volgen. De variantie blijft staan, de sprong is geen ruis.
+  // Dat gaat door tot het gewone leren het weer overneemt.
+  bool steady = !drop && !noisy && stats.lowStreak == 0;
+  if (stats.driftStreak >= ANOMALY_RELEARN_SAMPLES) {
+    if (steady) {
+      stats.baseline.mean += ANOMALY_BASE_ALPHA * (sampleLPM - stats.baseline.mean);
+    }
+    if (deviation < driftLimit * (float)ANOMALY_LEARN_FRACTION) {
+      stats.driftStreak = 0;
+    }
+  } else if (drift && steady) {
+    stats.driftStreak++;
+  } else if (!driftHolding) {
+    stats.driftStreak = 0;
+  }
+  
+  return stats.active;
+}
+
+// Omschrijving per alarmklasse
+const char* flowAnomalyName(uint8_t anomaly) {
+  switch (anomaly) {
+    case FLOW_ANOMALY_DRIFT: return "drift";
+    case FLOW_ANOMALY_DROP: return "drop";
+    case FLOW_ANOMALY_NOISE: return "noise";
+    default: return "onbekend";
+  }
+}
+
+// Meld een nieuw opgetreden afwijking
+void reportFlowAnomaly(uint8_t anomaly, bool pumpOn, const FlowStateStats &stats) {
+  char subject[96];
+  char message[384];
+  
+  const char* cause;
+  switch (anomaly) {
+    case FLOW_ANOMALY_DRIFT:
+      cause = pumpOn ? "De waterstroming wijkt structureel af van normaal. Mogelijk een verstopt filter of een lek."
+                     : "Er is waterstroming gemeten terwijl de pomp uit staat. Mogelijk een hevelwerking of lek.";
+      break;
+    case FLOW_ANOMALY_DROP:
+      cause = "De waterstroming is plotseling sterk gedaald. Mogelijk een lek of losgeschoten leiding.";
+      break;
+    default:
+      cause = "De waterstroming is onrustig. Mogelijk zit er lucht in het systeem.";
+      break;
+  }
+  
+  snprintf(subject, sizeof(subject), "WAARSCHUWING: Afwijkende waterstroming (%s) in %s",
+           flowAnomalyName(anomaly), settings.systeemnaam);
+  snprintf(message, sizeof(message),
+           "%s\n\nPomp: %s\nNormale stroming: %.2f L/min (sd %.2f)\nRecente stroming: %.2f L/min (sd %.2f)",
+           cause, pumpOn ? "AAN" : "UIT",
+           stats.baseline.mean, sqrtf(stats.baseline.variance),
+           stats.fast.mean, sqrtf(stats.fast.variance));
+  
+  Serial.println(subject);
+  
+  if (settings.flowAlertEnabled) {
+    char kind[16];
+    snprintf(kind, sizeof(kind), "flow_%s", flowAnomalyName(anomaly));
+    
+    // Een plotselinge val (lek) is kritiek, drift en ruis mogen gebundeld worden
+    AlertEvent event = { kind, "Flow", subject, message, anomaly == FLOW_ANOMALY_DROP, 0 };
+    notifyAlert(event);
+  }
+}
+
+// Verwerk een afgerond sample van 1 seconde
+void processFlowSample(float sampleLPM, bool pumpOn) {
+  FlowStateStats &stats = pumpOn ? pumpOnStats : pumpOffStats;
+  uint8_t previous = stats.active;
+  uint8_t anomalies = flowStatsUpdate(stats, sampleLPM);
+  
+  // Meld alleen nieuw opgetreden klassen; een alarm blijft over pompcycli
+  // heen actief zodat een aanhoudende verstopping niet elke cyclus mailt
+  uint8_t raised = anomalies & ~previous;
+  for (uint8_t bit = FLOW_ANOMALY_DRIFT; bit <= FLOW_ANOMALY_NOISE; bit <<= 1) {
+    if (raised & bit) {
+      reportFlowAnomaly(bit, pumpOn, stats);
+    }
+  }
+  
+  uint8_t cleared = previous & ~anomalies;
+  if (cleared && settings.flowSensorDebug) {
+    Serial.println("Afwijking in waterstroming hersteld");
+  }
+}
+
+// Voeg een meetinterval toe (wordt aangeroepen vanuit calculateFlowRate)
+void flowAnomalyAddSample(float liters, unsigned long elapsedMs) {
+  unsigned long now = millis();
+  
+  // Alleen stabiele periodes bewaken: na de aanloop van de pomp en na de uitloop
+  bool stable = pumpActive ? (now - pumpStartTime > getFlowCheckDelay())
+                           : (now - pumpStopTime > ANOMALY_OFF_SETTLE_MS);
+  
+  // Een toestandswissel of instabiele periode gooit het lopende sample weg
+  if (!stable || pumpActive != windowPumpState) {
+    windowLiters = 0.0;
+    windowMs = 0;
+    windowPumpState = pumpActive;
+    return;
+  }
+  
+  windowLiters += liters;
+  windowMs += elapsedMs;
+  
+  if (windowMs >= ANOMALY_SAMPLE_MS) {
+    float sampleLPM = windowLiters * 60000.0 / windowMs;
+    windowLiters = 0.0;
+    windowMs = 0;
+    processFlowSample(sampleLPM, windowPumpState);
+  }
+}
+
+// Huidige afwijkingen als bitmasker
+uint8_t getFlowAnomalies() {
+  return pumpOnStats.active | pumpOffStats.active;
+}
+
+// Vergeet de geleerde basislijnen (bijv. na onderhoud of een nieuwe pomp)
+void resetFlowAnomalyBaseline() {
+  pumpOnStats = {};
+  pumpOffStats = {};
+  Serial.println("Basislijn waterstroming gereset");
+}
+
+// Voeg de statistiek van één toestand toe aan JSON
+void addFlowStateJson(JsonObject obj, const FlowStateStats &stats) {
+  obj["learning"] = stats.samples <= ANOMALY_WARMUP_SAMPLES;
+  obj["samples"] = stats.samples;
+  obj["baselineLPM"] = stats.baseline.mean;
+  obj["baselineSd"] = sqrtf(stats.baseline.variance);
+  obj["recentLPM"] = stats.fast.mean;
+  obj["recentSd"] = sqrtf(stats.fast.variance);
+}
+
+// Voeg de status van de detector toe aan JSON
+void addFlowAnomalyJson(JsonObject obj) {
+  uint8_t anomalies = getFlowAnomalies();
+  obj["drift"] = (anomalies & FLOW_ANOMALY_DRIFT) != 0;
+  obj["drop"] = (anomalies & FLOW_ANOMALY_DROP) != 0;
+  obj["noise"] = (anomalies & FLOW_ANOMALY_NOISE) != 0;
+  addFlowStateJson(obj.createNestedObject("pumpOn"), pumpOnStats);
+  addFlowStateJson(obj.createNestedObject("pumpOff"), pumpOffStats);
+}
+
+#endif // ENABLE_FLOW_SENSOR
@@ -0,0 +1,73 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowAnomaly.h
+ *
+ * Header voor de stroming anomaliedetectie (verstopping, lek, luchtbel)
+ */
+
+#ifndef FLOW_ANOMALY_H
+#define FLOW_ANOMALY_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+  // Afstemming van de detector (samples zijn gemiddelden over 1 seconde)
+  #define ANOMALY_SAMPLE_MS 1000         // Lengte van één sample
+  #define ANOMALY_BASE_ALPHA 0.0005      // Basislijn EWMA (~33 minuten tijdconstante)
+  #define ANOMALY_FAST_ALPHA 0.05        // Snelle EWMA (~20 seconden tijdconstante)
+  #define ANOMALY_WARMUP_SAMPLES 120     // Samples voordat een pomptoestand bewaakt wordt
+  #define ANOMALY_OFF_SETTLE_MS 5000     // Uitlooptijd na uitschakelen pomp
+  #define ANOMALY_DRIFT_FRACTION 0.25    // Relatieve afwijking voor drift
+  #define ANOMALY_DRIFT_MIN_LPM 0.3      // Absolute ondergrens voor drift (L/min)
+  #define ANOMALY_LEARN_FRACTION 0.25    // Basislijn leert alleen binnen deze fractie van de driftdrempel
+  #define ANOMALY_DROP_FRACTION 0.4      // Relatieve daling voor een plotselinge val
+  #define ANOMALY_DROP_SIGMA 4.0         // Daling in standaarddeviaties van de basislijn
+  #define ANOMALY_DROP_SAMPLES 3         // Aantal opeenvolgende lage samples
+  #define ANOMALY_NOISE_RATIO 4.0        // Variantieverhouding snel/basislijn voor ruis
+  #define ANOMALY_NOISE_MIN_LPM 0.2      // Absolute ondergrens standaarddeviatie ruis
+  #define ANOMALY_CLEAR_MARGIN 0.8       // Afwijking is pas weg onder deze fractie van de drempel
+  #define ANOMALY_CLEAR_SAMPLES 30       // ... en dan zoveel samples op rij
+  #define ANOMALY_RELEARN_SAMPLES 3600   // Na zoveel samples rustige drift het nieuwe niveau leren (1 uur)
+  
+  // Alarmklassen (bitmasker)
+  #define FLOW_ANOMALY_DRIFT 0x01        // Geleidelijke afwijking (verstopt filter, lek)
+  #define FLOW_ANOMALY_DROP 0x02         // Plotselinge val (lek, leiding los)
+  #define FLOW_ANOMALY_NOISE 0x04        // Toenemende onrust (lucht in het systeem)
+  
+  // EWMA gemiddelde en variantie
+  struct FlowEwma {
+    float mean;
+    float variance;
+  };
+  
+  // Statistiek voor één pomptoestand
+  struct FlowStateStats {
+    FlowEwma baseline;       // Langzaam geleerde normaalwaarde
+    FlowEwma fast;           // Recente waarde
+    uint32_t samples;        // Aantal verwerkte samples
+    uint8_t lowStreak;       // Opeenvolgende samples onder de valdrempel
+    uint8_t active;          // Actieve alarmklassen in deze toestand
+    uint8_t clearCount[3];   // Per klasse: samples op rij onder de hersteldrempel
+    uint16_t driftStreak;    // Opeenvolgende samples met rustige drift
+  };
+  
+  // Functieprototypes
+  void flowEwmaUpdate(FlowEwma &ewma, float sample, float alpha);
+  uint8_t flowStatsUpdate(FlowStateStats &stats, float sampleLPM);
+  void flowAnomalyAddSample(float liters, unsigned long elapsedMs);
+  void addFlowAnomalyJson(JsonObject obj);
+#endif
+
+#endif // FLOW_ANOMALY_H
@@ -0,0 +1,345 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowCalibration.cpp
+ *
+ * K-factor kalibratie van de flowsensor. Goedkope YF-S201 sensoren wijken
+ * vooral bij lage stroming 10-20% af van de nominale 450 pulsen per liter.
+ * De gebruiker vult een bekend volume en het systeem legt per pulsfrequentie
+ * de gemeten K-factor vast. Tussen de punten wordt lineair geïnterpoleerd.
+ *
+ * De meting zelf gebruikt een vooraf berekende tabel met liters per puls
+ * (het omgekeerde van K) en een vaste indeling in frequentievakken, zodat een
+ * omrekening altijd één tabelopzoeking en één vermenigvuldiging kost.
+ */
+
+#include "FlowCalibration.h"
+#include "FlowSensor.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+
+// Kalibratierun variabelen
+bool flowCalibrationActive = false;     // Loopt er een kalibratierun
+unsigned long calStartTime = 0;         // Tijdstip start kalibratierun
+unsigned long calPulses = 0;            // Getelde pulsen tijdens de run
+unsigned long calFlowingMs = 0;         // Tijd waarin daadwerkelijk pulsen binnenkwamen
+
+// Vooraf berekende opzoektabellen (alleen in RAM)
+float calLitersPerPulse[FLOW_CAL_MAX_POINTS];   // 1/K per kalibratiepunt
+float calSlope[FLOW_CAL_MAX_POINTS];            // Helling van 1/K per Hz per segment
+uint8_t calBinSegment[FLOW_CAL_BINS];           // Segmentindex per frequentievak
+const float calInvBinWidth = 1.0 / FLOW_CAL_BIN_HZ;
+
+// Controleer of de opgeslagen tabel bruikbaar is (een beschadigd NVS-veld kan willekeurig zijn)
+bool isCalibrationTableValid() {
+  if (settings.flowCalPoints > FLOW_CAL_MAX_POINTS) {
+    return false;
+  }
+  
+  for (int i = 0; i < settings.flowCalPoints; i++) {
+    // NaN faalt beide vergelijkingen en wordt zo ook afgekeurd
+    if (!(settings.flowCalFreq[i] > 0.0 && settings.flowCalFreq[i] < FLOW_CAL_BINS * FLOW_CAL_BIN_HZ)) {
+      return false;
+    }
+    if (!(settings.flowCalK[i] >= 100.0 && settings.flowCalK[i] <= 2000.0)) {
+      return false;
+    }
+    if (i > 0 && settings.flowCalFreq[i] - settings.flowCalFreq[i - 1] < FLOW_CAL_BIN_HZ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Haal een punt uit de tabel zonder op te slaan
+void removeCalibrationPoint(int index) {
+  int points = settings.flowCalPoints;
+  
+  for (int i = index; i + 1 < points; i++) {
+    settings.flowCalFreq[i] = settings.flowCalFreq[i + 1];
+    settings.flowCalK[i] = settings.flowCalK[i + 1];
+  }
+  
+  settings.flowCalPoints = --points;
+  settings.flowCalFreq[points] = 0;
+  settings.flowCalK[points] = 0;
+}
+
+// Initialiseer kalibratie en bouw de opzoektabel
+void setupFlowCalibration() {
+  if (!isCalibrationTableValid()) {
+    Serial.println("Ongeldige flow kalibratietabel gevonden, fabriekswaarde wordt gebruikt");
+    settings.flowCalPoints = 0;
+    memset(settings.flowCalFreq, 0, sizeof(settings.flowCalFreq));
+    memset(settings.flowCalK, 0, sizeof(settings.flowCalK));
+    markSettingDirty(&settings.flowCalPoints);
+    saveSettings();
+  }
+  
+  rebuildFlowCalibrationTable();
+  
+  Serial.print("Flow kalibratiepunten: ");
+  Serial.println(settings.flowCalPoints);
+}
+
+// Bereken de reciproke tabel, hellingen en vakindeling opnieuw
+void rebuildFlowCalibrationTable() {
+  int points = settings.flowCalPoints;
+  
+  for (int i = 0; i < points; i++) {
+    calLitersPerPulse[i] = 1.0 / settings.flowCalK[i];
+  }
+  
+  for (int i = 0; i + 1 < points; i++) {
+    calSlope[i] = (calLitersPerPulse[i + 1] - calLitersPerPulse[i]) /
+                  (settings.flowCalFreq[i + 1] - settings.flowCalFreq[i]);
+  }
+  
+  // Per vak het segment waarin de ondergrens van het vak valt. Omdat punten
+  // minimaal één vakbreedte uit elkaar liggen, ligt een frequentie binnen het
+  // vak hoogstens één segment verder.
+  int segment = 0;
+  for (int bin = 0; bin < FLOW_CAL_BINS; bin++) {
+    float binStart = bin * FLOW_CAL_BIN_HZ;
+    while (segment + 2 < points && binStart >= settings.flowCalFreq[segment + 1]) {
+      segment++;
+    }
+    calBinSegment[bin] = segment;
+  }
+}
+
+// Liters per puls bij de gegeven pulsfrequentie (O(1))
+float flowLitersPerPulse(float frequencyHz) {
+  int points = settings.flowCalPoints;
+  
+  if (points == 0) {
+    return 1.0 / FLOW_BASE_PULSE_FACTOR;
+  }
+  
+  // Buiten het gekalibreerde bereik de dichtstbijzijnde waarde aanhouden
+  if (points == 1 || frequencyHz <= settings.flowCalFreq[0]) {
+    return calLitersPerPulse[0];
+  }
+  if (frequencyHz >= settings.flowCalFreq[points - 1]) {
+    return calLitersPerPulse[points - 1];
+  }
+  
+  int bin = (int)(frequencyHz * calInvBinWidth);
+  if (bin >= FLOW_CAL_BINS) {
+    bin = FLOW_CAL_BINS - 1;
+  }
+  
+  int segment = calBinSegment[bin];
+  if (segment + 2 < points && frequencyHz >= settings.flowCalFreq[segment + 1]) {
+    segment++;
+  }
+  
+  return calLitersPerPulse[segment] + calSlope[segment] * (frequencyHz - settings.flowCalFreq[segment]);
+}
+
+// Effectieve pulsfactor (pulsen per liter) bij de laatst gemeten pulsfrequentie
+float calculatePulseFactor() {
+  return 1.0 / flowLitersPerPulse(flowFrequencyHz);
+}
+
+// Verwerk een meetinterval tijdens een kalibratierun
+void flowCalibrationAddSample(long pulses, unsigned long elapsedMs) {
+  if (!flowCalibrationActive || pulses <= 0) {
+    return;
+  }
+  
+  calPulses += pulses;
+  calFlowingMs += elapsedMs;
+}
+
+// Start een kalibratierun
+bool startFlowCalibration() {
+  if (flowCalibrationActive) {
+    return false;
+  }
+  
+  calPulses = 0;
+  calFlowingMs = 0;
+  calStartTime = millis();
+  flowCalibrationActive = true;
+  
+  Serial.println("Flow kalibratie gestart: vul een bekend volume en rond daarna af");
+  return true;
+}
+
+// Rond een kalibratierun af met het werkelijk gevulde volume
+bool finishFlowCalibration(float volumeLiters, String &message) {
+  if (!flowCalibrationActive) {
+    message = "Geen kalibratie actief";
+    return false;
+  }
+  
+  flowCalibrationActive = false;
+  
+  if (!(volumeLiters > 0.0)) {
+    message = "Ongeldig volume";
+    return false;
+  }
+  
+  if (calPulses < FLOW_CAL_MIN_PULSES || calFlowingMs == 0) {
+    message = "Te weinig pulsen gemeten (minimaal " + String(FLOW_CAL_MIN_PULSES) + ")";
+    return false;
+  }
+  
+  float kFactor = calPulses / volumeLiters;
+  float frequencyHz = calPulses * 1000.0 / calFlowingMs;
+  
+  if (kFactor < 100.0 || kFactor > 2000.0) {
+    message = "K-factor buiten bereik: " + String(kFactor) + " pulsen/L";
+    return false;
+  }
+  
+  if (frequencyHz >= FLOW_CAL_BINS * FLOW_CAL_BIN_HZ) {
+    message = "Pulsfrequentie buiten bereik: " + String(frequencyHz) + " Hz";
+    return false;
+  }
+  
+  // Een gemeten stroming ver boven de pompcapaciteit wijst op een verkeerd volume
+  float measuredLPH = volumeLiters * 3600000.0 / calFlowingMs;
+  if (measuredLPH > settings.pumpCapacityLPH * 1.5) {
+    message = "Gemeten stroming (" + String(measuredLPH) + " L/h) hoger dan pompcapaciteit";
+    return false;
+  }
+  
+  int points = settings.flowCalPoints;
+  
+  // Vervang een bestaand punt in hetzelfde frequentievak
+  int index = -1;
+  for (int i = 0; i < points; i++) {
+    if (fabs(settings.flowCalFreq[i] - frequencyHz) < FLOW_CAL_BIN_HZ) {
+      index = i;
+      break;
+    }
+  }
+  
+  if (index < 0) {
+    if (points == FLOW_CAL_MAX_POINTS) {
+      // Tabel vol: vervang het dichtstbijzijnde punt
+      index = 0;
+      for (int i = 1; i < points; i++) {
+        if (fabs(settings.flowCalFreq[i] - frequencyHz) < fabs(settings.flowCalFreq[index] - frequencyHz)) {
+          index = i;
+        }
+      }
+    } else {
+      index = points;
+      settings.flowCalPoints = ++points;
+    }
+  }
+  
+  settings.flowCalFreq[index] = frequencyHz;
+  settings.flowCalK[index] = kFactor;
+  
+  // Houd de tabel oplopend gesorteerd op frequentie
+  while (index > 0 && settings.flowCalFreq[index] < settings.flowCalFreq[index - 1]) {
+    std::swap(settings.flowCalFreq[index], settings.flowCalFreq[index - 1]);
+    std::swap(settings.flowCalK[index], settings.flowCalK[index - 1]);
+    index--;
+  }
+  while (index + 1 < points && settings.flowCalFreq[index] > settings.flowCalFreq[index + 1]) {
+    std::swap(settings.flowCalFreq[index], settings.flowCalFreq[index + 1]);
+    std::swap(settings.flowCalK[index], settings.flowCalK[index + 1]);
+    index++;
+  }
+  
+  // Een vervangen punt kan nu te dicht bij een buurpunt liggen, het nieuwe punt wint
+  if (index > 0 && settings.flowCalFreq[index] - settings.flowCalFreq[index - 1] < FLOW_CAL_BIN_HZ) {
+    removeCalibrationPoint(index - 1);
+    index--;
+  } else if (index + 1 < points && settings.flowCalFreq[index + 1] - settings.flowCalFreq[index] < FLOW_CAL_BIN_HZ) {
+    removeCalibrationPoint(index + 1);
+  }
+  
+  rebuildFlowCalibrationTable();
+  markSettingDirty(&settings.flowCalPoints);
+  saveSettings();
+  
+  Serial.print("Flow kalibratiepunt opgeslagen: ");
+  Serial.print(frequencyHz);
+  Serial.print(" Hz -> ");
+  Serial.print(kFactor);
+  Serial.println(" pulsen/L");
+  
+  message = "Kalibratiepunt opgeslagen: " + String(kFactor) + " pulsen/L bij " + String(frequencyHz) + " Hz";
+  return true;
+}
+
+// Breek een kalibratierun af zonder op te slaan
+void cancelFlowCalibration() {
+  flowCalibrationActive = false;
+  Serial.println("Flow kalibratie afgebroken");
+}
+
+// Wis de kalibratietabel en val terug op de fabriekswaarde
+void clearFlowCalibration() {
+  settings.flowCalPoints = 0;
+  memset(settings.flowCalFreq, 0, sizeof(settings.flowCalFreq));
+  memset(settings.flowCalK, 0, sizeof(settings.flowCalK));
+  
+  rebuildFlowCalibrationTable();
+  markSettingDirty(&settings.flowCalPoints);
+  saveSettings();
+  
+  Serial.println("Flow kalibratietabel gewist");
+}
+
+// Verwijder één kalibratiepunt
+bool deleteFlowCalibrationPoint(int index) {
+  int points = settings.flowCalPoints;
+  
+  if (index < 0 || index >= points) {
+    return false;
+  }
+  
+  removeCalibrationPoint(index);
+  
+  rebuildFlowCalibrationTable();
+  markSettingDirty(&settings.flowCalPoints);
+  saveSettings();
+  return true;
+}
+
+// Genereer JSON met kalibratiestatus
+String getFlowCalibrationJson() {
+  DynamicJsonDocument doc(1024);
+  
+  doc["basePulseFactor"] = FLOW_BASE_PULSE_FACTOR;
+  doc["maxPoints"] = FLOW_CAL_MAX_POINTS;
+  doc["active"] = flowCalibrationActive;
+  
+  if (flowCalibrationActive) {
+    doc["runSeconds"] = (millis() - calStartTime) / 1000;
+    doc["runPulses"] = calPulses;
+    doc["runFlowingSeconds"] = calFlowingMs / 1000.0;
+  }
+  
+  JsonArray points = doc.createNestedArray("points");
+  for (int i = 0; i < settings.flowCalPoints; i++) {
+    JsonObject point = points.createNestedObject();
+    point["freqHz"] = settings.flowCalFreq[i];
+    point["kFactor"] = settings.flowCalK[i];
+    point["flowLPM"] = settings.flowCalFreq[i] * 60.0 / settings.flowCalK[i];
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  return response;
+}
+
+#endif // ENABLE_FLOW_SENSOR
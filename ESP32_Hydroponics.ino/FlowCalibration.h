@@ -0,0 +1,34 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowCalibration.h
+ *
+ * Header voor de K-factor kalibratietabel van de flowsensor
+ */
+
+#ifndef FLOW_CALIBRATION_H
+#define FLOW_CALIBRATION_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+  // Externe variabelen
+  extern bool flowCalibrationActive;
+  
+  // Functieprototypes
+  void rebuildFlowCalibrationTable();
+  void flowCalibrationAddSample(long pulses, unsigned long elapsedMs);
+#endif
+
+#endif // FLOW_CALIBRATION_H
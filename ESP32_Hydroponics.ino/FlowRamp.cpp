@@ -0,0 +1,273 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowRamp.cpp
+ *
+ * Meet bij elke pompstart hoe lang het duurt tot de eerste puls, hoe lang tot
+ * 90% van de eindstroming en wat die eindstroming is. De resultaten komen in
+ * histogrammen met vaste vakken. Daaruit volgt een aangepaste wachttijd voor
+ * de geen-stroming controle, zodat een echte storing sneller wordt gemeld dan
+ * met de vaste FLOW_CHECK_DELAY, zonder vals alarm tijdens een normale aanloop.
+ */
+
+#include "FlowRamp.h"
+#include "FlowSensor.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+
+// Meetpunt tijdens de aanloop
+struct RampPoint {
+  uint16_t timeMs;   // Tijd sinds pompstart
+  float liters;      // Cumulatief volume sinds pompstart
+};
+
+// Lopende meting
+RampPoint rampTrace[RAMP_TRACE_POINTS];
+int rampTraceCount = 0;
+bool rampRunActive = false;
+unsigned long rampRunStart = 0;       // pumpStartTime van de lopende meting
+float rampRunLiters = 0.0;
+long rampFirstPulseMs = -1;           // -1 = nog geen puls gezien
+bool rampPriming = true;              // Pomp stond lang stil (of eerste start na opstarten)
+
+// Histogrammen
+uint16_t firstPulseHist[RAMP_HIST_BINS];
+uint16_t rampT90Hist[RAMP_HIST_BINS];
+uint16_t steadyFlowHist[RAMP_HIST_BINS];
+unsigned long rampRuns = 0;           // Aantal geslaagde metingen
+unsigned long rampFailedRuns = 0;     // Starts zonder stroming
+
+// Laatste meting
+long lastFirstPulseMs = -1;
+long lastT90Ms = -1;
+float lastSteadyLPM = 0.0;
+
+// Voeg een waarde toe aan een histogram (laatste vak vangt de overloop op)
+void addToHistogram(uint16_t* hist, float value, float binWidth) {
+  int bin = (int)(value / binWidth);
+  if (bin < 0) bin = 0;
+  if (bin >= RAMP_HIST_BINS) bin = RAMP_HIST_BINS - 1;
+  if (hist[bin] < 65535) hist[bin]++;
+}
+
+// Bovengrens van het vak waarin het gevraagde percentiel valt
+float histogramPercentile(const uint16_t* hist, float binWidth, int percent) {
+  unsigned long total = 0;
+  for (int i = 0; i < RAMP_HIST_BINS; i++) {
+    total += hist[i];
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+  
+  unsigned long target = (total * percent + 99) / 100;
+  unsigned long count = 0;
+  for (int i = 0; i < RAMP_HIST_BINS; i++) {
+    count += hist[i];
+    if (count >= target) {
+      return (i + 1) * binWidth;
+    }
+  }
+  return RAMP_HIST_BINS * binWidth;
+}
+
+// Werk de aanloopmeting af en vul de histogrammen
+void finishRampRun() {
+  rampRunActive = false;
+  
+  if (rampTraceCount < 2) {
+    return;
+  }
+  
+  const RampPoint &last = rampTrace[rampTraceCount - 1];
+  if (last.timeMs < RAMP_STEADY_MS * 2) {
+    return;  // Pomp te kort aan geweest voor een bruikbare meting
+  }
+  
+  // Eindstroming over het laatste deel van het venster
+  int steadyStart = rampTraceCount - 1;
+  while (steadyStart > 0 && last.timeMs - rampTrace[steadyStart].timeMs < RAMP_STEADY_MS) {
+    steadyStart--;
+  }
+  float steadyLPM = (last.liters - rampTrace[steadyStart].liters) * 60000.0 /
+                    (last.timeMs - rampTrace[steadyStart].timeMs);
+  
+  if (rampFirstPulseMs < 0 || steadyLPM < settings.minFlowRate) {
+    // Mislukte start: niet meenemen, anders leert het systeem de storing aan
+    rampFailedRuns++;
+    return;
+  }
+  
+  // Eerste moment waarop de stroming over een kort venster 90% van de eindstroming haalt
+  long t90 = last.timeMs;
+  int from = 0;
+  for (int i = 1; i < rampTraceCount; i++) {
+    while (rampTrace[i].timeMs - rampTrace[from].timeMs > 3 * RAMP_TRACE_STEP_MS) {
+      from++;
+    }
+    if (i == from) {
+      continue;
+    }
+    float windowLPM = (rampTrace[i].liters - rampTrace[from].liters) * 60000.0 /
+                      (rampTrace[i].timeMs - rampTrace[from].timeMs);
+    if (windowLPM >= steadyLPM * 0.9) {
+      t90 = rampTrace[i].timeMs;
+      break;
+    }
+  }
+  
+  lastFirstPulseMs = rampFirstPulseMs;
+  lastT90Ms = t90;
+  lastSteadyLPM = steadyLPM;
+  rampRuns++;
+  
+  addToHistogram(firstPulseHist, rampFirstPulseMs, RAMP_TIME_BIN_MS);
+  addToHistogram(rampT90Hist, t90, RAMP_TIME_BIN_MS);
+  addToHistogram(steadyFlowHist, steadyLPM, RAMP_FLOW_BIN_LPM);
+  
+  if (settings.flowSensorDebug) {
+    Serial.print("Pompaanloop: eerste puls ");
+    Serial.print(rampFirstPulseMs);
+    Serial.print(" ms, 90% na ");
+    Serial.print(t90);
+    Serial.print(" ms, eindstroming ");
+    Serial.print(steadyLPM);
+    Serial.println(" L/min");
+  }
+}
+
+// Voeg een meetinterval toe (wordt aangeroepen vanuit calculateFlowRate)
+void flowRampAddSample(float liters, unsigned long elapsedMs) {
+  unsigned long now = millis();
+  
+  // Nieuwe pompstart gedetecteerd
+  if (pumpActive && (!rampRunActive || rampRunStart != pumpStartTime)) {
+    rampRunActive = true;
+    rampRunStart = pumpStartTime;
+    rampRunLiters = 0.0;
+    rampFirstPulseMs = -1;
+    rampTraceCount = 0;
+    
+    // Stilstand vóór deze start bepaalt of de leidingen opnieuw gevuld moeten worden
+    rampPriming = (pumpStopTime == 0) || (pumpStartTime - pumpStopTime > RAMP_PRIMING_IDLE_MS);
+    
+    // Dit interval begon (deels) vóór de pompstart en telt niet mee
+    return;
+  }
+  
+  if (!rampRunActive) {
+    return;
+  }
+  
+  if (!pumpActive) {
+    finishRampRun();
+    return;
+  }
+  
+  unsigned long sinceStart = now - rampRunStart;
+  rampRunLiters += liters;
+  
+  if (liters > 0.0 && rampFirstPulseMs < 0) {
+    rampFirstPulseMs = sinceStart;
+  }
+  
+  // Sla een punt op met minimaal RAMP_TRACE_STEP_MS tussenruimte
+  if (rampTraceCount == 0 ||
+      sinceStart - rampTrace[rampTraceCount - 1].timeMs >= RAMP_TRACE_STEP_MS) {
+    if (rampTraceCount < RAMP_TRACE_POINTS) {
+      rampTrace[rampTraceCount].timeMs = sinceStart;
+      rampTrace[rampTraceCount].liters = rampRunLiters;
+      rampTraceCount++;
+    }
+  }
+  
+  if (sinceStart >= RAMP_WINDOW_MS || rampTraceCount == RAMP_TRACE_POINTS) {
+    finishRampRun();
+  }
+}
+
+// Wachttijd na pompstart voordat op geen stroming wordt gecontroleerd
+unsigned long getFlowCheckDelay() {
+  if (rampRuns < RAMP_MIN_RUNS) {
+    return FLOW_CHECK_DELAY;
+  }
+  
+  unsigned long learned = histogramPercentile(rampT90Hist, RAMP_TIME_BIN_MS, 95) + RAMP_CHECK_MARGIN_MS;
+  
+  // Na lange stilstand moeten de leidingen eerst vollopen: neem de langst geziene aanloop
+  if (rampPriming) {
+    learned = max(learned, (unsigned long)histogramPercentile(rampT90Hist, RAMP_TIME_BIN_MS, 100) + RAMP_CHECK_MARGIN_MS);
+    learned = max(learned, (unsigned long)FLOW_CHECK_DELAY);
+  }
+  
+  return constrain(learned, (unsigned long)RAMP_MIN_CHECK_DELAY, (unsigned long)FLOW_CHECK_DELAY * 3);
+}
+
+// Maximale tijd zonder pulsen voordat dat als geen stroming telt
+unsigned long getNoPulseTimeout() {
+  if (rampRuns < RAMP_MIN_RUNS) {
+    return NO_PULSE_TIMEOUT;
+  }
+  
+  // Twintig verwachte pulsperiodes bij de laagst gebruikelijke eindstroming
+  float lowFlowLPM = histogramPercentile(steadyFlowHist, RAMP_FLOW_BIN_LPM, 5) - RAMP_FLOW_BIN_LPM;
+  if (lowFlowLPM <= 0.0) {
+    return NO_PULSE_TIMEOUT;
+  }
+  
+  float pulseHz = lowFlowLPM / 60.0 * calculatePulseFactor();
+  unsigned long timeout = 20000.0 / pulseHz;
+  return constrain(timeout, 2000UL, (unsigned long)NO_PULSE_TIMEOUT);
+}
+
+// Voeg een samenvatting toe aan JSON
+void addFlowRampJson(JsonObject obj) {
+  obj["runs"] = rampRuns;
+  obj["failedRuns"] = rampFailedRuns;
+  obj["lastFirstPulseMs"] = lastFirstPulseMs;
+  obj["lastT90Ms"] = lastT90Ms;
+  obj["lastSteadyLPM"] = lastSteadyLPM;
+  obj["checkDelayMs"] = getFlowCheckDelay();
+  obj["noPulseTimeoutMs"] = getNoPulseTimeout();
+}
+
+// Vul een JSON array met de vakken van een histogram
+void addHistogramJson(JsonArray arr, const uint16_t* hist) {
+  for (int i = 0; i < RAMP_HIST_BINS; i++) {
+    arr.add(hist[i]);
+  }
+}
+
+// Genereer JSON met de volledige aanloopstatistiek
+String getFlowRampJson() {
+  DynamicJsonDocument doc(4096);
+  
+  addFlowRampJson(doc.to<JsonObject>());
+  doc["firstPulseP50Ms"] = histogramPercentile(firstPulseHist, RAMP_TIME_BIN_MS, 50);
+  doc["firstPulseP95Ms"] = histogramPercentile(firstPulseHist, RAMP_TIME_BIN_MS, 95);
+  doc["t90P50Ms"] = histogramPercentile(rampT90Hist, RAMP_TIME_BIN_MS, 50);
+  doc["t90P95Ms"] = histogramPercentile(rampT90Hist, RAMP_TIME_BIN_MS, 95);
+  doc["steadyP50LPM"] = histogramPercentile(steadyFlowHist, RAMP_FLOW_BIN_LPM, 50);
+  doc["timeBinMs"] = RAMP_TIME_BIN_MS;
+  doc["flowBinLPM"] = RAMP_FLOW_BIN_LPM;
+  addHistogramJson(doc.createNestedArray("firstPulseHist"), firstPulseHist);
+  addHistogramJson(doc.createNestedArray("t90Hist"), rampT90Hist);
+  addHistogramJson(doc.createNestedArray("steadyFlowHist"), steadyFlowHist);
+  
+  String response;
+  serializeJson(doc, response);
+  return response;
+}
+
+#endif // ENABLE_FLOW_SENSOR
@@ -0,0 +1,46 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowRamp.h
+ *
+ * Header voor het meten van de aanloop van de pomp (opstarttijd en stromingsopbouw)
+ */
+
+#ifndef FLOW_RAMP_H
+#define FLOW_RAMP_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+  #define RAMP_WINDOW_MS 15000          // Meetvenster na het inschakelen van de pomp
+  #define RAMP_TRACE_STEP_MS 200        // Minimale afstand tussen punten in de meting
+  #define RAMP_TRACE_POINTS 80          // Aantal punten (80 x 200 ms = 16 s)
+  #define RAMP_STEADY_MS 3000           // Laatste deel van het venster voor de eindstroming
+  #define RAMP_HIST_BINS 40             // Aantal vakken per histogram
+  #define RAMP_TIME_BIN_MS 250          // Vakbreedte tijdhistogrammen (0-10 s)
+  #define RAMP_FLOW_BIN_LPM 0.5         // Vakbreedte stromingshistogram (0-20 L/min)
+  #define RAMP_MIN_RUNS 5               // Metingen voordat de wachttijd zich aanpast
+  #define RAMP_CHECK_MARGIN_MS 1000     // Marge bovenop de geleerde aanlooptijd
+  #define RAMP_MIN_CHECK_DELAY 1000     // Ondergrens aangepaste wachttijd (ms)
+  #define RAMP_PRIMING_IDLE_MS 3600000  // Na zo lang stilstand eerst opnieuw vullen (1 uur)
+  #define NO_PULSE_TIMEOUT 10000        // Standaard maximale tijd zonder pulsen (ms)
+  
+  // Functieprototypes
+  void flowRampAddSample(float liters, unsigned long elapsedMs);
+  unsigned long getFlowCheckDelay();
+  unsigned long getNoPulseTimeout();
+  void addFlowRampJson(JsonObject obj);
+#endif
+
+#endif // FLOW_RAMP_H
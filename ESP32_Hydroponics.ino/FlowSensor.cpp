@@ -15,23 +15,57 @@
  * FlowSensor.cpp
  *
  * Implementatie van de flowsensor module (YF-S201)
+ *
+ * checkFlowRate() wordt bij elke doorgang van loop() aangeroepen. De pulsen
+ * worden elke 200 ms uit de teller gehaald (voor de aanloopmeting) en per
+ * venster van minimaal 1 seconde verwerkt: pulsfrequentie voor de
+ * kalibratietabel, flowrate, volume en kalibratierun. Een aanroep binnen die
+ * tijd laat teller en tijdstip ongemoeid, zodat geen puls verloren gaat.
  */
 
 #include "FlowSensor.h"
+#include "FlowCalibration.h"
+#include "FlowTotalizer.h"
+#include "FlowAnomaly.h"
+#include "FlowRamp.h"
+#include "Notification.h"
+
+#define FLOW_SLICE_MS 200     // Pulsen ophalen voor de aanloopmeting (= RAMP_TRACE_STEP_MS)
+#define FLOW_WINDOW_MS 1000   // Meetvenster voor frequentie, flowrate en volume
 
 #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
 
 // Flowsensor variabelen
 volatile long flowPulseCount = 0;  // Aantal pulsen (flow)
 float flowRate = 0.0;             // Huidige stromingssnelheid in l/min
+float flowFrequencyHz = 0.0;      // Laatst gemeten pulsfrequentie in Hz
 float totalLiters = 0.0;          // Totaal aantal liters
 bool flowOk = true;               // Flowstatus (OK/probleem)
 unsigned long lastFlowCheck = 0;  // Tijdstip laatste controle
 unsigned long lastPulseTime = 0;  // Tijdstip laatste puls
+float pumpCycleLiters = 0.0;      // Volume sinds de laatste pompstart
+unsigned long pumpCycleStart = 0; // pumpStartTime waarbij pumpCycleLiters hoort
+
+// Pulsen van het lopende meetvenster
+static portMUX_TYPE flowPulseMux = portMUX_INITIALIZER_UNLOCKED;
+static long windowPulses = 0;
+static unsigned long flowWindowStart = 0;
+
+// Tekst van de geen-stroming waarschuwing
+static const char NO_FLOW_MESSAGE[] PROGMEM =
+  "Er is geen waterstroming gedetecteerd terwijl de pomp aan staat!\n\n"
+  "Controleer onmiddellijk op mogelijke problemen zoals:\n"
+  "- Verstopte leidingen\n"
+  "- Lucht in het systeem\n"
+  "- Pomp defect\n"
+  "- Waterreservoir leeg\n\n"
+  "Dit kan schade veroorzaken aan je planten of systeemcomponenten.";
 
 // Interrupt functie voor flowsensor
 void IRAM_ATTR flowPulseCounter() {
+  portENTER_CRITICAL_ISR(&flowPulseMux);
   flowPulseCount++;
+  portEXIT_CRITICAL_ISR(&flowPulseMux);
   lastPulseTime = millis();
 }
 
@@ -48,54 +82,91 @@ void setupFlowSensor() {
   
   // Reset variabelen
   flowPulseCount = 0;
+  windowPulses = 0;
+  lastFlowCheck = millis();
+  flowWindowStart = lastFlowCheck;
   flowRate = 0.0;
   totalLiters = 0.0;
   flowOk = true;
   
+  // Laad de K-factor kalibratietabel
+  setupFlowCalibration();
+  
+  // Herstel de volumetellers van voor de herstart
+  setupFlowTotalizer();
+  
   Serial.println("YF-S201 flowsensor geïnitialiseerd");
-  Serial.println("YF-S201 specificatie: 450 pulsen per liter water");
+  if (settings.flowCalPoints == 0) {
+    Serial.println("YF-S201 specificatie: 450 pulsen per liter water (niet gekalibreerd)");
+  }
 }
 
-// Bereken huidige flowsnelheid
+// Bereken huidige flowsnelheid (geeft de vorige waarde terug zolang het meetvenster loopt)
 float calculateFlowRate() {
-  // Ontkoppel interrupt tijdelijk
-  detachInterrupt(digitalPinToInterrupt(FLOW_SENSOR_PIN));
+  unsigned long currentTime = millis();
+  unsigned long sliceTime = currentTime - lastFlowCheck;
   
-  // Sla huidige pulsstand op en reset counter
-  long pulseCount = flowPulseCount;
-  flowPulseCount = 0;
+  // Te kort geleden: teller en tijdstip ongemoeid laten
+  if (sliceTime < FLOW_SLICE_MS) {
+    return flowRate;
+  }
   
-  // Bepaal tijdsverschil sinds laatste meting
-  unsigned long currentTime = millis();
-  unsigned long elapsedTime = currentTime - lastFlowCheck;
+  // Haal de pulsen op zonder de interrupt los te koppelen (dan gaan pulsen verloren)
+  portENTER_CRITICAL(&flowPulseMux);
+  long slicePulses = flowPulseCount;
+  flowPulseCount = 0;
+  portEXIT_CRITICAL(&flowPulseMux);
   lastFlowCheck = currentTime;
   
-  // Voorkom deling door nul of onrealistische waarden
-  if (elapsedTime < 100) {
-    // Koppel interrupt opnieuw
-    attachInterrupt(digitalPinToInterrupt(FLOW_SENSOR_PIN), flowPulseCounter, FALLING);
-    return flowRate; // Behoud vorige waarde
+  // Aanloopmeting met fijne tijdstappen, liters per puls bij de laatst gemeten frequentie
+  float sliceLiters = slicePulses > 0 ? slicePulses * flowLitersPerPulse(flowFrequencyHz) : 0.0;
+  flowRampAddSample(sliceLiters, sliceTime);
+  
+  windowPulses += slicePulses;
+  unsigned long elapsedTime = currentTime - flowWindowStart;
+  if (elapsedTime < FLOW_WINDOW_MS) {
+    return flowRate;
   }
   
+  long pulseCount = windowPulses;
+  windowPulses = 0;
+  flowWindowStart = currentTime;
+  
   // Zet om naar seconden
   float elapsedTimeSeconds = elapsedTime / 1000.0;
   
-  // YF-S201 specificatie: 450 pulsen per liter
-  // Bereken flowrate: (pulsen / 450) / tijd_in_seconden * 60 = L/min
+  // Liters per puls volgen uit de kalibratietabel bij de gemeten pulsfrequentie
+  // (zonder kalibratie de YF-S201 specificatie van 450 pulsen per liter)
+  // Bereken flowrate: liters / tijd_in_seconden * 60 = L/min
   float currentFlowRate = 0.0;
+  float litersThisPeriod = 0.0;
+  flowFrequencyHz = pulseCount / elapsedTimeSeconds;
   
   if (pulseCount > 0) {
-    float litersThisPeriod = pulseCount / 450.0;  // YF-S201: 450 pulsen per liter
+    litersThisPeriod = pulseCount * flowLitersPerPulse(flowFrequencyHz);
     currentFlowRate = (litersThisPeriod / elapsedTimeSeconds) * 60.0;  // naar L/min
     
     // Update totaal volume
     totalLiters += litersThisPeriod;
+    flowTotalizerAdd(litersThisPeriod);
+    
+    // Volume van de huidige pompcyclus (voor volume modus)
+    if (pumpActive) {
+      if (pumpCycleStart != pumpStartTime) {
+        pumpCycleStart = pumpStartTime;
+        pumpCycleLiters = 0.0;
+      }
+      pumpCycleLiters += litersThisPeriod;
+    }
+    
+    // Tel mee in een lopende kalibratierun
+    flowCalibrationAddSample(pulseCount, elapsedTime);
   } else {
     currentFlowRate = 0.0;
   }
   
-  // Koppel interrupt opnieuw
-  attachInterrupt(digitalPinToInterrupt(FLOW_SENSOR_PIN), flowPulseCounter, FALLING);
+  // Voed de anomaliedetectie, ook met vensters zonder pulsen
+  flowAnomalyAddSample(litersThisPeriod, elapsedTime);
   
   return currentFlowRate;
 }
@@ -107,15 +178,16 @@ void checkFlowRate() {
   
   // Als de pomp aan staat, controleer op problemen
   if (pumpActive) {
-    // Wacht even na het inschakelen van de pomp (FLOW_CHECK_DELAY)
+    // Wacht even na het inschakelen van de pomp (geleerde aanlooptijd,
+    // tot er genoeg metingen zijn FLOW_CHECK_DELAY)
     unsigned long pumpOnTime = millis() - pumpStartTime;
     
-    if (pumpOnTime > FLOW_CHECK_DELAY) {
+    if (pumpOnTime > getFlowCheckDelay()) {
       // Controleer of we flow hebben
       unsigned long timeSinceLastPulse = millis() - lastPulseTime;
       
       // Als er geen flow is gedetecteerd en de minimale flowrate niet wordt gehaald
-      if (flowRate < settings.minFlowRate && timeSinceLastPulse > 10000) {
+      if (flowRate < settings.minFlowRate && timeSinceLastPulse > getNoPulseTimeout()) {
         if (flowOk) {  // Als dit de eerste keer is dat we een probleem detecteren
           Serial.println("WAARSCHUWING: Geen of onvoldoende waterstroming gedetecteerd!");
           Serial.print("Huidige flow: ");
@@ -129,12 +201,15 @@ void checkFlowRate() {
           
           flowOk = false;
           
-          // Stuur e-mail notificatie indien ingeschakeld
-          #if defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
-            if (settings.flowAlertEnabled) {
-              sendFlowAlertEmail();
-            }
-          #endif
+          // Meld het probleem via de ingestelde kanalen. Geen stroming bij
+          // een draaiende pomp is kritiek: direct melden
+          if (settings.flowAlertEnabled) {
+            char subject[96];
+            snprintf(subject, sizeof(subject), "WAARSCHUWING: Geen waterstroming in %s", settings.systeemnaam);
+            
+            AlertEvent event = { "no_flow", "Flow", subject, NO_FLOW_MESSAGE, true, 0 };
+            notifyAlert(event);
+          }
         }
       } else {
         if (!flowOk) {  // Als we net hersteld zijn van een probleem
@@ -147,26 +222,48 @@ void checkFlowRate() {
     // Als de pomp uit staat, reset de flowOk status
     flowOk = true;
   }
+  
+  // Volumeteller periodiek vastleggen
+  flowTotalizerLoop();
 }
 
 // Reset flow teller
 void resetFlowCounter() {
   totalLiters = 0.0;
+  flowTotalizerReset();
   Serial.println("Flow teller gereset");
 }
 
+// Volume afgegeven sinds de laatste pompstart
+float getPumpCycleLiters() {
+  if (pumpCycleStart != pumpStartTime) {
+    return 0.0;  // Pomp is opnieuw gestart en heeft nog niets gemeten
+  }
+  return pumpCycleLiters;
+}
+
 // Genereer JSON met flowsensor status
 String getFlowStatusJson() {
-  DynamicJsonDocument doc(512);
+  DynamicJsonDocument doc(1024);
   
   doc["flowRate"] = flowRate;
   doc["totalLiters"] = totalLiters;
+  doc["lifetimeLiters"] = getLifetimeLiters();
+  doc["todayLiters"] = getTodayLiters();
+  doc["yesterdayLiters"] = getYesterdayLiters();
+  doc["totalizerWrites"] = getTotalizerWriteCount();
+  doc["totalizerIntervalMin"] = settings.totalizerIntervalMin;
   doc["flowOk"] = flowOk;
   doc["minFlowRate"] = settings.minFlowRate;
   doc["flowAlertEnabled"] = settings.flowAlertEnabled;
   doc["pumpCapacityLPH"] = settings.pumpCapacityLPH;
   doc["sensorType"] = "YF-S201";
-  doc["pulsesPerLiter"] = 450;
+  doc["pulsesPerLiter"] = calculatePulseFactor();
+  doc["calibrated"] = settings.flowCalPoints > 0;
+  doc["calibrationPoints"] = settings.flowCalPoints;
+  doc["calibrationActive"] = flowCalibrationActive;
+  addFlowAnomalyJson(doc.createNestedObject("anomaly"));
+  addFlowRampJson(doc.createNestedObject("ramp"));
   
   #ifdef ENABLE_EMAIL_NOTIFICATION
     doc["emailEnabled"] = true;
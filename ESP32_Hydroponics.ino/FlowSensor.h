@@ -24,18 +24,11 @@
 
 #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
   // Externe variabelen
-  extern volatile long flowPulseCount;
-  extern float flowRate;
-  extern float totalLiters;
-  extern bool flowOk;
+  extern float flowFrequencyHz;
   
   // Functieprototypes
-  void setupFlowSensor();
   void IRAM_ATTR flowPulseCounter();
-  void checkFlowRate();
   float calculateFlowRate();
-  String getFlowStatusJson();
-  void resetFlowCounter();
 #endif
 
 #endif // FLOW_SENSOR_H
\ No newline at end of file
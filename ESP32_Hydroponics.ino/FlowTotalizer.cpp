@@ -0,0 +1,203 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowTotalizer.cpp
+ *
+ * Persistente volumeteller (levensduur, per dag en sinds reset) die een
+ * herstart overleeft. Elke schrijfactie bij iedere puls zou de flash snel
+ * verslijten, daarom wordt periodiek een journaalrecord weggeschreven in een
+ * vaste ronde van TOTALIZER_SLOTS sleutels in NVS. Elk record draagt een
+ * volgnummer; bij opstarten wordt de ronde gescand en het record met het
+ * hoogste volgnummer hersteld. NVS verdeelt de schrijfacties daarnaast zelf
+ * over de flashpagina's.
+ */
+
+#include "FlowTotalizer.h"
+#include "FlowSensor.h"
+#include <Preferences.h>
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+
+// Journaalrecord zoals opgeslagen in NVS (volumes in milliliters)
+struct TotalizerRecord {
+  uint32_t seq;            // Volgnummer, hoogste is het meest recent
+  uint64_t lifetimeMl;     // Totaal over de levensduur
+  uint64_t sinceResetMl;   // Totaal sinds laatste reset (totalLiters)
+  uint32_t todayMl;        // Totaal vandaag
+  uint32_t yesterdayMl;    // Totaal gisteren
+  int32_t dayStamp;        // Jaar * 1000 + dag van het jaar, 0 = onbekend
+};
+
+Preferences totalizerPrefs;
+
+// Tellers in RAM
+double lifetimeLiters = 0.0;
+double todayLiters = 0.0;
+double yesterdayLiters = 0.0;
+int32_t totalizerDayStamp = 0;
+
+// Journaal administratie
+uint32_t totalizerSeq = 0;              // Volgnummer van het laatst geschreven record
+double lastJournaledLifetime = 0.0;     // Levensduurstand bij het laatste record
+unsigned long lastTotalizerWrite = 0;   // Tijdstip van het laatste record
+unsigned long totalizerWriteCount = 0;  // Aantal geschreven records sinds opstarten
+
+// Huidige dagstempel, 0 als de tijd nog niet bekend is (niet-blokkerend)
+int32_t currentDayStamp() {
+  time_t now = time(nullptr);
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  
+  if (timeinfo.tm_year < (2020 - 1900)) {
+    return 0;
+  }
+  return (timeinfo.tm_year + 1900) * 1000 + timeinfo.tm_yday;
+}
+
+// Schrijf een nieuw record in het volgende slot van de ronde
+void writeTotalizerRecord() {
+  TotalizerRecord record;
+  record.seq = ++totalizerSeq;
+  record.lifetimeMl = (uint64_t)(lifetimeLiters * 1000.0);
+  record.sinceResetMl = (uint64_t)(totalLiters * 1000.0);
+  record.todayMl = (uint32_t)(todayLiters * 1000.0);
+  record.yesterdayMl = (uint32_t)(yesterdayLiters * 1000.0);
+  record.dayStamp = totalizerDayStamp;
+  
+  char key[8];
+  snprintf(key, sizeof(key), "r%u", (unsigned)(record.seq % TOTALIZER_SLOTS));
+  
+  if (totalizerPrefs.putBytes(key, &record, sizeof(record)) != sizeof(record)) {
+    Serial.println("FOUT: Kon volumeteller niet opslaan");
+    return;
+  }
+  
+  lastJournaledLifetime = lifetimeLiters;
+  lastTotalizerWrite = millis();
+  totalizerWriteCount++;
+  
+  if (settings.flowSensorDebug) {
+    Serial.print("Volumeteller opgeslagen in slot ");
+    Serial.println(key);
+  }
+}
+
+// Herstel de tellers uit het journaal
+void setupFlowTotalizer() {
+  // Begrens het schrijfinterval (een beschadigd NVS-veld kan willekeurig zijn)
+  if (settings.totalizerIntervalMin < 1 || settings.totalizerIntervalMin > 1440) {
+    settings.totalizerIntervalMin = 10;
+    markSettingDirty(&settings.totalizerIntervalMin);
+    saveSettings();
+  }
+  
+  totalizerPrefs.begin(TOTALIZER_NAMESPACE, false);
+  
+  TotalizerRecord newest = {};
+  bool found = false;
+  
+  // Scan de ronde en neem het record met het hoogste volgnummer
+  for (int slot = 0; slot < TOTALIZER_SLOTS; slot++) {
+    char key[8];
+    snprintf(key, sizeof(key), "r%d", slot);
+    
+    TotalizerRecord record;
+    if (totalizerPrefs.getBytes(key, &record, sizeof(record)) != sizeof(record)) {
+      continue;
+    }
+    
+    if (!found || record.seq > newest.seq) {
+      newest = record;
+      found = true;
+    }
+  }
+  
+  if (found) {
+    totalizerSeq = newest.seq;
+    lifetimeLiters = newest.lifetimeMl / 1000.0;
+    totalLiters = newest.sinceResetMl / 1000.0;
+    todayLiters = newest.todayMl / 1000.0;
+    yesterdayLiters = newest.yesterdayMl / 1000.0;
+    totalizerDayStamp = newest.dayStamp;
+  }
+  
+  lastJournaledLifetime = lifetimeLiters;
+  lastTotalizerWrite = millis();
+  
+  Serial.print("Volumeteller hersteld: ");
+  Serial.print(lifetimeLiters);
+  Serial.print(" L totaal, ");
+  Serial.print(totalLiters);
+  Serial.println(" L sinds reset");
+}
+
+// Tel een gemeten volume op bij de tellers
+void flowTotalizerAdd(float liters) {
+  lifetimeLiters += liters;
+  todayLiters += liters;
+}
+
+// Periodiek onderhoud: dagwissel en begrensd wegschrijven
+void flowTotalizerLoop() {
+  static unsigned long lastDayCheck = 0;
+  
+  // Dagwissel eens per minuut controleren
+  if (millis() - lastDayCheck > 60000) {
+    lastDayCheck = millis();
+    
+    int32_t day = currentDayStamp();
+    if (day != 0 && day != totalizerDayStamp) {
+      if (totalizerDayStamp != 0) {
+        // Alleen een directe opvolger telt als gisteren
+        bool consecutive = (day == totalizerDayStamp + 1) ||
+                           (day % 1000 == 0 && totalizerDayStamp % 1000 >= 364 &&
+                            day / 1000 == totalizerDayStamp / 1000 + 1);
+        yesterdayLiters = consecutive ? todayLiters : 0.0;
+        todayLiters = 0.0;
+      }
+      totalizerDayStamp = day;
+      writeTotalizerRecord();
+      return;
+    }
+  }
+  
+  // Schrijf hoogstens eens per ingesteld interval, en alleen als er iets veranderd is
+  unsigned long interval = (unsigned long)settings.totalizerIntervalMin * 60000UL;
+  if (millis() - lastTotalizerWrite >= interval && lifetimeLiters != lastJournaledLifetime) {
+    writeTotalizerRecord();
+  }
+}
+
+// Reset de teller sinds reset en leg dat direct vast
+void flowTotalizerReset() {
+  writeTotalizerRecord();
+}
+
+double getLifetimeLiters() {
+  return lifetimeLiters;
+}
+
+double getTodayLiters() {
+  return todayLiters;
+}
+
+double getYesterdayLiters() {
+  return yesterdayLiters;
+}
+
+unsigned long getTotalizerWriteCount() {
+  return totalizerWriteCount;
+}
+
+#endif // ENABLE_FLOW_SENSOR
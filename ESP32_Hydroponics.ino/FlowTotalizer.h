@@ -0,0 +1,38 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * FlowTotalizer.h
+ *
+ * Header voor de persistente volumeteller van de flowsensor
+ */
+
+#ifndef FLOW_TOTALIZER_H
+#define FLOW_TOTALIZER_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+  #define TOTALIZER_NAMESPACE "flowtot"   // NVS namespace voor het journaal
+  #define TOTALIZER_SLOTS 8               // Aantal records in de ronde
+  
+  // Functieprototypes
+  void setupFlowTotalizer();
+  void flowTotalizerAdd(float liters);
+  void flowTotalizerLoop();
+  void flowTotalizerReset();
+  double getYesterdayLiters();
+  unsigned long getTotalizerWriteCount();
+#endif
+
+#endif // FLOW_TOTALIZER_H
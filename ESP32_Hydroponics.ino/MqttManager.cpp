@@ -0,0 +1,436 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * MqttManager.cpp
+ *
+ * MQTT telemetrie met Home Assistant discovery. De module publiceert de
+ * toestand (temperatuur, pomp, stroming, alarmen) als retained berichten,
+ * maar alleen bij een wijziging: alle waarden worden eens per
+ * MQTT_PUBLISH_INTERVAL vergeleken met de laatst verstuurde waarde en wat
+ * veranderd is gaat in één keer de deur uit. Via het command topic kan de
+ * pomp handmatig worden bediend, net als met /api/override.
+ *
+ * Verbinden gebeurt in loop() en blokkeert dus de hoofdlus. PubSubClient
+ * zelf zou de hostnaam bij elke poging opzoeken en de TCP-verbinding openen
+ * met de standaard time-out van de WiFi-stack; setSocketTimeout() begrenst
+ * alleen het wachten op het antwoord van de broker. Daarom wordt de hostnaam
+ * één keer opgezocht (opnieuw na een mislukte verbinding, hooguit eens per
+ * MQTT_RESOLVE_INTERVAL) en opent de module de TCP-verbinding zelf met
+ * MQTT_CONNECT_TIMEOUT. Een poging blokkeert zo hooguit 1 s plus 2 s voor
+ * het antwoord; alleen het opzoeken van een hostnaam kan tot de DNS-time-out
+ * van de WiFi-stack duren. Met een IP-adres als broker is er geen DNS nodig.
+ *
+ * Topics (<basis> en <id> zijn instelbaar resp. afgeleid van het MAC-adres):
+ *   <basis>/<id>/status            online/offline (laatste wil)
+ *   <basis>/<id>/temperature       °C
+ *   <basis>/<id>/pump              ON/OFF
+ *   <basis>/<id>/mode              AUTO/ON/OFF
+ *   <basis>/<id>/flow              L/min
+ *   <basis>/<id>/liters            L sinds reset
+ *   <basis>/<id>/alarm             ON/OFF
+ *   <basis>/<id>/mode/set          opdracht: AUTO, ON of OFF
+ */
+
+#include "MqttManager.h"
+
+#if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+
+WiFiClient mqttWifiClient;
+PubSubClient mqttClient(mqttWifiClient);
+
+// Verbindingsbeheer
+static bool mqttConfigured = false;
+static char mqttNodeId[20];                  // "hydro_" + laatste 6 hex cijfers van het MAC-adres
+static char mqttTopicPrefix[56];             // <basis>/<id>
+static unsigned long mqttLastAttempt = 0;
+static unsigned long mqttReconnectDelay = MQTT_RECONNECT_MIN;
+static bool mqttDiscoveryPending = false;
+static unsigned long mqttLastPublish = 0;
+
+// Adres van de broker
+static IPAddress mqttBrokerIp;
+static bool mqttHostIsIp = false;            // Ingesteld als IP-adres, geen DNS nodig
+static bool mqttHaveIp = false;              // mqttBrokerIp is geldig
+static bool mqttResolveDue = false;          // Verbinding mislukt: adres opnieuw opzoeken
+static unsigned long mqttLastResolve = 0;
+static unsigned long mqttLastAttemptMs = 0;  // Hoe lang de laatste poging de hoofdlus blokkeerde
+
+// Statistieken
+static uint32_t mqttConnects = 0;
+static uint32_t mqttPublished = 0;
+static uint32_t mqttCommands = 0;
+static uint32_t mqttResolves = 0;
+static uint32_t mqttConnectFailures = 0;
+
+// Laatst verstuurde waarden; NAN of -1 betekent "nog niet verstuurd"
+static float lastTemperature = NAN;
+static int lastPump = -1;
+static int lastMode = -1;
+static int lastAlarm = -1;
+#if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+static float lastFlow = NAN;
+static float lastLiters = NAN;
+#endif
+
+// Ontvangen opdracht, verwerkt buiten de callback
+static int pendingMode = -1;
+
+enum MqttMode { MQTT_MODE_AUTO = 0, MQTT_MODE_ON = 1, MQTT_MODE_OFF = 2 };
+
+static const char* modeName(int mode) {
+  switch (mode) {
+    case MQTT_MODE_ON: return "ON";
+    case MQTT_MODE_OFF: return "OFF";
+    default: return "AUTO";
+  }
+}
+
+// Bouw een volledig topic op
+static void mqttTopic(char* buffer, size_t size, const char* suffix) {
+  snprintf(buffer, size, "%s/%s", mqttTopicPrefix, suffix);
+}
+
+// Publiceer een retained waarde
+static void publishState(const char* suffix, const char* payload) {
+  char topic[80];
+  mqttTopic(topic, sizeof(topic), suffix);
+  if (mqttClient.publish(topic, payload, true)) {
+    mqttPublished++;
+  }
+}
+
+static void publishFloat(const char* suffix, float value, int decimals) {
+  char payload[16];
+  snprintf(payload, sizeof(payload), "%.*f", decimals, value);
+  publishState(suffix, payload);
+}
+
+// Verwerk binnenkomende berichten (alleen het command topic)
+static void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
+  char command[8];
+  unsigned int n = length < sizeof(command) - 1 ? length : sizeof(command) - 1;
+  memcpy(command, payload, n);
+  command[n] = '\0';
+  
+  if (strcasecmp(command, "AUTO") == 0) {
+    pendingMode = MQTT_MODE_AUTO;
+  } else if (strcasecmp(command, "ON") == 0) {
+    pendingMode = MQTT_MODE_ON;
+  } else if (strcasecmp(command, "OFF") == 0) {
+    pendingMode = MQTT_MODE_OFF;
+  } else {
+    Serial.print("MQTT: onbekende opdracht: ");
+    Serial.println(command);
+  }
+}
+
+// Voer een ontvangen opdracht uit, op dezelfde manier als /api/override
+static void applyPendingCommand() {
+  if (pendingMode < 0) {
+    return;
+  }
+  
+  int mode = pendingMode;
+  pendingMode = -1;
+  mqttCommands++;
+  
+  Serial.print("MQTT opdracht: ");
+  Serial.println(modeName(mode));
+  
+  if (mode == MQTT_MODE_AUTO) {
+    setPumpAuto();
+  } else {
+    setPumpManual(mode == MQTT_MODE_ON);
+  }
+}
+
+// Publiceer de Home Assistant discovery configuratie van één entiteit
+static void publishDiscovery(const char* component, const char* object, const char* name,
+                             const char* stateSuffix, const char* unit, const char* deviceClass,
+                             const char* extra) {
+  char topic[96];
+  snprintf(topic, sizeof(topic), "homeassistant/%s/%s/%s/config", component, mqttNodeId, object);
+  
+  static char payload[MQTT_BUFFER_SIZE - 128];
+  int len = snprintf(payload, sizeof(payload),
+    "{\"name\":\"%s\",\"uniq_id\":\"%s_%s\",\"stat_t\":\"%s/%s\","
+    "\"avty_t\":\"%s/status\"",
+    name, mqttNodeId, object, mqttTopicPrefix, stateSuffix, mqttTopicPrefix);
+  
+  if (unit != NULL) {
+    len += snprintf(payload + len, sizeof(payload) - len, ",\"unit_of_meas\":\"%s\"", unit);
+  }
+  if (deviceClass != NULL) {
+    len += snprintf(payload + len, sizeof(payload) - len, ",\"dev_cla\":\"%s\"", deviceClass);
+  }
+  if (extra != NULL) {
+    len += snprintf(payload + len, sizeof(payload) - len, ",%s", extra);
+  }
+  snprintf(payload + len, sizeof(payload) - len,
+    ",\"dev\":{\"ids\":[\"%s\"],\"name\":\"%s\",\"mf\":\"AXISKOM\",\"mdl\":\"ESP32 Hydro Controller\"}}",
+    mqttNodeId, settings.systeemnaam);
+  
+  if (mqttClient.publish(topic, payload, true)) {
+    mqttPublished++;
+  }
+}
+
+// Kondig alle entiteiten aan bij Home Assistant
+static void publishAllDiscovery() {
+  char extra[160];
+  
+  publishDiscovery("sensor", "temperature", "Temperatuur", "temperature", "°C", "temperature",
+                   "\"stat_cla\":\"measurement\"");
+  publishDiscovery("binary_sensor", "pump", "Pomp", "pump", NULL, "running", NULL);
+  
+  snprintf(extra, sizeof(extra), "\"cmd_t\":\"%s/mode/set\",\"options\":[\"AUTO\",\"ON\",\"OFF\"]",
+           mqttTopicPrefix);
+  publishDiscovery("select", "mode", "Pompbediening", "mode", NULL, NULL, extra);
+  
+  publishDiscovery("binary_sensor", "alarm", "Alarm", "alarm", NULL, "problem", NULL);
+  
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    publishDiscovery("sensor", "flow", "Waterstroming", "flow", "L/min", NULL,
+                     "\"stat_cla\":\"measurement\",\"ic\":\"mdi:water-pump\"");
+    publishDiscovery("sensor", "liters", "Doorgestroomd", "liters", "L", "water",
+                     "\"stat_cla\":\"total_increasing\"");
+  #endif
+}
+
+// Vergelijk alle waarden met de laatst verstuurde en publiceer de wijzigingen
+static void publishChanges() {
+  if (!isnan(currentTemp) && (isnan(lastTemperature) || fabsf(currentTemp - lastTemperature) >= 0.1f)) {
+    publishFloat("temperature", currentTemp, 1);
+    lastTemperature = currentTemp;
+  }
+  
+  int pump = pumpActive ? 1 : 0;
+  if (pump != lastPump) {
+    publishState("pump", pump ? "ON" : "OFF");
+    lastPump = pump;
+  }
+  
+  int mode = manualOverride ? (pumpActive ? MQTT_MODE_ON : MQTT_MODE_OFF) : MQTT_MODE_AUTO;
+  if (mode != lastMode) {
+    publishState("mode", modeName(mode));
+    lastMode = mode;
+  }
+  
+  int alarm = 0;
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    alarm = (!flowOk || getFlowAnomalies() != 0) ? 1 : 0;
+    
+    if (isnan(lastFlow) || fabsf(flowRate - lastFlow) >= 0.1f) {
+      publishFloat("flow", flowRate, 2);
+      lastFlow = flowRate;
+    }
+    
+    if (isnan(lastLiters) || fabsf(totalLiters - lastLiters) >= 0.1f || totalLiters < lastLiters) {
+      publishFloat("liters", totalLiters, 1);
+      lastLiters = totalLiters;
+    }
+  #endif
+  
+  if (alarm != lastAlarm) {
+    publishState("alarm", alarm ? "ON" : "OFF");
+    lastAlarm = alarm;
+  }
+}
+
+// Vergeet de laatst verstuurde waarden zodat alles opnieuw wordt gepubliceerd
+static void resetPublishedState() {
+  lastTemperature = NAN;
+  lastPump = -1;
+  lastMode = -1;
+  lastAlarm = -1;
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    lastFlow = NAN;
+    lastLiters = NAN;
+  #endif
+}
+
+// Zoek het adres van de broker op; een bekend adres blijft geldig tot een
+// verbinding mislukt, en ook dan wordt hooguit eens per MQTT_RESOLVE_INTERVAL gezocht
+static bool mqttResolveBroker() {
+  if (mqttHostIsIp) {
+    return true;
+  }
+  if (mqttHaveIp && (!mqttResolveDue || millis() - mqttLastResolve < MQTT_RESOLVE_INTERVAL)) {
+    return true;
+  }
+  
+  mqttLastResolve = millis();
+  mqttResolves++;
+  
+  IPAddress ip;
+  if (WiFi.hostByName(settings.mqttHost, ip) == 1 && (uint32_t)ip != 0) {
+    mqttBrokerIp = ip;
+    mqttHaveIp = true;
+    mqttResolveDue = false;
+    mqttClient.setServer(mqttBrokerIp, settings.mqttPort);
+  } else {
+    Serial.print("MQTT: kon ");
+    Serial.print(settings.mqttHost);
+    Serial.println(" niet opzoeken");
+  }
+  return mqttHaveIp;   // Bij een mislukte zoekactie het vorige adres blijven gebruiken
+}
+
+// Probeer te verbinden met de broker
+static bool mqttConnect() {
+  if (!mqttResolveBroker()) {
+    return false;
+  }
+  
+  // TCP-verbinding zelf openen met een korte time-out; PubSubClient gebruikt
+  // een open verbinding en doet dan alleen nog de MQTT-aanmelding
+  if (!mqttWifiClient.connect(mqttBrokerIp, settings.mqttPort, MQTT_CONNECT_TIMEOUT)) {
+    mqttConnectFailures++;
+    mqttResolveDue = true;   // Broker mogelijk verhuisd naar een ander adres
+    return false;
+  }
+  
+  char statusTopic[80];
+  mqttTopic(statusTopic, sizeof(statusTopic), "status");
+  
+  const char* user = strlen(settings.mqttUser) > 0 ? settings.mqttUser : NULL;
+  const char* pass = strlen(settings.mqttUser) > 0 ? settings.mqttPassword : NULL;
+  
+  // Laatste wil: de broker meldt "offline" als de verbinding wegvalt
+  if (!mqttClient.connect(mqttNodeId, user, pass, statusTopic, 0, true, "offline")) {
+    return false;
+  }
+  
+  mqttClient.publish(statusTopic, "online", true);
+  
+  char commandTopic[80];
+  mqttTopic(commandTopic, sizeof(commandTopic), "mode/set");
+  mqttClient.subscribe(commandTopic);
+  
+  mqttConnects++;
+  resetPublishedState();
+  mqttDiscoveryPending = settings.mqttDiscovery;
+  return true;
+}
+
+// Initialiseer de MQTT module
+void setupMqtt() {
+  // Bij opnieuw instellen eerst de bestaande verbinding sluiten
+  if (mqttClient.connected()) {
+    mqttClient.disconnect();
+  }
+  
+  if (strlen(settings.mqttHost) == 0) {
+    Serial.println("MQTT: geen broker ingesteld, module uitgeschakeld");
+    mqttConfigured = false;
+    return;
+  }
+  
+  uint64_t mac = ESP.getEfuseMac();
+  snprintf(mqttNodeId, sizeof(mqttNodeId), "hydro_%06lx", (unsigned long)((mac >> 24) & 0xFFFFFF));
+  snprintf(mqttTopicPrefix, sizeof(mqttTopicPrefix), "%s/%s", settings.mqttBaseTopic, mqttNodeId);
+  
+  // Een IP-adres hoeft niet opgezocht te worden; een hostnaam bij de eerste poging
+  mqttHostIsIp = mqttBrokerIp.fromString(settings.mqttHost);
+  mqttHaveIp = mqttHostIsIp;
+  mqttResolveDue = false;
+  if (mqttHostIsIp) {
+    mqttClient.setServer(mqttBrokerIp, settings.mqttPort);
+  }
+  mqttClient.setCallback(mqttCallback);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+  mqttClient.setSocketTimeout(2);   // Wachten op het antwoord van de broker; de TCP-verbinding begrenst mqttConnect()
+  mqttClient.setKeepAlive(30);
+  
+  mqttConfigured = true;
+  mqttLastAttempt = millis() - MQTT_RECONNECT_MIN;
+  mqttReconnectDelay = MQTT_RECONNECT_MIN;
+  
+  Serial.print("MQTT broker: ");
+  Serial.print(settings.mqttHost);
+  Serial.print(":");
+  Serial.print(settings.mqttPort);
+  Serial.print(", topics onder ");
+  Serial.println(mqttTopicPrefix);
+}
+
+// Aanroepen vanuit loop()
+void mqttLoop() {
+  if (!mqttConfigured || WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  
+  if (!mqttClient.connected()) {
+    // Herverbinden met oplopende wachttijd
+    if (millis() - mqttLastAttempt < mqttReconnectDelay) {
+      return;
+    }
+    mqttLastAttempt = millis();
+    
+    bool connected = mqttConnect();
+    mqttLastAttemptMs = millis() - mqttLastAttempt;
+    
+    if (connected) {
+      Serial.println("MQTT verbonden");
+      mqttReconnectDelay = MQTT_RECONNECT_MIN;
+    } else {
+      Serial.print("MQTT verbinding mislukt, status ");
+      Serial.println(mqttClient.state());
+      mqttReconnectDelay = min(mqttReconnectDelay * 2, (unsigned long)MQTT_RECONNECT_MAX);
+      return;
+    }
+  }
+  
+  mqttClient.loop();
+  applyPendingCommand();
+  
+  // Discovery eenmalig na elke (her)verbinding
+  if (mqttDiscoveryPending) {
+    publishAllDiscovery();
+    mqttDiscoveryPending = false;
+  }
+  
+  // Verzamel wijzigingen en verstuur ze samen
+  if (millis() - mqttLastPublish >= MQTT_PUBLISH_INTERVAL) {
+    publishChanges();
+    mqttLastPublish = millis();
+  }
+}
+
+bool isMqttConnected() {
+  return mqttConfigured && mqttClient.connected();
+}
+
+// Genereer JSON met MQTT status
+String getMqttStatusJson() {
+  DynamicJsonDocument doc(512);
+  
+  doc["configured"] = mqttConfigured;
+  doc["connected"] = isMqttConnected();
+  doc["state"] = mqttClient.state();
+  doc["topicPrefix"] = mqttTopicPrefix;
+  doc["connects"] = mqttConnects;
+  doc["published"] = mqttPublished;
+  doc["commands"] = mqttCommands;
+  doc["brokerIp"] = mqttHaveIp ? mqttBrokerIp.toString() : "";
+  doc["resolves"] = mqttResolves;
+  doc["connectFailures"] = mqttConnectFailures;
+  doc["lastAttemptMs"] = mqttLastAttemptMs;
+  
+  String response;
+  serializeJson(doc, response);
+  return response;
+}
+
+#endif // defined(ENABLE_MQTT) && ENABLE_MQTT == true
@@ -0,0 +1,36 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * MqttManager.h
+ *
+ * Header voor de MQTT telemetrie module
+ */
+
+#ifndef MQTT_MANAGER_H
+#define MQTT_MANAGER_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+  #include <PubSubClient.h>
+  
+  #define MQTT_PUBLISH_INTERVAL 1000      // Wijzigingen verzamelen en eens per seconde versturen
+  #define MQTT_RECONNECT_MIN 5000         // Eerste herverbindingspoging na 5 s
+  #define MQTT_RECONNECT_MAX 300000       // Daarna oplopend tot maximaal 5 minuten
+  #define MQTT_BUFFER_SIZE 768            // Ruimte voor de discovery berichten
+  #define MQTT_CONNECT_TIMEOUT 1000       // TCP-verbinding met de broker opgeven na 1 s
+  #define MQTT_RESOLVE_INTERVAL 600000    // Hostnaam van de broker hooguit eens per 10 minuten opnieuw opzoeken
+#endif
+
+#endif // MQTT_MANAGER_H
@@ -0,0 +1,98 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * Notification.cpp
+ *
+ * Meldingslaag tussen de bronnen van waarschuwingen (flowsensor, afwijkingen)
+ * en de kanalen waarlangs ze verstuurd worden. Elk kanaal meldt zich bij het
+ * opstarten aan met registerNotificationSink(); notifyAlert() biedt een
+ * waarschuwing aan alle kanalen aan. Per kanaal wordt bijgehouden hoeveel
+ * waarschuwingen zijn aangeboden, geaccepteerd en geweigerd; de kanalen
+ * vullen dat aan met hun eigen latentie- en foutgegevens.
+ */
+
+#include "Notification.h"
+
+// Aangemelde kanalen
+static const NotificationSink* sinks[NOTIFICATION_MAX_SINKS];
+static uint32_t sinkOffered[NOTIFICATION_MAX_SINKS];
+static uint32_t sinkAccepted[NOTIFICATION_MAX_SINKS];
+static int sinkCount = 0;
+
+// Meld een kanaal aan
+bool registerNotificationSink(const NotificationSink* sink) {
+  for (int i = 0; i < sinkCount; i++) {
+    if (sinks[i] == sink) {
+      return true;  // Al aangemeld (bijv. bij opnieuw initialiseren)
+    }
+  }
+  
+  if (sinkCount >= NOTIFICATION_MAX_SINKS) {
+    Serial.println("FOUT: Maximaal aantal meldingskanalen bereikt");
+    return false;
+  }
+  
+  sinks[sinkCount] = sink;
+  sinkOffered[sinkCount] = 0;
+  sinkAccepted[sinkCount] = 0;
+  sinkCount++;
+  
+  Serial.print("Meldingskanaal aangemeld: ");
+  Serial.println(sink->name);
+  return true;
+}
+
+// Bied een waarschuwing aan alle kanalen aan. Geeft het aantal kanalen
+// terug dat de waarschuwing heeft geaccepteerd.
+int notifyAlert(AlertEvent& event) {
+  time_t now = time(nullptr);
+  event.time = (now > 1577836800) ? now : 0;  // 1-1-2020
+  
+  int accepted = 0;
+  for (int i = 0; i < sinkCount; i++) {
+    sinkOffered[i]++;
+    if (sinks[i]->deliver(event)) {
+      sinkAccepted[i]++;
+      accepted++;
+    }
+  }
+  
+  if (sinkCount > 0 && accepted == 0) {
+    Serial.print("WAARSCHUWING: Geen enkel kanaal heeft de melding geaccepteerd: ");
+    Serial.println(event.subject);
+  }
+  
+  return accepted;
+}
+
+// Genereer JSON met de status van alle kanalen
+String getNotificationStatusJson() {
+  DynamicJsonDocument doc(1536);
+  JsonArray list = doc.createNestedArray("sinks");
+  
+  for (int i = 0; i < sinkCount; i++) {
+    JsonObject obj = list.createNestedObject();
+    obj["name"] = sinks[i]->name;
+    obj["offered"] = sinkOffered[i];
+    obj["accepted"] = sinkAccepted[i];
+    obj["rejected"] = sinkOffered[i] - sinkAccepted[i];
+    if (sinks[i]->addStatusJson != NULL) {
+      sinks[i]->addStatusJson(obj);
+    }
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  return response;
+}
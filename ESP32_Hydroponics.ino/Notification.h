@@ -0,0 +1,50 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * Notification.h
+ *
+ * Header voor de generieke meldingslaag (waarschuwingen naar e-mail, webhook, ...)
+ */
+
+#ifndef NOTIFICATION_H
+#define NOTIFICATION_H
+
+#include "Settings.h"
+
+#define NOTIFICATION_MAX_SINKS 4
+
+// Eén waarschuwing, onafhankelijk van het kanaal waarlangs ze verstuurd wordt
+struct AlertEvent {
+  const char* kind;        // Korte machineleesbare soort, bijv. "no_flow"
+  const char* subsystem;   // Onderdeel waar de waarschuwing vandaan komt, bijv. "Flow"
+  const char* subject;     // Korte titel
+  const char* message;     // Uitgebreide tekst
+  bool critical;           // Kritiek: niet bundelen of uitstellen
+  time_t time;             // Tijdstip, ingevuld door notifyAlert (0 = onbekend)
+};
+
+// Een meldingskanaal. deliver() moet snel terugkeren: het echte versturen
+// hoort in een eigen taak of wachtrij van het kanaal.
+struct NotificationSink {
+  const char* name;
+  bool (*deliver)(const AlertEvent& event);     // true = geaccepteerd
+  void (*addStatusJson)(JsonObject obj);        // Kanaalspecifieke status (latentie, fouten)
+};
+
+// Functieprototypes
+bool registerNotificationSink(const NotificationSink* sink);
+int notifyAlert(AlertEvent& event);
+String getNotificationStatusJson();
+
+#endif // NOTIFICATION_H
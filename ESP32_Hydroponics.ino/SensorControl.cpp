@@ -18,6 +18,7 @@
  */
 
 #include "Settings.h"
+#include "Notification.h"
 
 // Initialiseer OneWire en DallasTemperature instances
 OneWire oneWire(ONE_WIRE_BUS);
@@ -29,6 +30,9 @@ bool lastNightModeState = false;
 unsigned long totalPumpRunTime = 0;  // Totale pompdraaitijd
 bool pumpCycleActive = false;        // Actief met pompcyclus
 float lastTempReading = 0;           // Laatste temperatuurmeting
+#ifdef ENABLE_FLOW_SENSOR
+  unsigned long volumeShortCycles = 0; // Volume modus: cycli beëindigd door de tijdslimiet
+#endif
 
 // Configureer temperatuursensor
 void setupTemperatureSensor() {
@@ -86,7 +90,7 @@ void updateTemperature() {
 // Update pompcyclustijden op basis van huidige temperatuur en nachtmodus
 void updatePumpCycleTimes() {
   static unsigned long lastCyclusLog = 0;
-  static int lastCyclusType = -1; // -1=geen, 0=continu, 1=laag, 2=midden, 3=hoog, 4=nacht
+  static int lastCyclusType = -1; // -1=geen, 0=continu, 1=laag, 2=midden, 3=hoog, 4=nacht, 5=kalender
   
   // Detecteer nachtmodus
   bool nightMode = isNightMode();
@@ -107,10 +111,30 @@ void updatePumpCycleTimes() {
   // Reset cyclus vlag voor interval modus
   pumpCycleActive = false;
   
+  // Een actief kalendervenster gaat voor nacht- en temperatuurcyclus
+  const CalendarWindow* window = getActiveCalendarWindow();
+  if (window != NULL) {
+    currentCycleOn = window->aan;
+    currentCycleOff = window->uit;
+    #ifdef ENABLE_FLOW_SENSOR
+      currentCycleLiters = window->deciliters / 10.0;
+    #endif
+    
+    lastNightModeState = false;
+    if (lastCyclusType != 5) {
+      Serial.println("Kalendervenster actief, cyclus uit de kalender van toepassing");
+      lastCyclusType = 5;
+    }
+    return;
+  }
+  
   // Als in nachtmodus, gebruik nachtinstellingen
   if (nightMode) {
     currentCycleOn = settings.nacht_aan;
     currentCycleOff = settings.nacht_uit;
+    #ifdef ENABLE_FLOW_SENSOR
+      currentCycleLiters = settings.nacht_liters;
+    #endif
     
     // Log alleen als we net nachtmodus ingaan
     if (!lastNightModeState) {
@@ -126,6 +150,9 @@ void updatePumpCycleTimes() {
       // Lage temperatuur cyclus
       currentCycleOn = settings.temp_laag_aan;
       currentCycleOff = settings.temp_laag_uit;
+      #ifdef ENABLE_FLOW_SENSOR
+        currentCycleLiters = settings.temp_laag_liters;
+      #endif
       
       // Log alleen bij wijziging of elke 5 minuten
       if (lastCyclusType != 1 || (millis() - lastCyclusLog > 100000)) {
@@ -142,6 +169,9 @@ void updatePumpCycleTimes() {
       // Midden temperatuur cyclus
       currentCycleOn = settings.temp_midden_aan;
       currentCycleOff = settings.temp_midden_uit;
+      #ifdef ENABLE_FLOW_SENSOR
+        currentCycleLiters = settings.temp_midden_liters;
+      #endif
       
       // Log alleen bij wijziging of elke 5 minuten
       if (lastCyclusType != 2 || (millis() - lastCyclusLog > 100000)) {
@@ -160,6 +190,9 @@ void updatePumpCycleTimes() {
       // Hoge temperatuur cyclus
       currentCycleOn = settings.temp_hoog_aan;
       currentCycleOff = settings.temp_hoog_uit;
+      #ifdef ENABLE_FLOW_SENSOR
+        currentCycleLiters = settings.temp_hoog_liters;
+      #endif
       
       // Log alleen bij wijziging of elke 5 minuten
       if (lastCyclusType != 3 || (millis() - lastCyclusLog > 100000)) {
@@ -188,6 +221,42 @@ void managePump() {
   unsigned long elapsedTime = currentTime - lastPumpStateChange;
   
   // Controleer of huidige status moet worden gewijzigd
+  #ifdef ENABLE_FLOW_SENSOR
+    if (pumpActive && settings.volumeModus && currentCycleLiters > 0) {
+      // Volume modus: uit zodra het doelvolume is afgegeven, met een tijdslimiet als vangnet
+      // (een kalendervenster zonder doelvolume houdt de AAN-tijd aan)
+      bool targetReached = getPumpCycleLiters() >= currentCycleLiters;
+      bool timeLimitReached = elapsedTime >= (unsigned long)settings.volumeMaxAan * 1000;
+      
+      if (targetReached || timeLimitReached) {
+        if (!targetReached) {
+          volumeShortCycles++;
+          Serial.print("WAARSCHUWING: Doelvolume niet gehaald binnen tijdslimiet (");
+          Serial.print(getPumpCycleLiters());
+          Serial.print(" van ");
+          Serial.print(currentCycleLiters);
+          Serial.println(" L)");
+          
+          if (settings.flowAlertEnabled) {
+            char subject[96];
+            char message[160];
+            snprintf(subject, sizeof(subject), "Doelvolume niet gehaald in %s", settings.systeemnaam);
+            snprintf(message, sizeof(message),
+                     "De pomp is na de tijdslimiet van %d seconden gestopt met %.1f van %.1f liter.\n\n"
+                     "Controleer pomp, leidingen en filter.",
+                     settings.volumeMaxAan, getPumpCycleLiters(), currentCycleLiters);
+            
+            AlertEvent event = { "volume_short", "Flow", subject, message, false, 0 };
+            notifyAlert(event);
+          }
+        }
+        setRelayState(false);
+        lastPumpStateChange = currentTime;
+      }
+      return;
+    }
+  #endif
+  
   if (pumpActive) {
     // Pomp is aan, controleer of uitschakeltijd is bereikt
     if (elapsedTime >= (unsigned long)(currentCycleOn * 1000)) {
@@ -38,6 +38,8 @@
 // TRUE = ingeschakeld, FALSE = uitgeschakeld
 #define ENABLE_FLOW_SENSOR true      // Waterstroomsensor
 #define ENABLE_EMAIL_NOTIFICATION true  // E-mail notificaties (alleen relevant als ENABLE_FLOW_SENSOR = true)
+#define ENABLE_MQTT false            // MQTT telemetrie en Home Assistant discovery
+#define ENABLE_WEBHOOK true          // Waarschuwingen als JSON naar een webhook URL
 
 // Pindefinities
 #define ONE_WIRE_BUS 4    // GPIO4 voor DS18B20 temperatuursensor
@@ -46,14 +48,31 @@
 #ifdef ENABLE_FLOW_SENSOR
   #define FLOW_SENSOR_PIN 14 // GPIO14 voor YF-S201 flowsensor
   #define FLOW_BASE_PULSE_FACTOR 450.0  // YF-S201 geeft 450 pulsen per liter
-  #define FLOW_CHECK_DELAY 5000  // Wachttijd na pompstart (ms)
+  #define FLOW_CHECK_DELAY 5000  // Wachttijd na pompstart (ms) zolang de aanloop nog niet geleerd is
+  #define FLOW_CAL_MAX_POINTS 8         // Maximaal aantal kalibratiepunten (K-factor per frequentie)
+  #define FLOW_CAL_BIN_HZ 4.0           // Breedte van een frequentievak in de opzoektabel (Hz)
+  #define FLOW_CAL_BINS 64              // Aantal frequentievakken (64 x 4 Hz = 0-256 Hz)
+  #define FLOW_CAL_MIN_PULSES 100       // Minimaal aantal pulsen voor een geldige kalibratierun
 #endif
 
 // Overige constanten
-#define EEPROM_SIZE 512
+#define EEPROM_SIZE 512     // Oude EEPROM-indeling, alleen nog gelezen bij de eenmalige overstap naar NVS
 #define EEPROM_MAGIC 0xABCD
+#define CROP_PROFILE_NAME_LEN 24    // Maximale lengte van een gewasprofielnaam (incl. afsluitende nul)
 const int NACHT_START_UUR = 22; // Nacht begint om 22:00
 const int NACHT_EIND_UUR = 6;   // Nacht eindigt om 06:00
+#define CALENDAR_MAX_WINDOWS 8      // Maximaal aantal vensters in de weekkalender
+
+// Venster in de weekkalender met een eigen pompcyclus (lokale tijd)
+struct CalendarWindow {
+  uint8_t days;          // Dagen waarop het venster begint: bit 0 = zondag ... bit 6 = zaterdag
+  uint8_t reserved;
+  uint16_t start;        // Begin in minuten na middernacht
+  uint16_t end;          // Einde in minuten na middernacht; niet groter dan start = loopt door na middernacht
+  uint16_t aan;          // AAN-tijd in seconden
+  uint16_t uit;          // UIT-tijd in seconden
+  uint16_t deciliters;   // Doelvolume per cyclus in volume modus (0,1 L), 0 = AAN-tijd aanhouden
+};
 
 // Instellingen struct
 struct TempSettings {
@@ -93,6 +112,47 @@ struct TempSettings {
     bool emailDebug = false;         // Debug modus voor e-mail
   #endif
   
+  // Flowsensor kalibratietabel (K-factor in pulsen per liter per frequentie)
+  // Achteraan de struct zodat bestaande EEPROM-indelingen niet verschuiven
+  #ifdef ENABLE_FLOW_SENSOR
+    uint8_t flowCalPoints = 0;                       // Aantal geldige kalibratiepunten (0 = fabriekswaarde)
+    float flowCalFreq[FLOW_CAL_MAX_POINTS] = {0};    // Pulsfrequentie per punt (Hz), oplopend
+    float flowCalK[FLOW_CAL_MAX_POINTS] = {0};       // Gemeten pulsen per liter per punt
+    int totalizerIntervalMin = 10;                   // Minuten tussen opslaan van de volumeteller
+  #endif
+  
+  // Volume modus: AAN-fase eindigt na een doelvolume in plaats van een vaste tijd
+  #ifdef ENABLE_FLOW_SENSOR
+    bool volumeModus = false;        // Volume modus actief (alleen in interval modus)
+    float temp_laag_liters = 5.0;    // Doelvolume per cyclus als temp < laag (L)
+    float temp_midden_liters = 5.0;  // Doelvolume per cyclus als temp laag-hoog (L)
+    float temp_hoog_liters = 5.0;    // Doelvolume per cyclus als temp > hoog (L)
+    float nacht_liters = 2.5;        // Doelvolume per cyclus 's nachts (L)
+    int volumeMaxAan = 300;          // Veiligheidsgrens AAN-tijd in volume modus (seconden)
+  #endif
+  
+  // MQTT broker instellingen
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    char mqttHost[64] = "";          // Hostnaam of IP van de broker, leeg = uitgeschakeld
+    uint16_t mqttPort = 1883;        // Poort van de broker
+    char mqttUser[32] = "";          // Gebruikersnaam, leeg = anoniem
+    char mqttPassword[32] = "";      // Wachtwoord
+    char mqttBaseTopic[32] = "hydro";  // Basis voor alle topics
+    bool mqttDiscovery = true;       // Home Assistant discovery publiceren
+  #endif
+  
+  // Webhook instellingen
+  #if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+    char webhookUrl[128] = "";       // URL voor waarschuwingen (http of https), leeg = uitgeschakeld
+  #endif
+  
+  // Gewasprofiel waarvan de cyclustijden en grenzen nu gelden, leeg = handmatig ingesteld
+  char activeProfile[CROP_PROFILE_NAME_LEN] = "";
+  
+  // Weekkalender; een actief venster gaat voor dag- en nachtcyclus
+  uint8_t calendarCount = 0;
+  CalendarWindow calendar[CALENDAR_MAX_WINDOWS] = {};
+  
 };
 
 // Externe variabelen
@@ -105,14 +165,29 @@ extern unsigned long pumpRunTime;
 extern bool manualOverride;
 extern int currentCycleOn;
 extern int currentCycleOff;
+#ifdef ENABLE_FLOW_SENSOR
+  extern float currentCycleLiters;
+  extern unsigned long volumeShortCycles;
+#endif
 
 // SettingsImpl.cpp prototypes
 void loadSettings();
 void saveSettings();
 
+// SettingsStore.cpp: markeer een gewijzigd veld, bijv. markSettingDirty(&settings.systeemnaam)
+void markSettingDirty(const void* field);
+void settingsStoreLoop();
+void flushSettings();
+bool hasDirtySettings();
+
 // WiFiManager.cpp prototypes
+enum WiFiState { WIFI_STATE_IDLE, WIFI_STATE_CONNECTING, WIFI_STATE_CONNECTED, WIFI_STATE_WAITING };
 void setupWiFi();
 void checkWiFiConnection();
+WiFiState getWiFiState();
+const char* getWiFiStateName();
+unsigned long getWiFiRetryIn();
+String getWiFiJson();
 
 // TimeManager.cpp prototypes
 void setupTime();
@@ -122,6 +197,20 @@ bool isNightMode();
 String getCurrentTimeString();
 String getCurrentDateString();
 String getFullDateTimeString();
+enum ClockQuality { CLOCK_NONE, CLOCK_HOLDOVER, CLOCK_NTP };
+void restoreClockHoldover();
+bool isClockSynced();
+ClockQuality getClockQuality();
+const char* getClockQualityName();
+long getClockSyncAge();
+String getClockJson();
+time_t getClockEpoch();
+bool getClockTime(struct tm &timeinfo);
+typedef void (*NightModeCallback)(bool night);
+bool onNightModeChange(NightModeCallback callback);
+void invalidateClockSchedule();
+uint32_t getClockGeneration();
+long getSecondsToNightTransition();
 
 // SensorControl.cpp prototypes
 void setupTemperatureSensor();
@@ -139,6 +228,29 @@ String getSystemStatusJson();
 void setPumpManual(bool state);
 void setPumpAuto();
 void updateRuntime();
+void nightModeChanged(bool night);
+
+#if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+  // MqttManager.cpp prototypes
+  void setupMqtt();
+  void mqttLoop();
+  bool isMqttConnected();
+  String getMqttStatusJson();
+#endif
+
+// CropProfiles.cpp prototypes
+void setupCropProfiles();
+
+// Calendar.cpp prototypes
+void setupCalendar();
+void checkCalendar();
+const CalendarWindow* getActiveCalendarWindow();
+
+#if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+  // Webhook.cpp prototypes
+  void setupWebhook();
+  bool sendTestWebhook();
+#endif
 
 #ifdef ENABLE_FLOW_SENSOR
   // FlowSensor.cpp prototypes
@@ -151,7 +263,29 @@ void updateRuntime();
   void checkFlowRate();
   String getFlowStatusJson();
   void resetFlowCounter();
+  float getPumpCycleLiters();
   float calculatePulseFactor();    // Nieuwe functie voor dynamische pulsfactor berekening
+  
+  // FlowCalibration.cpp prototypes
+  void setupFlowCalibration();
+  float flowLitersPerPulse(float frequencyHz);
+  bool startFlowCalibration();
+  bool finishFlowCalibration(float volumeLiters, String &message);
+  void cancelFlowCalibration();
+  void clearFlowCalibration();
+  bool deleteFlowCalibrationPoint(int index);
+  String getFlowCalibrationJson();
+  
+  // FlowTotalizer.cpp prototypes
+  double getLifetimeLiters();
+  double getTodayLiters();
+  
+  // FlowAnomaly.cpp prototypes
+  uint8_t getFlowAnomalies();
+  void resetFlowAnomalyBaseline();
+  
+  // FlowRamp.cpp prototypes
+  String getFlowRampJson();
 #endif
 
 #if defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
@@ -160,9 +294,14 @@ void updateRuntime();
   extern unsigned long lastEmailSent;
   
   void setupEmailNotification();
-  bool sendFlowAlertEmail();
   bool sendTestEmail();
+  String getLastEmailError();
   String getEmailStatusJson();
+  void emailNotificationLoop();
+  
+  // EmailOutbox.cpp prototypes
+  void emailOutboxOnReconnect();
+  void processEmailOutbox();
 #endif
 
 #endif // SETTINGS_H
\ No newline at end of file
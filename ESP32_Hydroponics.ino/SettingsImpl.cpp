@@ -18,10 +18,11 @@
 *
  * SettingsImpl.cpp
  *
- * Implementatie van instellingenfuncties, inclusief laden/opslaan in EEPROM
+ * Implementatie van instellingenfuncties, inclusief laden/opslaan in NVS
  */
 
 #include "Settings.h"
+#include "SettingsStore.h"
 
 // WiFi instellingen - Wijzig deze naar jouw netwerkinstellingen
 const char* ssid = "JouwWiFiNaam";
@@ -39,26 +40,11 @@ const char* ntpServer = "time.google.com";
 // Centraal-Europese tijd met zomertijd
 const char* timezone = "CET-1CEST,M3.5.0,M10.5.0/3";
 
-// Initialiseer EEPROM en laad instellingen
+// Laad instellingen uit NVS
 void loadSettings() {
-  Serial.println("EEPROM initialiseren...");
-  EEPROM.begin(EEPROM_SIZE);
-  
-  // Lees instellingen van EEPROM
-  EEPROM.get(0, settings);
-  
-  // Controleer of opgeslagen waarden geldig zijn
-  if (settings.magic != EEPROM_MAGIC) {
-    Serial.println("Geen geldige instellingen gevonden in EEPROM, gebruik standaardwaarden");
-    
-    // Herstel naar standaardwaarden
-    settings = TempSettings();
-    
-    // Sla standaardwaarden op
-    saveSettings();
-  } else {
-    Serial.println("Instellingen geladen uit EEPROM");
-  }
+  Serial.println("Instellingen laden...");
+  settingsStoreLoad();
+  bool repaired = false;   // Hersteld in RAM, dus ook opslaan
   
   // Toon instellingen
   Serial.print("Systeemnaam: ");
@@ -87,12 +73,74 @@ void loadSettings() {
     Serial.println(" L/h");
     Serial.print("  Flow waarschuwingen: ");
     Serial.println(settings.flowAlertEnabled ? "Ingeschakeld" : "Uitgeschakeld");
+    
+    // Ongeldige volume-instellingen (beschadigd veld) terugzetten naar standaard
+    if (!(settings.temp_laag_liters > 0 && settings.temp_laag_liters < 1000) ||
+        !(settings.temp_midden_liters > 0 && settings.temp_midden_liters < 1000) ||
+        !(settings.temp_hoog_liters > 0 && settings.temp_hoog_liters < 1000) ||
+        !(settings.nacht_liters > 0 && settings.nacht_liters < 1000) ||
+        settings.volumeMaxAan < 10 || settings.volumeMaxAan > 3600) {
+      TempSettings defaults;
+      settings.volumeModus = false;
+      settings.temp_laag_liters = defaults.temp_laag_liters;
+      settings.temp_midden_liters = defaults.temp_midden_liters;
+      settings.temp_hoog_liters = defaults.temp_hoog_liters;
+      settings.nacht_liters = defaults.nacht_liters;
+      settings.volumeMaxAan = defaults.volumeMaxAan;
+      markSettingDirty(&settings.volumeModus);
+      markSettingDirty(&settings.temp_laag_liters);
+      markSettingDirty(&settings.temp_midden_liters);
+      markSettingDirty(&settings.temp_hoog_liters);
+      markSettingDirty(&settings.nacht_liters);
+      markSettingDirty(&settings.volumeMaxAan);
+      repaired = true;
+    }
+    
+    Serial.print("  Volume modus: ");
+    Serial.println(settings.volumeModus ? "Ingeschakeld" : "Uitgeschakeld");
   #endif
   
   #if defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
     Serial.println("E-mail notificaties ingeschakeld");
   #endif
   
+  #if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+    // Ongeldige URL (beschadigd veld): webhook uitschakelen
+    if (memchr(settings.webhookUrl, '\0', sizeof(settings.webhookUrl)) == NULL ||
+        (settings.webhookUrl[0] != '\0' && strncmp(settings.webhookUrl, "http", 4) != 0)) {
+      settings.webhookUrl[0] = '\0';
+      markSettingDirty(&settings.webhookUrl);
+      repaired = true;
+    }
+  #endif
+  
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    // Ongeldige MQTT-instellingen (beschadigd veld): standaardwaarden
+    if (memchr(settings.mqttHost, '\0', sizeof(settings.mqttHost)) == NULL ||
+        memchr(settings.mqttUser, '\0', sizeof(settings.mqttUser)) == NULL ||
+        memchr(settings.mqttPassword, '\0', sizeof(settings.mqttPassword)) == NULL ||
+        memchr(settings.mqttBaseTopic, '\0', sizeof(settings.mqttBaseTopic)) == NULL ||
+        settings.mqttBaseTopic[0] == '\0' || settings.mqttPort == 0 || settings.mqttPort == 0xFFFF) {
+      TempSettings defaults;
+      memcpy(settings.mqttHost, defaults.mqttHost, sizeof(settings.mqttHost));
+      settings.mqttPort = defaults.mqttPort;
+      memcpy(settings.mqttUser, defaults.mqttUser, sizeof(settings.mqttUser));
+      memcpy(settings.mqttPassword, defaults.mqttPassword, sizeof(settings.mqttPassword));
+      memcpy(settings.mqttBaseTopic, defaults.mqttBaseTopic, sizeof(settings.mqttBaseTopic));
+      settings.mqttDiscovery = defaults.mqttDiscovery;
+      markSettingDirty(&settings.mqttHost);
+      markSettingDirty(&settings.mqttPort);
+      markSettingDirty(&settings.mqttUser);
+      markSettingDirty(&settings.mqttPassword);
+      markSettingDirty(&settings.mqttBaseTopic);
+      markSettingDirty(&settings.mqttDiscovery);
+      repaired = true;
+    }
+    
+    Serial.print("MQTT broker: ");
+    Serial.println(strlen(settings.mqttHost) > 0 ? settings.mqttHost : "niet ingesteld");
+  #endif
+  
   #ifdef ENABLE_LED_CONTROL
     Serial.println("LED verlichting ingeschakeld:");
     Serial.print("  LED tijd: ");
@@ -107,22 +155,20 @@ void loadSettings() {
       Serial.println("  Lichtsensor ingeschakeld");
     #endif
   #endif
+  
+  if (repaired) {
+    Serial.println("Ongeldige instellingen hersteld naar standaardwaarden");
+    saveSettings();
+  }
 }
 
-// Sla instellingen op in EEPROM
+// Sla de gewijzigde instellingen op in NVS. De wijziging geldt direct in RAM;
+// het wegschrijven gebeurt vertraagd en gebundeld door settingsStoreLoop()
 void saveSettings() {
-  Serial.println("Instellingen opslaan in EEPROM...");
-  
   // Zorg ervoor dat de magic waarde correct is
   settings.magic = EEPROM_MAGIC;
   
-  // Schrijf struct naar EEPROM
-  EEPROM.put(0, settings);
-  
-  // Commit wijzigingen
-  EEPROM.commit();
-  
-  Serial.println("Instellingen opgeslagen");
+  settingsStoreRequestSave();
 }
 
 // Update systeemnaam
@@ -132,22 +178,24 @@ void updateSystemName(const char* newName) {
   
   // Zorg voor juiste null-terminatie
   settings.systeemnaam[sizeof(settings.systeemnaam) - 1] = '\0';
+  markSettingDirty(&settings.systeemnaam);
   
   Serial.print("Systeemnaam bijgewerkt naar: ");
   Serial.println(settings.systeemnaam);
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 
 // Update bedrijfsmodus (interval/continu)
 void updateOperatingMode(bool continuMode) {
   settings.continuModus = continuMode;
+  markSettingDirty(&settings.continuModus);
   
   Serial.print("Bedrijfsmodus bijgewerkt naar: ");
   Serial.println(continuMode ? "Continu (NFT/DFT)" : "Interval (Hydro Toren)");
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 
@@ -172,9 +220,20 @@ void updateTemperatureSettings(float lowThreshold, float highThreshold,
   settings.nacht_aan = nightOn;
   settings.nacht_uit = nightOff;
   
+  markSettingDirty(&settings.temp_laag_grens);
+  markSettingDirty(&settings.temp_hoog_grens);
+  markSettingDirty(&settings.temp_laag_aan);
+  markSettingDirty(&settings.temp_laag_uit);
+  markSettingDirty(&settings.temp_midden_aan);
+  markSettingDirty(&settings.temp_midden_uit);
+  markSettingDirty(&settings.temp_hoog_aan);
+  markSettingDirty(&settings.temp_hoog_uit);
+  markSettingDirty(&settings.nacht_aan);
+  markSettingDirty(&settings.nacht_uit);
+  
   Serial.println("Temperatuurinstellingen bijgewerkt");
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 
@@ -184,13 +243,16 @@ void updateFlowSettings(float minFlow, bool alertEnabled, int pumpCapacity) {
   settings.minFlowRate = minFlow;
   settings.flowAlertEnabled = alertEnabled;
   settings.pumpCapacityLPH = pumpCapacity;
+  markSettingDirty(&settings.minFlowRate);
+  markSettingDirty(&settings.flowAlertEnabled);
+  markSettingDirty(&settings.pumpCapacityLPH);
   
   Serial.println("Flowsensor instellingen bijgewerkt");
   Serial.print("  Nieuwe pomp capaciteit: ");
   Serial.print(pumpCapacity);
   Serial.println(" L/h");
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 #endif
@@ -207,10 +269,13 @@ void updateEmailSettings(const char* username, const char* password, const char*
   settings.emailUsername[sizeof(settings.emailUsername) - 1] = '\0';
   settings.emailPassword[sizeof(settings.emailPassword) - 1] = '\0';
   settings.emailRecipient[sizeof(settings.emailRecipient) - 1] = '\0';
+  markSettingDirty(&settings.emailUsername);
+  markSettingDirty(&settings.emailPassword);
+  markSettingDirty(&settings.emailRecipient);
   
   Serial.println("E-mail instellingen bijgewerkt");
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 #endif
@@ -229,7 +294,7 @@ void updateLEDSettings(int startHour, int endHour, int brightness, bool autoMode
   // Lichtsensor-specifieke instellingen worden hier niet bijgewerkt
   #endif
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 
@@ -243,7 +308,7 @@ void updateLEDSensorSettings(bool sensorMode, int minLux, int maxLux, int readIn
   
   Serial.println("LED lichtsensor instellingen bijgewerkt");
   
-  // Sla op in EEPROM
+  // Sla op in NVS
   saveSettings();
 }
 #endif
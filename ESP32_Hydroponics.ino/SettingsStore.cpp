@@ -0,0 +1,873 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * SettingsStore.cpp
+ *
+ * Opslag van de instellingen als losse sleutels in NVS. Voorheen werd bij
+ * elke wijziging de volledige TempSettings als één blok van EEPROM_SIZE bytes
+ * via de EEPROM-emulatie weggeschreven, ook als alleen de systeemnaam
+ * veranderde. Nu beschrijft een tabel elk veld met een eigen NVS sleutel;
+ * de code die een instelling wijzigt markeert het veld met
+ * markSettingDirty() en saveSettings() schrijft alleen de gemarkeerde
+ * velden.
+ *
+ * NVS schrijft elke sleutel atomair: na een stroomonderbreking staat er de
+ * oude of de nieuwe waarde, nooit een half geschreven veld. Velden die altijd
+ * samen moeten veranderen (de kalibratietabel) delen daarom één sleutel.
+ *
+ * Een header bevat de schemaversie, een volgnummer en een CRC32 over alle
+ * velden; hij wordt na de velden als laatste geschreven, afwisselend in
+ * slot A ("hdrA") en B ("hdrB"). Elk slot heeft een eigen CRC, zodat bij
+ * opstarten in één keer het nieuwste geldige slot gekozen wordt. De CRC
+ * gaat over wat in NVS staat (bijgehouden in storedSettings), niet over
+ * RAM: een wijziging die niet gemarkeerd is, komt niet in NVS en mag dus
+ * ook niet in de CRC. Zo'n wijziging wordt bij het opslaan wel gemeld.
+ *
+ * Een opslagactie is zo niet vanzelf atomair: een stroomonderbreking
+ * halverwege laat een mengsel van oude en nieuwe velden achter, en ook bij
+ * één veld past de header dan niet meer bij de velden. Daarom worden de
+ * nieuwe waarden eerst als één journaalrecord ("txn") met het volgende
+ * volgnummer geschreven; dat ene schrijven is het commit-moment. Vindt de
+ * loader een geldig journaal met volgnummer één hoger dan de nieuwste
+ * header, dan is de opslagactie onderbroken en worden de waarden uit het
+ * journaal opnieuw toegepast. Pas een CRC-fout zonder zo'n journaal is
+ * beschadiging. Er wordt niets teruggelezen ter controle; de kosten per
+ * opslagactie zijn het journaal, de gewijzigde velden en één header.
+ *
+ * Bij opstarten worden de geregistreerde migraties in volgorde uitgevoerd
+ * tot de huidige SETTINGS_SCHEMA_VERSION, beginnend bij de opgeslagen versie
+ * (0 = nog geen header in NVS):
+ *   0 -> 1  EEPROM-blok van de firmware vóór de NVS-opslag overnemen
+ * Een nieuwe migratie is een functie plus een regel in settingsMigrations[].
+ *
+ * saveSettings() schrijft niet direct: een reeks wijzigingen (een gebruiker
+ * die door de keuzelijsten klikt, een script dat meerdere verzoeken stuurt)
+ * wordt gebundeld tot één schrijfactie zodra het SETTINGS_FLUSH_QUIET_MS
+ * stil is, en uiterlijk SETTINGS_FLUSH_MAX_DELAY_MS na de eerste wijziging.
+ * Bij een herstart via esp_restart() wordt eerst alles weggeschreven. Bij
+ * een brownout kan dat niet meer (de flash is dan niet betrouwbaar te
+ * beschrijven); daar begrenst de maximale vertraging wat verloren gaat.
+ */
+
+#include "SettingsStore.h"
+#include <Preferences.h>
+#include <nvs.h>
+#include <esp_system.h>
+#include <rom/crc.h>
+#include <stddef.h>
+
+#define SETTINGS_HEADER_KEY_A "hdrA"      // Header slot A (even volgnummers)
+#define SETTINGS_HEADER_KEY_B "hdrB"      // Header slot B (oneven volgnummers)
+#define SETTINGS_JOURNAL_KEY "txn"        // Nieuwe waarden van de laatste opslagactie
+#define SETTINGS_MAX_STRING 128          // Langste tekstveld (webhookUrl)
+#define NVS_ENTRY_SIZE 32                 // Bytes per NVS entry
+#define NVS_ENTRIES_PER_PAGE 126          // Entries per flashpagina van 4 KB
+
+#define FIELD(key, member, kind) \
+  { key, offsetof(TempSettings, member), sizeof(((TempSettings*)0)->member), kind }
+#define FIELD_RANGE(key, first, last) \
+  { key, offsetof(TempSettings, first), \
+    offsetof(TempSettings, last) + sizeof(((TempSettings*)0)->last) - offsetof(TempSettings, first), FIELD_BLOB }
+
+// Alle opgeslagen velden. Nieuwe velden krijgen een nieuwe sleutel; een
+// ontbrekende sleutel laat de standaardwaarde uit TempSettings staan.
+static const SettingsField settingsFields[] = {
+  FIELD("tLaagAan", temp_laag_aan, FIELD_VALUE),
+  FIELD("tLaagUit", temp_laag_uit, FIELD_VALUE),
+  FIELD("tMidAan", temp_midden_aan, FIELD_VALUE),
+  FIELD("tMidUit", temp_midden_uit, FIELD_VALUE),
+  FIELD("tHoogAan", temp_hoog_aan, FIELD_VALUE),
+  FIELD("tHoogUit", temp_hoog_uit, FIELD_VALUE),
+  FIELD("nachtAan", nacht_aan, FIELD_VALUE),
+  FIELD("nachtUit", nacht_uit, FIELD_VALUE),
+  FIELD("tLaagGrens", temp_laag_grens, FIELD_VALUE),
+  FIELD("tHoogGrens", temp_hoog_grens, FIELD_VALUE),
+  FIELD("naam", systeemnaam, FIELD_STRING),
+  FIELD("continu", continuModus, FIELD_VALUE),
+  
+  #ifdef ENABLE_FLOW_SENSOR
+    FIELD("minFlow", minFlowRate, FIELD_VALUE),
+    FIELD("flowDebug", flowSensorDebug, FIELD_VALUE),
+    FIELD("flowAlert", flowAlertEnabled, FIELD_VALUE),
+    FIELD("pompLPH", pumpCapacityLPH, FIELD_VALUE),
+  #endif
+  
+  #if defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
+    FIELD("mailUser", emailUsername, FIELD_STRING),
+    FIELD("mailPass", emailPassword, FIELD_STRING),
+    FIELD("mailTo", emailRecipient, FIELD_STRING),
+    FIELD("mailDebug", emailDebug, FIELD_VALUE),
+  #endif
+  
+  #ifdef ENABLE_FLOW_SENSOR
+    FIELD_RANGE("flowCal", flowCalPoints, flowCalK),
+    FIELD("totInterval", totalizerIntervalMin, FIELD_VALUE),
+    FIELD("volModus", volumeModus, FIELD_VALUE),
+    FIELD("tLaagL", temp_laag_liters, FIELD_VALUE),
+    FIELD("tMidL", temp_midden_liters, FIELD_VALUE),
+    FIELD("tHoogL", temp_hoog_liters, FIELD_VALUE),
+    FIELD("nachtL", nacht_liters, FIELD_VALUE),
+    FIELD("volMaxAan", volumeMaxAan, FIELD_VALUE),
+  #endif
+  
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    FIELD("mqttHost", mqttHost, FIELD_STRING),
+    FIELD("mqttPort", mqttPort, FIELD_VALUE),
+    FIELD("mqttUser", mqttUser, FIELD_STRING),
+    FIELD("mqttPass", mqttPassword, FIELD_STRING),
+    FIELD("mqttBase", mqttBaseTopic, FIELD_STRING),
+    FIELD("mqttDisc", mqttDiscovery, FIELD_VALUE),
+  #endif
+  
+  #if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+    FIELD("webhookUrl", webhookUrl, FIELD_STRING),
+  #endif
+  
+  FIELD("profiel", activeProfile, FIELD_STRING),
+  FIELD_RANGE("kalender", calendarCount, calendar),
+};
+
+#define SETTINGS_FIELD_COUNT (sizeof(settingsFields) / sizeof(settingsFields[0]))
+static_assert(SETTINGS_FIELD_COUNT <= SETTINGS_MAX_FIELDS, "Te veel instellingen voor het dirty-masker");
+
+// Header zoals opgeslagen in slot A of B
+struct SettingsHeader {
+  uint16_t magic;          // EEPROM_MAGIC
+  uint16_t version;        // Schemaversie waarmee de velden geschreven zijn
+  uint32_t seq;            // Volgnummer van de opslagactie, hoogste is het nieuwst
+  uint32_t crc;            // CRC32 over sleutels en waarden van alle velden
+  uint32_t headerCrc;      // CRC32 over de velden hierboven
+};
+
+// Kop van het journaalrecord, gevolgd door per veld:
+// lengte sleutel (1 byte), sleutel, lengte waarde (2 bytes), waarde
+struct JournalHeader {
+  uint32_t seq;            // Volgnummer van de opslagactie waar het journaal bij hoort
+  uint16_t length;         // Aantal bytes na de kop
+  uint8_t count;           // Aantal velden
+  uint8_t version;         // Schemaversie
+  uint32_t crc;            // CRC32 over de kop (zonder dit veld) en de velden
+};
+
+#define SETTINGS_JOURNAL_SIZE (sizeof(JournalHeader) + sizeof(TempSettings) + SETTINGS_MAX_FIELDS * 18)
+
+// Migratie van schemaversie 'from' naar 'from + 1'
+struct SettingsMigration {
+  uint16_t from;
+  const char* description;
+  bool (*apply)();
+};
+
+static bool migrateLegacyEeprom();
+
+static const SettingsMigration settingsMigrations[] = {
+  { 0, "EEPROM-blok naar losse NVS sleutels", migrateLegacyEeprom },
+};
+
+static_assert(sizeof(settingsMigrations) / sizeof(settingsMigrations[0]) == SETTINGS_SCHEMA_VERSION,
+              "Elke schemaversie heeft precies één migratie nodig");
+
+Preferences settingsPrefs;
+static uint64_t dirtyFields = 0;          // Bit per veld in settingsFields
+static bool settingsStoreReady = false;
+static bool legacyImported = false;
+
+// Statistieken
+static unsigned long commitCount = 0;
+static unsigned long fieldsWritten = 0;
+static unsigned long entriesWritten = 0;  // Berekend uit de veldgroottes
+static unsigned long nvsEntriesUsed = 0;  // Gemeten via de vrije entries van de partitie
+static unsigned long pageErases = 0;      // Gemeten: vrije entries namen toe tijdens een commit
+static unsigned long writeErrors = 0;
+static int lastCommitFields = 0;
+static unsigned long lastCommitMs = 0;
+
+// Vertraagd opslaan
+static bool savePending = false;
+static unsigned long pendingSince = 0;    // Eerste niet-opgeslagen wijziging
+static unsigned long lastSaveRequest = 0; // Laatste aanroep van saveSettings()
+static unsigned long saveRequests = 0;
+static bool brownoutReset = false;
+
+// Schema
+static uint16_t storedSchemaVersion = 0;  // Versie zoals aangetroffen bij opstarten
+static int migrationsRun = 0;
+static bool crcOk = true;
+static unsigned long crcErrors = 0;
+
+// Header slots en journaal
+static uint32_t commitSeq = 0;            // Volgnummer van de laatst voltooide opslagactie
+static int activeHeaderSlot = -1;         // 0 = A, 1 = B, -1 = nog geen
+static unsigned long journalWrites = 0;
+static unsigned long journalReplays = 0;
+static uint8_t journalBuffer[SETTINGS_JOURNAL_SIZE];
+
+// Waarden zoals ze in NVS staan, voor de CRC in de header
+static TempSettings storedSettings;
+static unsigned long unmarkedChanges = 0; // Gewijzigd in RAM maar niet gemarkeerd bij een opslagactie
+
+// Aantal NVS entries dat een veld bij schrijven kost
+static unsigned long fieldEntries(const SettingsField &field) {
+  const uint8_t* data = (const uint8_t*)&settings + field.offset;
+  
+  switch (field.kind) {
+    case FIELD_VALUE:
+      return 1;
+    case FIELD_STRING:
+      return 1 + (strnlen((const char*)data, field.size) + 1 + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+    default:
+      // Blobs hebben naast de data ook een index entry
+      return 2 + (field.size + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+  }
+}
+
+// Gebruikte lengte van een veld: tekst alleen tot de afsluitende nul
+static size_t fieldLength(const SettingsField &field, const TempSettings &values) {
+  const uint8_t* data = (const uint8_t*)&values + field.offset;
+  return field.kind == FIELD_STRING ? strnlen((const char*)data, field.size) : field.size;
+}
+
+// CRC32 over sleutel en waarde van alle velden
+static uint32_t settingsCrc(const TempSettings &values) {
+  uint32_t crc = 0;
+  
+  for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+    const SettingsField &field = settingsFields[i];
+    
+    crc = crc32_le(crc, (const uint8_t*)field.key, strlen(field.key));
+    crc = crc32_le(crc, (const uint8_t*)&values + field.offset, fieldLength(field, values));
+  }
+  return crc;
+}
+
+// Wijkt het veld in RAM af van wat in NVS staat?
+static bool fieldChanged(const SettingsField &field) {
+  size_t length = fieldLength(field, settings);
+  return length != fieldLength(field, storedSettings) ||
+         memcmp((const uint8_t*)&settings + field.offset, (const uint8_t*)&storedSettings + field.offset, length) != 0;
+}
+
+// Veld is weggeschreven: NVS bevat nu de waarde uit RAM
+static void fieldStored(const SettingsField &field) {
+  uint8_t* data = (uint8_t*)&storedSettings + field.offset;
+  memcpy(data, (const uint8_t*)&settings + field.offset, field.size);
+  if (field.kind == FIELD_STRING) {
+    data[field.size - 1] = '\0';
+  }
+}
+
+// Vrije entries in de NVS partitie, 0 als onbekend
+static size_t nvsFreeEntries() {
+  nvs_stats_t stats;
+  if (nvs_get_stats(NULL, &stats) != 0) {
+    return 0;
+  }
+  return stats.free_entries;
+}
+
+// Lees één veld uit NVS, false als de sleutel ontbreekt of niet past
+static bool readField(const SettingsField &field) {
+  uint8_t* data = (uint8_t*)&settings + field.offset;
+  
+  if (!settingsPrefs.isKey(field.key)) {
+    return false;
+  }
+  
+  switch (field.kind) {
+    case FIELD_VALUE: {
+      uint32_t value = field.size == 1 ? settingsPrefs.getUChar(field.key)
+                     : field.size == 2 ? settingsPrefs.getUShort(field.key)
+                     : settingsPrefs.getUInt(field.key);
+      memcpy(data, &value, field.size);
+      return true;
+    }
+    case FIELD_STRING: {
+      char buffer[SETTINGS_MAX_STRING];
+      if (field.size > sizeof(buffer) || settingsPrefs.getString(field.key, buffer, field.size) == 0) {
+        return false;
+      }
+      buffer[field.size - 1] = '\0';
+      memcpy(data, buffer, field.size);
+      return true;
+    }
+    default:
+      if (settingsPrefs.getBytesLength(field.key) != field.size) {
+        return false;   // Andere indeling, standaardwaarde houden
+      }
+      return settingsPrefs.getBytes(field.key, data, field.size) == field.size;
+  }
+}
+
+// Schrijf één veld naar NVS
+static bool writeField(const SettingsField &field) {
+  const uint8_t* data = (const uint8_t*)&settings + field.offset;
+  
+  switch (field.kind) {
+    case FIELD_VALUE: {
+      uint32_t value = 0;
+      memcpy(&value, data, field.size);
+      if (field.size == 1) return settingsPrefs.putUChar(field.key, (uint8_t)value) == 1;
+      if (field.size == 2) return settingsPrefs.putUShort(field.key, (uint16_t)value) == 2;
+      return settingsPrefs.putUInt(field.key, value) == 4;
+    }
+    case FIELD_STRING: {
+      char buffer[SETTINGS_MAX_STRING];
+      if (field.size > sizeof(buffer)) {
+        return false;
+      }
+      memcpy(buffer, data, field.size);
+      buffer[field.size - 1] = '\0';
+      return settingsPrefs.putString(field.key, buffer) > 0 || buffer[0] == '\0';
+    }
+    default:
+      return settingsPrefs.putBytes(field.key, data, field.size) == field.size;
+  }
+}
+
+// Oude EEPROM-indeling zoals de firmware van vóór de NVS-opslag hem schreef.
+// De flowsensor- en e-mailvelden stonden er alleen in als die modules bij het
+// bouwen aan stonden; de EEPROM-emulatie vult ongebruikte bytes met nullen.
+struct LegacySettings {
+  uint16_t magic;
+  int temp_laag_aan;
+  int temp_laag_uit;
+  int temp_midden_aan;
+  int temp_midden_uit;
+  int temp_hoog_aan;
+  int temp_hoog_uit;
+  int nacht_aan;
+  int nacht_uit;
+  float temp_laag_grens;
+  float temp_hoog_grens;
+  char systeemnaam[32];
+  bool continuModus;
+  
+  // Alleen met ENABLE_FLOW_SENSOR
+  float minFlowRate;
+  bool flowSensorDebug;
+  bool flowAlertEnabled;
+  int pumpCapacityLPH;
+  
+  // Alleen met ENABLE_FLOW_SENSOR en ENABLE_EMAIL_NOTIFICATION
+  char emailUsername[64];
+  char emailPassword[64];
+  char emailRecipient[64];
+  bool emailDebug;
+};
+
+static_assert(sizeof(LegacySettings) <= EEPROM_SIZE, "Oude indeling past niet in de oude EEPROM");
+
+// Stond dit deel van de oude indeling in het EEPROM-beeld? Alles 0 = niet meegebouwd
+static bool legacyPresent(const void* data, size_t size) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++) {
+    if (bytes[i] != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void copyLegacyString(char* target, const char* source, size_t size) {
+  memcpy(target, source, size);
+  target[size - 1] = '\0';
+}
+
+// Migratie 0 -> 1: neem de instellingen over uit de oude EEPROM-indeling.
+// Veld voor veld, zodat een beeld van een build met andere modules de
+// velden niet verschuift; wat niet in het beeld stond houdt de standaardwaarde.
+static bool migrateLegacyEeprom() {
+  EEPROM.begin(EEPROM_SIZE);
+  
+  LegacySettings legacy;
+  EEPROM.get(0, legacy);
+  
+  settings = TempSettings();
+  
+  if (legacy.magic == EEPROM_MAGIC) {
+    settings.temp_laag_aan = legacy.temp_laag_aan;
+    settings.temp_laag_uit = legacy.temp_laag_uit;
+    settings.temp_midden_aan = legacy.temp_midden_aan;
+    settings.temp_midden_uit = legacy.temp_midden_uit;
+    settings.temp_hoog_aan = legacy.temp_hoog_aan;
+    settings.temp_hoog_uit = legacy.temp_hoog_uit;
+    settings.nacht_aan = legacy.nacht_aan;
+    settings.nacht_uit = legacy.nacht_uit;
+    settings.temp_laag_grens = legacy.temp_laag_grens;
+    settings.temp_hoog_grens = legacy.temp_hoog_grens;
+    copyLegacyString(settings.systeemnaam, legacy.systeemnaam, sizeof(settings.systeemnaam));
+    settings.continuModus = legacy.continuModus;
+    
+    size_t flowStart = offsetof(LegacySettings, minFlowRate);
+    size_t flowEnd = offsetof(LegacySettings, pumpCapacityLPH) + sizeof(legacy.pumpCapacityLPH);
+    size_t emailStart = offsetof(LegacySettings, emailUsername);
+    size_t emailEnd = offsetof(LegacySettings, emailDebug) + sizeof(legacy.emailDebug);
+    bool hasFlow = legacyPresent((const uint8_t*)&legacy + flowStart, flowEnd - flowStart);
+    bool hasEmail = hasFlow && legacyPresent((const uint8_t*)&legacy + emailStart, emailEnd - emailStart);
+    
+    #ifdef ENABLE_FLOW_SENSOR
+      if (hasFlow) {
+        settings.minFlowRate = legacy.minFlowRate;
+        settings.flowSensorDebug = legacy.flowSensorDebug;
+        settings.flowAlertEnabled = legacy.flowAlertEnabled;
+        settings.pumpCapacityLPH = legacy.pumpCapacityLPH;
+      }
+    #endif
+    
+    #if defined(ENABLE_FLOW_SENSOR) && defined(ENABLE_EMAIL_NOTIFICATION)
+      if (hasEmail) {
+        copyLegacyString(settings.emailUsername, legacy.emailUsername, sizeof(settings.emailUsername));
+        copyLegacyString(settings.emailPassword, legacy.emailPassword, sizeof(settings.emailPassword));
+        copyLegacyString(settings.emailRecipient, legacy.emailRecipient, sizeof(settings.emailRecipient));
+        settings.emailDebug = legacy.emailDebug;
+      }
+    #endif
+    
+    legacyImported = true;
+    Serial.println("Instellingen overgenomen uit de oude EEPROM-opslag");
+  } else {
+    Serial.println("Geen opgeslagen instellingen gevonden, gebruik standaardwaarden");
+  }
+  
+  // De EEPROM-buffer is niet meer nodig
+  EEPROM.end();
+  return true;
+}
+
+static uint32_t headerChecksum(const SettingsHeader &header) {
+  return crc32_le(0, (const uint8_t*)&header, offsetof(SettingsHeader, headerCrc));
+}
+
+// Kies het nieuwste geldige header slot; 0 als er nog geen is
+static uint16_t readSchemaVersion(SettingsHeader &active) {
+  const char* keys[2] = { SETTINGS_HEADER_KEY_A, SETTINGS_HEADER_KEY_B };
+  activeHeaderSlot = -1;
+  
+  for (int slot = 0; slot < 2; slot++) {
+    SettingsHeader header;
+    if (settingsPrefs.getBytesLength(keys[slot]) != sizeof(header) ||
+        settingsPrefs.getBytes(keys[slot], &header, sizeof(header)) != sizeof(header) ||
+        header.magic != EEPROM_MAGIC || header.headerCrc != headerChecksum(header)) {
+      continue;
+    }
+    if (activeHeaderSlot < 0 || header.seq > active.seq) {
+      active = header;
+      activeHeaderSlot = slot;
+    }
+  }
+  if (activeHeaderSlot < 0) {
+    return 0;
+  }
+  commitSeq = active.seq;
+  return active.version;
+}
+
+// Schrijf de header van opslagactie 'seq' in het bijbehorende slot
+static bool writeSettingsHeader(uint32_t seq) {
+  SettingsHeader header;
+  header.magic = EEPROM_MAGIC;
+  header.version = SETTINGS_SCHEMA_VERSION;
+  header.seq = seq;
+  header.crc = settingsCrc(storedSettings);
+  header.headerCrc = headerChecksum(header);
+  
+  int slot = seq & 1;
+  if (settingsPrefs.putBytes(slot ? SETTINGS_HEADER_KEY_B : SETTINGS_HEADER_KEY_A, &header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  activeHeaderSlot = slot;
+  entriesWritten += 2 + (sizeof(header) + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+  return true;
+}
+
+static uint32_t journalChecksum(const JournalHeader &header, const uint8_t* payload) {
+  uint32_t crc = crc32_le(0, (const uint8_t*)&header, offsetof(JournalHeader, crc));
+  return crc32_le(crc, payload, header.length);
+}
+
+// Schrijf de nieuwe waarden van alle gemarkeerde velden als één record
+static bool writeJournal(uint32_t seq) {
+  JournalHeader header;
+  uint8_t* payload = journalBuffer + sizeof(header);
+  size_t length = 0;
+  uint8_t count = 0;
+  
+  for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+    if (!(dirtyFields & ((uint64_t)1 << i))) {
+      continue;
+    }
+    
+    const SettingsField &field = settingsFields[i];
+    uint8_t keyLength = strlen(field.key);
+    uint16_t size = field.size;
+    
+    payload[length++] = keyLength;
+    memcpy(payload + length, field.key, keyLength);
+    length += keyLength;
+    memcpy(payload + length, &size, sizeof(size));
+    length += sizeof(size);
+    memcpy(payload + length, (const uint8_t*)&settings + field.offset, size);
+    length += size;
+    count++;
+  }
+  
+  header.seq = seq;
+  header.length = length;
+  header.count = count;
+  header.version = SETTINGS_SCHEMA_VERSION;
+  header.crc = journalChecksum(header, payload);
+  memcpy(journalBuffer, &header, sizeof(header));
+  
+  size_t total = sizeof(header) + length;
+  if (settingsPrefs.putBytes(SETTINGS_JOURNAL_KEY, journalBuffer, total) != total) {
+    return false;
+  }
+  journalWrites++;
+  entriesWritten += 2 + (total + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+  return true;
+}
+
+// Pas een journaal toe dat hoort bij een onderbroken opslagactie; true als dat gebeurde
+static bool replayJournal() {
+  size_t total = settingsPrefs.getBytesLength(SETTINGS_JOURNAL_KEY);
+  if (total < sizeof(JournalHeader) || total > sizeof(journalBuffer) ||
+      settingsPrefs.getBytes(SETTINGS_JOURNAL_KEY, journalBuffer, total) != total) {
+    return false;
+  }
+  
+  JournalHeader header;
+  memcpy(&header, journalBuffer, sizeof(header));
+  const uint8_t* payload = journalBuffer + sizeof(header);
+  
+  // Alleen het journaal van de opslagactie na de nieuwste header is nog niet voltooid
+  if (header.seq != commitSeq + 1 || header.version != SETTINGS_SCHEMA_VERSION ||
+      sizeof(header) + header.length != total || header.crc != journalChecksum(header, payload)) {
+    return false;
+  }
+  
+  size_t pos = 0;
+  for (uint8_t n = 0; n < header.count && pos < header.length; n++) {
+    uint8_t keyLength = payload[pos++];
+    char key[16];
+    uint16_t size;
+    if (keyLength >= sizeof(key) || pos + keyLength + sizeof(size) > header.length) {
+      break;
+    }
+    memcpy(key, payload + pos, keyLength);
+    key[keyLength] = '\0';
+    pos += keyLength;
+    memcpy(&size, payload + pos, sizeof(size));
+    pos += sizeof(size);
+    if (pos + size > header.length) {
+      break;
+    }
+    
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+      if (strcmp(settingsFields[i].key, key) == 0 && settingsFields[i].size == size) {
+        memcpy((uint8_t*)&settings + settingsFields[i].offset, payload + pos, size);
+        dirtyFields |= (uint64_t)1 << i;
+        break;
+      }
+    }
+    pos += size;
+  }
+  
+  journalReplays++;
+  return true;
+}
+
+// Laad alle velden en voer zo nodig migraties uit; false als er nog geen instellingen in NVS stonden
+bool settingsStoreLoad() {
+  if (!settingsPrefs.begin(SETTINGS_NAMESPACE, false)) {
+    Serial.println("FOUT: Kon NVS niet openen, gebruik standaardwaarden");
+    settings = TempSettings();
+    return false;
+  }
+  settingsStoreReady = true;
+  
+  // Niet-opgeslagen wijzigingen wegschrijven voordat esp_restart() herstart
+  esp_register_shutdown_handler(flushSettings);
+  
+  brownoutReset = esp_reset_reason() == ESP_RST_BROWNOUT;
+  if (brownoutReset) {
+    Serial.println("Herstart na brownout: wijzigingen van vlak daarvoor kunnen verloren zijn");
+  }
+  
+  SettingsHeader header = {0, 0, 0, 0, 0};
+  uint16_t version = readSchemaVersion(header);
+  storedSchemaVersion = version;
+  
+  // Velden met een bekende sleutel laden; ontbrekende houden hun standaardwaarde
+  int missing = 0;
+  if (version > 0) {
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+      if (!readField(settingsFields[i])) {
+        missing++;
+      }
+    }
+  }
+  dirtyFields = 0;
+  storedSettings = settings;
+  
+  if (version > SETTINGS_SCHEMA_VERSION) {
+    // Geschreven door nieuwere firmware: bekende velden gebruiken, onbekende negeren
+    Serial.print("Instellingen hebben een nieuwere schemaversie: ");
+    Serial.println(version);
+  }
+  
+  // Migraties in volgorde uitvoeren
+  while (version < SETTINGS_SCHEMA_VERSION) {
+    const SettingsMigration &migration = settingsMigrations[version];
+    
+    Serial.print("Instellingen migreren van versie ");
+    Serial.print(migration.from);
+    Serial.print(": ");
+    Serial.println(migration.description);
+    
+    if (!migration.apply()) {
+      Serial.println("FOUT: Migratie mislukt, gebruik standaardwaarden");
+      settings = TempSettings();
+    }
+    version++;
+    migrationsRun++;
+  }
+  
+  if (version != storedSchemaVersion) {
+    // Alles opnieuw wegschrijven in het huidige schema, header als laatste
+    markAllSettingsDirty();
+    settingsStoreCommit();
+    return storedSchemaVersion > 0 || legacyImported;
+  }
+  
+  // Onderbroken opslagactie: nieuwe waarden uit het journaal alsnog wegschrijven
+  if (storedSchemaVersion == SETTINGS_SCHEMA_VERSION && replayJournal()) {
+    Serial.println("Onderbroken opslag van instellingen hersteld uit het journaal");
+    settingsStoreCommit();
+  } else if (storedSchemaVersion == SETTINGS_SCHEMA_VERSION && header.crc != settingsCrc(storedSettings)) {
+    // Velden uit verschillende opslagacties zonder journaal: beschadiging
+    crcOk = false;
+    crcErrors++;
+    Serial.println("WAARSCHUWING: CRC van de instellingen klopt niet, velden worden gecontroleerd en opnieuw opgeslagen");
+    markAllSettingsDirty();
+    settingsStoreRequestSave();
+  }
+  
+  Serial.print("Instellingen geladen uit NVS, schema ");
+  Serial.print(storedSchemaVersion);
+  Serial.print(" (");
+  Serial.print(SETTINGS_FIELD_COUNT - missing);
+  Serial.print(" van ");
+  Serial.print(SETTINGS_FIELD_COUNT);
+  Serial.println(" velden)");
+  return true;
+}
+
+// Markeer het veld waar deze pointer (binnen settings) naar wijst als gewijzigd
+void markSettingDirty(const void* field) {
+  ptrdiff_t offset = (const uint8_t*)field - (const uint8_t*)&settings;
+  if (offset < 0 || offset >= (ptrdiff_t)sizeof(TempSettings)) {
+    return;
+  }
+  
+  for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+    if (offset >= settingsFields[i].offset && offset < settingsFields[i].offset + settingsFields[i].size) {
+      dirtyFields |= (uint64_t)1 << i;
+      return;
+    }
+  }
+}
+
+void markAllSettingsDirty() {
+  dirtyFields = SETTINGS_FIELD_COUNT == 64 ? ~(uint64_t)0 : (((uint64_t)1 << SETTINGS_FIELD_COUNT) - 1);
+}
+
+bool hasDirtySettings() {
+  return dirtyFields != 0;
+}
+
+// Schrijf alle gemarkeerde velden; geeft het aantal geschreven velden of -1 bij een fout
+int settingsStoreCommit() {
+  if (!settingsStoreReady) {
+    return -1;
+  }
+  if (dirtyFields == 0) {
+    return 0;
+  }
+  
+  unsigned long start = millis();
+  size_t freeBefore = nvsFreeEntries();
+  uint32_t seq = commitSeq + 1;
+  int written = 0;
+  bool failed = false;
+  
+  // Eerst het journaal, dat is het commit-moment. Ook bij één veld: zonder
+  // journaal ziet de volgende start na stroomuitval tussen veld en header
+  // een CRC-fout in plaats van een onderbroken opslagactie.
+  if (!writeJournal(seq)) {
+    writeErrors++;
+    Serial.println("FOUT: Kon journaal van de instellingen niet opslaan");
+    return -1;
+  }
+  
+  for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+    uint64_t bit = (uint64_t)1 << i;
+    if (!(dirtyFields & bit)) {
+      // Gewijzigd zonder markSettingDirty(): blijft alleen in RAM
+      if (fieldChanged(settingsFields[i])) {
+        unmarkedChanges++;
+        Serial.print("WAARSCHUWING: Instelling gewijzigd maar niet gemarkeerd: ");
+        Serial.println(settingsFields[i].key);
+      }
+      continue;
+    }
+    
+    if (writeField(settingsFields[i])) {
+      fieldStored(settingsFields[i]);
+      dirtyFields &= ~bit;
+      entriesWritten += fieldEntries(settingsFields[i]);
+      written++;
+    } else {
+      // Veld blijft gemarkeerd en wordt bij de volgende opslag opnieuw geprobeerd
+      failed = true;
+      writeErrors++;
+      Serial.print("FOUT: Kon instelling niet opslaan: ");
+      Serial.println(settingsFields[i].key);
+    }
+  }
+  
+  // Header als laatste, zodat een onderbroken migratie bij de volgende start opnieuw gebeurt
+  if (!failed) {
+    if (writeSettingsHeader(seq)) {
+      commitSeq = seq;
+      crcOk = true;
+    } else {
+      failed = true;
+      writeErrors++;
+      Serial.println("FOUT: Kon header van de instellingen niet opslaan");
+    }
+  }
+  
+  // Meting over de hele partitie: andere modules kunnen tegelijk schrijven
+  size_t freeAfter = nvsFreeEntries();
+  if (freeBefore > 0 && freeAfter > 0) {
+    if (freeAfter <= freeBefore) {
+      nvsEntriesUsed += freeBefore - freeAfter;
+    } else {
+      pageErases += (freeAfter - freeBefore + NVS_ENTRIES_PER_PAGE - 1) / NVS_ENTRIES_PER_PAGE;
+    }
+  }
+  
+  commitCount++;
+  fieldsWritten += written;
+  lastCommitFields = written;
+  lastCommitMs = millis() - start;
+  
+  Serial.print(written);
+  Serial.print(" instelling(en) opgeslagen in ");
+  Serial.print(lastCommitMs);
+  Serial.println(" ms");
+  
+  return failed ? -1 : written;
+}
+
+// Plan het opslaan van de gemarkeerde velden
+void settingsStoreRequestSave() {
+  if (!hasDirtySettings()) {
+    return;
+  }
+  
+  saveRequests++;
+  lastSaveRequest = millis();
+  if (!savePending) {
+    savePending = true;
+    pendingSince = lastSaveRequest;
+  }
+}
+
+// Schrijf na een stille periode of na de maximale vertraging (aanroepen vanuit loop())
+void settingsStoreLoop() {
+  if (!savePending) {
+    return;
+  }
+  
+  unsigned long now = millis();
+  if (now - lastSaveRequest >= SETTINGS_FLUSH_QUIET_MS || now - pendingSince >= SETTINGS_FLUSH_MAX_DELAY_MS) {
+    flushSettings();
+  }
+}
+
+// Schrijf openstaande wijzigingen direct weg
+void flushSettings() {
+  if (!hasDirtySettings()) {
+    savePending = false;
+    return;
+  }
+  
+  if (settingsStoreCommit() >= 0) {
+    savePending = false;
+  } else {
+    // Opnieuw proberen na de volgende stille periode
+    pendingSince = millis();
+    lastSaveRequest = pendingSince;
+  }
+}
+
+// Statistieken van de instellingen-opslag
+String getSettingsStoreJson() {
+  DynamicJsonDocument doc(768);
+  
+  int dirty = 0;
+  for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+    if (dirtyFields & ((uint64_t)1 << i)) {
+      dirty++;
+    }
+  }
+  
+  // Ter vergelijking: de oude EEPROM-emulatie schreef per opslag een blob van EEPROM_SIZE bytes
+  unsigned long legacyEntriesPerCommit = 2 + (EEPROM_SIZE + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+  
+  doc["fields"] = (int)SETTINGS_FIELD_COUNT;
+  doc["dirtyFields"] = dirty;
+  doc["pending"] = savePending;
+  doc["pendingMs"] = savePending ? millis() - pendingSince : 0;
+  doc["saveRequests"] = saveRequests;
+  doc["commits"] = commitCount;
+  doc["fieldsWritten"] = fieldsWritten;
+  doc["lastCommitFields"] = lastCommitFields;
+  doc["lastCommitMs"] = lastCommitMs;
+  doc["writeErrors"] = writeErrors;
+  doc["entriesWritten"] = entriesWritten;
+  doc["estimatedErases"] = (float)entriesWritten / NVS_ENTRIES_PER_PAGE;
+  doc["legacyEntriesPerCommit"] = legacyEntriesPerCommit;
+  doc["legacyEstimatedErases"] = (float)(commitCount * legacyEntriesPerCommit) / NVS_ENTRIES_PER_PAGE;
+  doc["nvsEntriesUsed"] = nvsEntriesUsed;
+  doc["nvsPageErases"] = pageErases;
+  doc["nvsFreeEntries"] = (unsigned long)nvsFreeEntries();
+  doc["schemaVersion"] = SETTINGS_SCHEMA_VERSION;
+  doc["storedSchemaVersion"] = storedSchemaVersion;
+  doc["migrationsRun"] = migrationsRun;
+  doc["crcOk"] = crcOk;
+  doc["crcErrors"] = crcErrors;
+  doc["unmarkedChanges"] = unmarkedChanges;
+  doc["commitSeq"] = commitSeq;
+  doc["activeHeader"] = activeHeaderSlot < 0 ? "-" : (activeHeaderSlot ? "B" : "A");
+  doc["journalWrites"] = journalWrites;
+  doc["journalReplays"] = journalReplays;
+  doc["legacyImported"] = legacyImported;
+  doc["brownoutReset"] = brownoutReset;
+  
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
@@ -0,0 +1,53 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * SettingsStore.h
+ *
+ * Header voor de opslag van instellingen als losse sleutels in NVS
+ */
+
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include "Settings.h"
+
+#define SETTINGS_NAMESPACE "settings"     // NVS namespace voor de instellingen
+#define SETTINGS_SCHEMA_VERSION 1         // Verhogen bij elke nieuwe migratie in SettingsStore.cpp
+#define SETTINGS_MAX_FIELDS 64            // Maximaal aantal velden (bits in het dirty-masker)
+#define SETTINGS_FLUSH_QUIET_MS 3000      // Opslaan na zoveel ms zonder nieuwe wijziging
+#define SETTINGS_FLUSH_MAX_DELAY_MS 15000 // Uiterlijk zoveel ms na de eerste wijziging opslaan
+
+// Hoe een veld in NVS wordt opgeslagen
+enum SettingsFieldKind : uint8_t {
+  FIELD_VALUE,    // Getal of bool van 1, 2 of 4 bytes (één NVS entry)
+  FIELD_STRING,   // C-string, alleen de gebruikte tekens worden geschreven
+  FIELD_BLOB      // Aaneengesloten reeks velden die altijd samen wijzigen
+};
+
+// Beschrijving van één opgeslagen veld binnen TempSettings
+struct SettingsField {
+  const char* key;          // NVS sleutel (maximaal 15 tekens)
+  uint16_t offset;          // Positie in TempSettings
+  uint16_t size;            // Aantal bytes
+  SettingsFieldKind kind;
+};
+
+// Functieprototypes
+bool settingsStoreLoad();
+int settingsStoreCommit();
+void settingsStoreRequestSave();
+void markAllSettingsDirty();
+String getSettingsStoreJson();
+
+#endif // SETTINGS_STORE_H
@@ -15,43 +15,437 @@
  * TimeManager.cpp
  *
  * Tijd synchronisatie via NTP en hulpfuncties voor tijdsbeheer
+ *
+ * getLocalTime() wacht tot 5 seconden zolang NTP nog niet gesynchroniseerd
+ * is, en isNightMode() en de tijdstrings worden vaak aangeroepen. Daarom
+ * houdt de klokdienst zelf de tijd bij: bij elke NTP-synchronisatie wordt het
+ * verschil tussen de epoch-tijd en de monotone esp_timer vastgelegd. De
+ * huidige tijd is dan één optelling; de opgesplitste lokale tijd (struct tm)
+ * wordt één keer per seconde berekend. Zonder synchronisatie geven de
+ * functies direct "niet beschikbaar" terug, zonder te wachten.
+ *
+ * De eerstvolgende overgang tussen dag en nacht wordt vooraf berekend als
+ * deadline op de monotone timer, opnieuw na elke synchronisatie of wijziging
+ * van de tijdzone (mktime houdt rekening met zomer- en wintertijd).
+ * isNightMode() is daardoor één vergelijking. Code die op de overgang moet
+ * reageren kan zich aanmelden met onNightModeChange() in plaats van te
+ * blijven controleren.
+ *
+ * Na een herstart (software, watchdog, crash) hoeft niet op WiFi en NTP
+ * gewacht te worden: de tijd wordt elke seconde in RTC geheugen bijgehouden
+ * dat een herstart overleeft, en bij opstarten direct teruggezet met
+ * kwaliteit "holdover". De eerste NTP-synchronisatie vervangt hem en meet
+ * hoe ver de herstelde tijd ernaast zat. Na een stroomonderbreking is het
+ * RTC geheugen leeg en wordt gewoon op NTP gewacht.
  */
 
 #include "Settings.h"
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <rom/crc.h>
+#include <sys/time.h>
+#include <stddef.h>
 
 // Externe variabelen uit SettingsImpl.cpp
 extern const char* ntpServer;
 extern const char* timezone;
 
-// Lokale variabelen
-bool timeInitialized = false;
-unsigned long lastNTPSync = 0;
-const unsigned long ntpResyncInterval = 86400000; // 24 uur
+#define CLOCK_VALID_EPOCH 1577836800  // 1-1-2020; een lagere systeemtijd is nog niet gesynchroniseerd
+#define CLOCK_HOLDOVER_MAGIC 0x484F4C45   // "HOLE", versie met drift
+#define CLOCK_HOLDOVER_SAVE_MS 1000       // Tijd in RTC geheugen bijwerken (kost alleen een geheugenschrijfactie)
+#define CLOCK_HOLDOVER_MAX_AGE 604800     // Niet herstellen als de laatste NTP-synchronisatie langer geleden is (7 dagen)
+
+// Synchronisatie en drift
+#define CLOCK_STEP_THRESHOLD_US 500000    // Grotere afwijking direct zetten, kleinere geleidelijk wegwerken
+#define CLOCK_SLEW_PPM 500                // Snelheid van het wegwerken (0,5 ms per seconde)
+#define CLOCK_MAX_DRIFT_PPB 500000        // Grotere gemeten drift is een meetfout (500 ppm)
+#define CLOCK_DRIFT_MIN_INTERVAL_US 600000000LL  // Drift pas meten over minimaal 10 minuten
+#define CLOCK_ERROR_BUDGET_MS 250         // Toegestane afwijking tussen twee synchronisaties
+#define CLOCK_MIN_ERROR_RATE_PPB 500      // Ondergrens voor de foutsnelheid (netwerkjitter)
+#define CLOCK_RESYNC_INITIAL_S 3600       // Eerste interval, zolang de drift nog onbekend is
+#define CLOCK_RESYNC_MIN_S 900            // Kortste interval (15 minuten)
+#define CLOCK_RESYNC_MAX_S 172800         // Langste interval (48 uur)
+#define CLOCK_RESYNC_RETRY_S 300          // Eerste herhaling na een mislukte synchronisatie
+#define CLOCK_SYNC_TIMEOUT_MS 30000       // Zonder antwoord binnen deze tijd is een poging mislukt
+#define CLOCK_HISTORY_SIZE 16             // Aantal bewaarde synchronisaties
+
+// Klokdienst. De tijd volgt uit de monotone timer t via
+//   epoch(t) = t + clockOffsetUs + drift * (t - clockBaseUs) + wegwerken van clockSlewUs
+static portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool clockSynced = false;
+static int64_t clockOffsetUs = 0;     // Epoch-tijd (µs) min esp_timer_get_time() bij clockBaseUs
+static int64_t clockBaseUs = 0;       // Timer bij het laatste ijkpunt
+static int32_t clockDriftPpb = 0;     // Gemeten afwijking van de timer ten opzichte van NTP
+static int64_t clockSlewUs = 0;       // Afwijking die vanaf clockBaseUs geleidelijk wordt weggewerkt
+static unsigned long clockSyncCount = 0;
+static time_t cachedSecond = 0;       // Seconde waarvoor cachedTime geldt
+static struct tm cachedTime;
+static volatile uint32_t clockGeneration = 0;  // Telt elke sprong van tijd of tijdzone
+static volatile ClockQuality clockQuality = CLOCK_NONE;
+static time_t lastNtpEpoch = 0;                // Laatste echte NTP-synchronisatie
+static int32_t holdoverErrorMs = 0;            // Afwijking van de herstelde tijd bij de eerste NTP-synchronisatie
+static bool holdoverErrorMeasured = false;
+
+// Meetpunt van de SNTP-taak, verwerkt in de hoofdlus
+static volatile bool syncSamplePending = false;
+static int64_t syncSampleTimerUs = 0;
+static int64_t syncSampleEpochUs = 0;
+
+// Vorige NTP-meting, voor de drift
+static int64_t lastSampleTimerUs = 0;
+static int64_t lastSampleEpochUs = 0;
+static bool driftKnown = false;
+static int32_t errorRatePpb = 0;       // Gemiddelde foutsnelheid van het model tussen synchronisaties
+
+// Planning van de synchronisaties
+static uint32_t resyncIntervalS = CLOCK_RESYNC_INITIAL_S;
+static unsigned long lastSyncMs = 0;     // millis() van de laatste geslaagde synchronisatie
+static unsigned long syncRequestMs = 0;  // millis() van de lopende poging
+static bool syncInFlight = false;
+static unsigned long syncAttempts = 0;
+static unsigned long syncFailures = 0;
+static int consecutiveFailures = 0;
+static uint16_t syncSuccessPermille = 1000;   // Voortschrijdend gemiddelde van geslaagde pogingen
+
+// Geschiedenis van synchronisaties
+struct ClockSyncRecord {
+  uint32_t epoch;          // Tijdstip van de synchronisatie
+  int32_t errorMs;         // Afwijking van de klok op dat moment
+  int32_t driftPpb;        // Drift na deze meting
+  uint32_t intervalS;      // Gekozen interval tot de volgende synchronisatie
+  bool stepped;            // Tijd direct gezet in plaats van geleidelijk
+};
+static ClockSyncRecord syncHistory[CLOCK_HISTORY_SIZE];
+static int syncHistoryHead = 0;
+static int syncHistoryCount = 0;
+
+// Tijd die een herstart overleeft (niet een stroomonderbreking)
+struct ClockHoldover {
+  uint32_t magic;
+  int64_t epochUs;          // Epoch-tijd bij het laatste bijwerken
+  int64_t lastNtpEpoch;     // Laatste echte NTP-synchronisatie
+  int32_t driftPpb;         // Gemeten drift, 0 als nog onbekend
+  uint32_t restores;        // Aantal herstarts sinds die synchronisatie
+  uint32_t crc;             // CRC32 over de velden hierboven
+};
+RTC_NOINIT_ATTR static ClockHoldover clockHoldover;
+static uint32_t holdoverRestores = 0;
+
+// Dag/nacht planning
+#define NIGHT_CALLBACK_SLOTS 4
+static bool nightScheduleValid = false;
+static bool nightModeActive = false;
+static int64_t nextNightTransitionUs = 0;   // Deadline op esp_timer_get_time()
+static time_t nextNightTransitionEpoch = 0;
+static NightModeCallback nightCallbacks[NIGHT_CALLBACK_SLOTS];
+static int nightCallbackCount = 0;
+
+// Deel van clockSlewUs dat op timerstand timerUs al is toegepast (binnen clockMux aanroepen)
+static int64_t clockSlewAt(int64_t timerUs) {
+  int64_t limit = (timerUs - clockBaseUs) * CLOCK_SLEW_PPM / 1000000LL;
+  return clockSlewUs >= 0 ? min(clockSlewUs, limit) : max(clockSlewUs, -limit);
+}
+
+// Epoch-tijd (µs) volgens het klokmodel op timerstand timerUs (binnen clockMux aanroepen)
+static int64_t clockEpochUsAt(int64_t timerUs) {
+  int64_t elapsed = timerUs - clockBaseUs;
+  return timerUs + clockOffsetUs + elapsed * clockDriftPpb / 1000000000LL + clockSlewAt(timerUs);
+}
+
+// Zet de tijd direct (eerste synchronisatie, herstel of grote afwijking)
+static void setClockOffset(int64_t epochUs, ClockQuality quality) {
+  int64_t now = esp_timer_get_time();
+  
+  portENTER_CRITICAL(&clockMux);
+  clockOffsetUs = epochUs - now;
+  clockBaseUs = now;
+  clockSlewUs = 0;
+  clockQuality = quality;
+  clockSynced = true;
+  cachedSecond = 0;
+  nightScheduleValid = false;
+  clockGeneration++;
+  portEXIT_CRITICAL(&clockMux);
+}
+
+// Aangeroepen vanuit de SNTP-taak na elke geslaagde synchronisatie; alleen het meetpunt vastleggen
+static void onTimeSync(struct timeval *tv) {
+  int64_t now = esp_timer_get_time();
+  
+  portENTER_CRITICAL(&clockMux);
+  syncSampleTimerUs = now;
+  syncSampleEpochUs = (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec;
+  syncSamplePending = true;
+  portEXIT_CRITICAL(&clockMux);
+}
+
+// Leg een synchronisatie vast in de geschiedenis
+static void recordSync(time_t epoch, int64_t errorUs, bool stepped) {
+  ClockSyncRecord &record = syncHistory[syncHistoryHead];
+  record.epoch = (uint32_t)epoch;
+  record.errorMs = (int32_t)constrain(errorUs / 1000, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+  record.driftPpb = clockDriftPpb;
+  record.intervalS = resyncIntervalS;
+  record.stepped = stepped;
+  
+  syncHistoryHead = (syncHistoryHead + 1) % CLOCK_HISTORY_SIZE;
+  if (syncHistoryCount < CLOCK_HISTORY_SIZE) {
+    syncHistoryCount++;
+  }
+}
+
+// Interval tot de volgende synchronisatie: zo lang dat de verwachte afwijking binnen
+// CLOCK_ERROR_BUDGET_MS blijft, korter als synchronisaties vaak mislukken
+static uint32_t nextResyncInterval() {
+  if (!driftKnown) {
+    return CLOCK_RESYNC_INITIAL_S;
+  }
+  
+  int32_t rate = max(errorRatePpb, (int32_t)CLOCK_MIN_ERROR_RATE_PPB);
+  uint64_t interval = (uint64_t)CLOCK_ERROR_BUDGET_MS * 1000000ULL / rate;
+  interval = interval * syncSuccessPermille / 1000;
+  
+  // Hooguit verdubbelen per stap, zodat één gunstige meting niet meteen 48 uur oplevert
+  interval = min(interval, (uint64_t)resyncIntervalS * 2);
+  return constrain((uint32_t)min(interval, (uint64_t)CLOCK_RESYNC_MAX_S), (uint32_t)CLOCK_RESYNC_MIN_S, (uint32_t)CLOCK_RESYNC_MAX_S);
+}
+
+// Verwerk een NTP-meting: drift bijwerken, afwijking wegwerken of de tijd zetten
+static void processTimeSample() {
+  portENTER_CRITICAL(&clockMux);
+  int64_t sampleTimer = syncSampleTimerUs;
+  int64_t sampleEpoch = syncSampleEpochUs;
+  syncSamplePending = false;
+  int64_t predicted = clockEpochUsAt(sampleTimer);
+  portEXIT_CRITICAL(&clockMux);
+  
+  int64_t errorUs = sampleEpoch - predicted;
+  bool firstSync = clockQuality != CLOCK_NTP;
+  
+  // Drift: verloop van (NTP-tijd - timer) tussen twee metingen
+  if (!firstSync && lastSampleTimerUs != 0) {
+    int64_t interval = sampleTimer - lastSampleTimerUs;
+    if (interval >= CLOCK_DRIFT_MIN_INTERVAL_US) {
+      int64_t offsetChange = (sampleEpoch - sampleTimer) - (lastSampleEpochUs - lastSampleTimerUs);
+      int64_t measured = offsetChange * 1000000000LL / interval;
+      int64_t rate = (errorUs < 0 ? -errorUs : errorUs) * 1000000000LL / interval;
+      
+      if (measured > -CLOCK_MAX_DRIFT_PPB && measured < CLOCK_MAX_DRIFT_PPB) {
+        portENTER_CRITICAL(&clockMux);
+        clockDriftPpb = driftKnown ? clockDriftPpb + (int32_t)((measured - clockDriftPpb) / 4) : (int32_t)measured;
+        portEXIT_CRITICAL(&clockMux);
+        errorRatePpb = driftKnown ? errorRatePpb + (int32_t)((min(rate, (int64_t)CLOCK_MAX_DRIFT_PPB) - errorRatePpb) / 4)
+                                  : (int32_t)min(rate, (int64_t)CLOCK_MAX_DRIFT_PPB);
+        driftKnown = true;
+      }
+    }
+  }
+  lastSampleTimerUs = sampleTimer;
+  lastSampleEpochUs = sampleEpoch;
+  
+  bool stepped = firstSync || errorUs > CLOCK_STEP_THRESHOLD_US || errorUs < -CLOCK_STEP_THRESHOLD_US;
+  if (stepped) {
+    if (clockQuality == CLOCK_HOLDOVER) {
+      holdoverErrorMs = (int32_t)(errorUs / 1000);
+      holdoverErrorMeasured = true;
+    }
+    setClockOffset(sampleEpoch + (esp_timer_get_time() - sampleTimer), CLOCK_NTP);
+  } else {
+    // Vanaf het meetpunt verder met de nieuwe drift; de afwijking verdwijnt geleidelijk
+    portENTER_CRITICAL(&clockMux);
+    clockOffsetUs = predicted - sampleTimer;
+    clockBaseUs = sampleTimer;
+    clockSlewUs = errorUs;
+    portEXIT_CRITICAL(&clockMux);
+  }
+  
+  portENTER_CRITICAL(&clockMux);
+  lastNtpEpoch = sampleEpoch / 1000000LL;
+  holdoverRestores = 0;
+  portEXIT_CRITICAL(&clockMux);
+  
+  clockSyncCount++;
+  syncInFlight = false;
+  consecutiveFailures = 0;
+  syncSuccessPermille += (1000 - syncSuccessPermille) / 4;
+  lastSyncMs = millis();
+  resyncIntervalS = nextResyncInterval();
+  recordSync(sampleEpoch / 1000000LL, errorUs, stepped);
+  
+  if (firstSync) {
+    Serial.println("Tijd succesvol gesynchroniseerd met NTP server");
+    if (holdoverErrorMeasured) {
+      Serial.print("Afwijking van de herstelde tijd: ");
+      Serial.print(holdoverErrorMs);
+      Serial.println(" ms");
+    }
+  } else {
+    Serial.print("NTP synchronisatie: afwijking ");
+    Serial.print((long)(errorUs / 1000));
+    Serial.print(" ms");
+    Serial.print(stepped ? " (gezet)" : " (wordt weggewerkt)");
+    Serial.print(", drift ");
+    Serial.print(clockDriftPpb / 1000.0, 2);
+    Serial.print(" ppm, volgende over ");
+    Serial.print(resyncIntervalS / 60);
+    Serial.println(" minuten");
+  }
+}
+
+// true zodra de tijd bekend is, via NTP of hersteld na een herstart
+bool isClockSynced() {
+  return clockSynced;
+}
+
+ClockQuality getClockQuality() {
+  return clockQuality;
+}
+
+const char* getClockQualityName() {
+  switch (clockQuality) {
+    case CLOCK_NTP: return "ntp";
+    case CLOCK_HOLDOVER: return "holdover";
+    default: return "geen";
+  }
+}
+
+// Seconden sinds de laatste echte NTP-synchronisatie (ook van voor een herstart), -1 als onbekend
+long getClockSyncAge() {
+  time_t now = getClockEpoch();
+  
+  portENTER_CRITICAL(&clockMux);
+  time_t synced = lastNtpEpoch;
+  portEXIT_CRITICAL(&clockMux);
+  
+  if (now == 0 || synced == 0) {
+    return -1;
+  }
+  return (long)(now - synced);
+}
+
+// Huidige tijd in RTC geheugen zetten; ook vlak voor esp_restart()
+static void saveClockHoldover() {
+  if (!clockSynced) {
+    return;
+  }
+  
+  portENTER_CRITICAL(&clockMux);
+  int64_t epochUs = clockEpochUsAt(esp_timer_get_time());
+  time_t synced = lastNtpEpoch;
+  int32_t drift = clockDriftPpb;
+  uint32_t restores = holdoverRestores;
+  portEXIT_CRITICAL(&clockMux);
+  
+  clockHoldover.magic = CLOCK_HOLDOVER_MAGIC;
+  clockHoldover.epochUs = epochUs;
+  clockHoldover.lastNtpEpoch = synced;
+  clockHoldover.driftPpb = drift;
+  clockHoldover.restores = restores;
+  clockHoldover.crc = crc32_le(0, (const uint8_t*)&clockHoldover, offsetof(ClockHoldover, crc));
+}
+
+// Zo vroeg mogelijk in setup(): tijdzone instellen en de tijd van voor de herstart terugzetten
+void restoreClockHoldover() {
+  setenv("TZ", timezone, 1);
+  tzset();
+  esp_register_shutdown_handler(saveClockHoldover);
+  
+  // Na stroomuitval of brownout bevat het RTC geheugen willekeurige data
+  esp_reset_reason_t reason = esp_reset_reason();
+  bool valid = reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT &&
+               clockHoldover.magic == CLOCK_HOLDOVER_MAGIC &&
+               clockHoldover.crc == crc32_le(0, (const uint8_t*)&clockHoldover, offsetof(ClockHoldover, crc)) &&
+               clockHoldover.epochUs / 1000000LL > CLOCK_VALID_EPOCH &&
+               clockHoldover.epochUs / 1000000LL - clockHoldover.lastNtpEpoch < CLOCK_HOLDOVER_MAX_AGE;
+  if (!valid) {
+    clockHoldover.magic = 0;
+    Serial.println("Geen tijd van voor de herstart beschikbaar, wachten op NTP");
+    return;
+  }
+  
+  // De opstarttijd telt de timer al mee; tussen het laatste bijwerken en de herstart zat hooguit een seconde
+  int64_t epochUs = clockHoldover.epochUs + esp_timer_get_time();
+  struct timeval tv;
+  tv.tv_sec = epochUs / 1000000LL;
+  tv.tv_usec = epochUs % 1000000LL;
+  settimeofday(&tv, NULL);
+  
+  setClockOffset(epochUs, CLOCK_HOLDOVER);
+  lastNtpEpoch = clockHoldover.lastNtpEpoch;
+  holdoverRestores = clockHoldover.restores + 1;
+  
+  // Gemeten drift blijft gelden, de timer is dezelfde
+  if (clockHoldover.driftPpb > -CLOCK_MAX_DRIFT_PPB && clockHoldover.driftPpb < CLOCK_MAX_DRIFT_PPB) {
+    clockDriftPpb = clockHoldover.driftPpb;
+  }
+  
+  Serial.print("Tijd hersteld van voor de herstart: ");
+  Serial.print(getFullDateTimeString());
+  Serial.print(" (laatste NTP-synchronisatie ");
+  Serial.print(getClockSyncAge() / 60);
+  Serial.println(" minuten geleden)");
+}
+
+// Huidige epoch-tijd in seconden, 0 als de tijd nog niet bekend is (wacht nooit)
+time_t getClockEpoch() {
+  if (!clockSynced) {
+    return 0;
+  }
+  
+  portENTER_CRITICAL(&clockMux);
+  int64_t epochUs = clockEpochUsAt(esp_timer_get_time());
+  portEXIT_CRITICAL(&clockMux);
+  
+  return (time_t)(epochUs / 1000000LL);
+}
+
+// Lokale tijd, per seconde gecachet (alleen vanuit de hoofdlus aanroepen)
+bool getClockTime(struct tm &timeinfo) {
+  time_t now = getClockEpoch();
+  if (now == 0) {
+    return false;
+  }
+  
+  if (now != cachedSecond) {
+    localtime_r(&now, &cachedTime);
+    cachedSecond = now;
+  }
+  timeinfo = cachedTime;
+  return true;
+}
 
 // Configureer tijd synchronisatie
 void setupTime() {
   Serial.println("Tijd synchronisatie instellen...");
   
+  // Melding bij elke synchronisatie, vóór het starten van SNTP
+  sntp_set_time_sync_notification_cb(onTimeSync);
+  
+  // Na de eerste synchronisatie bepaalt checkTimeSync() wanneer er opnieuw gesynchroniseerd wordt
+  sntp_set_sync_interval(CLOCK_RESYNC_MAX_S * 1000UL);
+  
   // Configureer tijd met NTP
   configTime(0, 0, ntpServer);
   setenv("TZ", timezone, 1);
   tzset();
+  invalidateClockSchedule();
   
-  // Probeer direct te synchroniseren
-  if (updateLocalTime()) {
-    lastNTPSync = millis();
-  }
+  // Toon de tijd als die al bekend is
+  updateLocalTime();
 }
 
-// Update lokale tijd via NTP
+// Controleer of de tijd bekend is en toon hem (wacht niet op NTP)
 bool updateLocalTime() {
-  if (WiFi.status() != WL_CONNECTED) {
-    return false;
+  // De systeemtijd kan al gezet zijn voordat de melding geregistreerd was
+  if (!clockSynced && time(nullptr) > CLOCK_VALID_EPOCH) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    setClockOffset((int64_t)tv.tv_sec * 1000000LL + tv.tv_usec, CLOCK_HOLDOVER);
   }
   
   struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    Serial.println("Kan lokale tijd niet ophalen");
+  if (!getClockTime(timeinfo)) {
     return false;
   }
   
@@ -63,43 +457,214 @@ bool updateLocalTime() {
   return true;
 }
 
-// Controleer en hersynchroniseer tijd indien nodig
+// Verwerk NTP-metingen en plan de volgende synchronisatie
 void checkTimeSync() {
-  // Alleen resynchroniseren als er WiFi is
-  if (WiFi.status() != WL_CONNECTED) {
+  if (syncSamplePending) {
+    processTimeSample();
+  }
+  
+  // Dag/nacht overgang bewaken, ook zonder WiFi
+  isNightMode();
+  
+  // Tijd bijhouden voor na een herstart
+  static unsigned long lastHoldoverSave = 0;
+  if (millis() - lastHoldoverSave >= CLOCK_HOLDOVER_SAVE_MS) {
+    saveClockHoldover();
+    lastHoldoverSave = millis();
+  }
+  
+  // Tot de eerste synchronisatie probeert SNTP het zelf opnieuw
+  if (clockQuality != CLOCK_NTP) {
     return;
   }
   
-  // Als tijd nog niet is geïnitialiseerd of het is tijd voor resync
-  if (!timeInitialized || millis() - lastNTPSync > ntpResyncInterval) {
-    Serial.println("NTP tijd (her)synchroniseren...");
-    
-    if (updateLocalTime()) {
-      lastNTPSync = millis();
-      timeInitialized = true; // BELANGRIJK: Zet deze op true
-      Serial.println("Tijd succesvol gesynchroniseerd met NTP server");
+  if (syncInFlight) {
+    if (millis() - syncRequestMs > CLOCK_SYNC_TIMEOUT_MS) {
+      syncInFlight = false;
+      syncFailures++;
+      consecutiveFailures++;
+      syncSuccessPermille -= syncSuccessPermille / 4;
+      Serial.println("NTP synchronisatie mislukt, later opnieuw");
     }
+    return;
+  }
+  
+  // Na een mislukte poging sneller opnieuw (5, 10, 20 ... minuten), anders na het interval
+  bool due;
+  if (consecutiveFailures > 0) {
+    uint32_t retryS = min((uint32_t)CLOCK_RESYNC_RETRY_S << min(consecutiveFailures - 1, 4), resyncIntervalS);
+    due = millis() - syncRequestMs >= retryS * 1000UL;
+  } else {
+    due = millis() - lastSyncMs >= resyncIntervalS * 1000UL;
   }
+  
+  // Alleen resynchroniseren als er WiFi is
+  if (!due || WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  
+  Serial.println("NTP tijd hersynchroniseren...");
+  sntp_restart();
+  syncRequestMs = millis();
+  syncInFlight = true;
+  syncAttempts++;
 }
 
-// Controleer of we in nachtmodus zijn
-bool isNightMode() {
-  struct tm timeinfo;
+// Drift, planning en geschiedenis van de synchronisaties
+String getClockJson() {
+  DynamicJsonDocument doc(3072);
   
-  // Standaard geen nachtmodus als we tijd niet kunnen ophalen
-  if (!getLocalTime(&timeinfo)) {
-    return false;
+  int64_t timerNow = esp_timer_get_time();
+  portENTER_CRITICAL(&clockMux);
+  int64_t slewLeft = clockSlewUs - clockSlewAt(timerNow);
+  int32_t drift = clockDriftPpb;
+  portEXIT_CRITICAL(&clockMux);
+  
+  doc["quality"] = getClockQualityName();
+  doc["time"] = getFullDateTimeString();
+  doc["syncAge"] = getClockSyncAge();
+  doc["driftPpm"] = drift / 1000.0;
+  doc["driftKnown"] = driftKnown;
+  doc["errorRatePpm"] = errorRatePpb / 1000.0;
+  doc["slewRemainingMs"] = (long)(slewLeft / 1000);
+  doc["interval"] = resyncIntervalS;
+  
+  long nextIn = -1;
+  if (clockQuality == CLOCK_NTP && !syncInFlight) {
+    nextIn = (long)resyncIntervalS - (long)((millis() - lastSyncMs) / 1000);
+  }
+  doc["nextSyncIn"] = nextIn;
+  doc["syncs"] = clockSyncCount;
+  doc["attempts"] = syncAttempts;
+  doc["failures"] = syncFailures;
+  doc["successRate"] = syncSuccessPermille / 1000.0;
+  if (holdoverErrorMeasured) {
+    doc["holdoverErrorMs"] = holdoverErrorMs;
   }
   
-  int currentHour = timeinfo.tm_hour;
+  // Nieuwste eerst
+  JsonArray history = doc.createNestedArray("history");
+  for (int i = 0; i < syncHistoryCount; i++) {
+    const ClockSyncRecord &record = syncHistory[(syncHistoryHead - 1 - i + CLOCK_HISTORY_SIZE) % CLOCK_HISTORY_SIZE];
+    JsonObject item = history.createNestedObject();
+    item["time"] = record.epoch;
+    item["errorMs"] = record.errorMs;
+    item["driftPpm"] = record.driftPpb / 1000.0;
+    item["interval"] = record.intervalS;
+    item["stepped"] = record.stepped;
+  }
   
-  // Controleer of het huidige uur binnen nachtmodus valt
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
+
+// Nacht volgens de vaste uren in Settings.h
+static bool isNightHour(int hour) {
   // Als NACHT_START_UUR > NACHT_EIND_UUR, dan is het een periode die middernacht overschrijdt
   if (NACHT_START_UUR > NACHT_EIND_UUR) {
-    return (currentHour >= NACHT_START_UUR || currentHour < NACHT_EIND_UUR);
+    return (hour >= NACHT_START_UUR || hour < NACHT_EIND_UUR);
   } else {
-    return (currentHour >= NACHT_START_UUR && currentHour < NACHT_EIND_UUR);
+    return (hour >= NACHT_START_UUR && hour < NACHT_EIND_UUR);
+  }
+}
+
+// Eerstvolgend tijdstip na 'now' waarop het lokaal 'hour':00 is
+static time_t nextLocalHour(time_t now, const struct tm &local, int hour) {
+  struct tm candidate = local;
+  candidate.tm_hour = hour;
+  candidate.tm_min = 0;
+  candidate.tm_sec = 0;
+  candidate.tm_isdst = -1;   // mktime bepaalt zelf zomer- of wintertijd
+  
+  time_t t = mktime(&candidate);
+  if (t <= now) {
+    candidate = local;
+    candidate.tm_mday += 1;  // mktime normaliseert de maandgrens
+    candidate.tm_hour = hour;
+    candidate.tm_min = 0;
+    candidate.tm_sec = 0;
+    candidate.tm_isdst = -1;
+    t = mktime(&candidate);
+  }
+  return t;
+}
+
+// Bepaal de huidige stand en de volgende overgang; meld een wissel aan de callbacks
+static void updateNightSchedule() {
+  struct tm local;
+  if (!getClockTime(local)) {
+    nightScheduleValid = false;
+    return;
+  }
+  
+  time_t now = getClockEpoch();
+  bool night = isNightHour(local.tm_hour);
+  time_t next = nextLocalHour(now, local, night ? NACHT_EIND_UUR : NACHT_START_UUR);
+  
+  // Drift en wegwerken verschuiven de deadline hooguit milliseconden; daarna wordt opnieuw gekeken
+  int64_t timerNow = esp_timer_get_time();
+  portENTER_CRITICAL(&clockMux);
+  int64_t offset = clockEpochUsAt(timerNow) - timerNow;
+  portEXIT_CRITICAL(&clockMux);
+  
+  bool changed = nightScheduleValid && night != nightModeActive;
+  nightModeActive = night;
+  nextNightTransitionEpoch = next;
+  nextNightTransitionUs = (int64_t)next * 1000000LL - offset;
+  nightScheduleValid = true;
+  
+  if (changed) {
+    Serial.println(night ? "Overgang naar nacht" : "Overgang naar dag");
+    for (int i = 0; i < nightCallbackCount; i++) {
+      nightCallbacks[i](night);
+    }
+  }
+}
+
+// Na een wijziging van tijd of tijdzone de planning opnieuw berekenen
+void invalidateClockSchedule() {
+  portENTER_CRITICAL(&clockMux);
+  cachedSecond = 0;
+  nightScheduleValid = false;
+  clockGeneration++;
+  portEXIT_CRITICAL(&clockMux);
+}
+
+// Verandert na elke synchronisatie of tijdzonewijziging; wie deadlines in
+// epoch-tijd bewaart berekent ze opnieuw als deze waarde anders is
+uint32_t getClockGeneration() {
+  return clockGeneration;
+}
+
+// Meld een functie aan die bij elke dag/nacht overgang wordt aangeroepen (vanuit de hoofdlus)
+bool onNightModeChange(NightModeCallback callback) {
+  if (nightCallbackCount >= NIGHT_CALLBACK_SLOTS) {
+    return false;
+  }
+  nightCallbacks[nightCallbackCount++] = callback;
+  return true;
+}
+
+// Controleer of we in nachtmodus zijn
+bool isNightMode() {
+  // Standaard geen nachtmodus als de tijd nog niet bekend is
+  if (!clockSynced) {
+    return false;
+  }
+  
+  if (!nightScheduleValid || esp_timer_get_time() >= nextNightTransitionUs) {
+    updateNightSchedule();
+  }
+  return nightModeActive;
+}
+
+// Seconden tot de volgende dag/nacht overgang, -1 als onbekend
+long getSecondsToNightTransition() {
+  if (!isClockSynced() || !nightScheduleValid) {
+    return -1;
   }
+  return (long)(nextNightTransitionEpoch - getClockEpoch());
 }
 
 // Haal huidige tijd op als geformatteerde string
@@ -107,7 +672,7 @@ String getCurrentTimeString() {
   struct tm timeinfo;
   char timeBuffer[30];
   
-  if (getLocalTime(&timeinfo)) {
+  if (getClockTime(timeinfo)) {
     strftime(timeBuffer, 30, "%H:%M:%S", &timeinfo);
     return String(timeBuffer);
   } else {
@@ -120,7 +685,7 @@ String getCurrentDateString() {
   struct tm timeinfo;
   char dateBuffer[30];
   
-  if (getLocalTime(&timeinfo)) {
+  if (getClockTime(timeinfo)) {
     strftime(dateBuffer, 30, "%d-%m-%Y", &timeinfo);
     return String(dateBuffer);
   } else {
@@ -133,7 +698,7 @@ String getFullDateTimeString() {
   struct tm timeinfo;
   char buffer[50];
   
-  if (getLocalTime(&timeinfo)) {
+  if (getClockTime(timeinfo)) {
     strftime(buffer, 50, "%d-%m-%Y %H:%M:%S", &timeinfo);
     return String(buffer);
   } else {
@@ -145,7 +710,7 @@ String getFullDateTimeString() {
 bool isDaylightSavingActive() {
   struct tm timeinfo;
   
-  if (!getLocalTime(&timeinfo)) {
+  if (!getClockTime(timeinfo)) {
     return false;
   }
   
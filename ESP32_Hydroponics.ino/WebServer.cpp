@@ -19,6 +19,10 @@
 
 #include "Settings.h"
 #include "WebUI.h"
+#include "Notification.h"
+#include "SettingsStore.h"
+#include "CropProfiles.h"
+#include "Calendar.h"
 
 // Webserver instance
 WebServer server(80);
@@ -30,18 +34,46 @@ void handleGetSettings();
 void handlePostSettings();
 void handlePostOverride();
 void handleGetConfig();
+void handleGetNotifications();
+void handleGetStorage();
+void handleGetProfiles();
+void handlePostProfile();
+void handleActivateProfile();
+void handleDeleteProfile();
+void handleCorsPreflight();
+void handleGetCalendar();
+void handleGetTime();
+void handleGetWiFi();
+void handlePostCalendar();
 
 #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
   void handleGetFlowStatus();
   void handleGetFlowSettings();
   void handlePostFlowSettings();
   void handleResetFlow();
+  void handleResetFlowBaseline();
+  void handleGetFlowRamp();
+  void handleGetFlowCalibration();
+  void handlePostFlowCalibration();
   
   #ifdef ENABLE_EMAIL_NOTIFICATION
     void handleTestEmail();
+    void handleGetEmailStatus();
   #endif
 #endif
 
+#if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+  void handleGetWebhookSettings();
+  void handlePostWebhookSettings();
+  void handleTestWebhook();
+#endif
+
+#if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+  void handleGetMqttSettings();
+  void handlePostMqttSettings();
+  void handleGetMqttStatus();
+#endif
+
 // Hulpfuncties
 String secondsToTimeString(unsigned long seconds);
 String getWiFiSignalStrength();
@@ -58,6 +90,18 @@ void setupWebServer() {
   server.on("/api/settings", HTTP_POST, handlePostSettings);
   server.on("/api/override", HTTP_POST, handlePostOverride);
   server.on("/api/config", HTTP_GET, handleGetConfig);
+  server.on("/api/notifications", HTTP_GET, handleGetNotifications);
+  server.on("/api/storage", HTTP_GET, handleGetStorage);
+  server.on("/api/profiles", HTTP_GET, handleGetProfiles);
+  server.on("/api/profiles", HTTP_POST, handlePostProfile);
+  server.on("/api/profiles", HTTP_OPTIONS, handleCorsPreflight);
+  server.on("/api/profiles/activate", HTTP_POST, handleActivateProfile);
+  server.on("/api/profiles/activate", HTTP_OPTIONS, handleCorsPreflight);
+  server.on("/api/profiles/delete", HTTP_POST, handleDeleteProfile);
+  server.on("/api/calendar", HTTP_GET, handleGetCalendar);
+  server.on("/api/calendar", HTTP_POST, handlePostCalendar);
+  server.on("/api/time", HTTP_GET, handleGetTime);
+  server.on("/api/wifi", HTTP_GET, handleGetWiFi);
   
   // Optionele modules API endpoints
   #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
@@ -65,12 +109,29 @@ void setupWebServer() {
     server.on("/api/flowsettings", HTTP_GET, handleGetFlowSettings);
     server.on("/api/flowsettings", HTTP_POST, handlePostFlowSettings);
     server.on("/api/resetflow", HTTP_POST, handleResetFlow);
+    server.on("/api/resetflowbaseline", HTTP_POST, handleResetFlowBaseline);
+    server.on("/api/flowramp", HTTP_GET, handleGetFlowRamp);
+    server.on("/api/flowcalibration", HTTP_GET, handleGetFlowCalibration);
+    server.on("/api/flowcalibration", HTTP_POST, handlePostFlowCalibration);
     
     #if defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
       server.on("/api/testemail", HTTP_POST, handleTestEmail);
+      server.on("/api/emailstatus", HTTP_GET, handleGetEmailStatus);
     #endif
   #endif
   
+  #if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+    server.on("/api/webhooksettings", HTTP_GET, handleGetWebhookSettings);
+    server.on("/api/webhooksettings", HTTP_POST, handlePostWebhookSettings);
+    server.on("/api/testwebhook", HTTP_POST, handleTestWebhook);
+  #endif
+  
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    server.on("/api/mqttsettings", HTTP_GET, handleGetMqttSettings);
+    server.on("/api/mqttsettings", HTTP_POST, handlePostMqttSettings);
+    server.on("/api/mqttstatus", HTTP_GET, handleGetMqttStatus);
+  #endif
+  
   // Start webserver
   server.begin();
   Serial.println("HTTP server gestart");
@@ -104,11 +165,219 @@ void handleGetConfig() {
   #else
     doc["email_notification_enabled"] = false;
   #endif
+  
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    doc["mqtt_enabled"] = true;
+  #else
+    doc["mqtt_enabled"] = false;
+  #endif
   String response;
   serializeJson(doc, response);
   server.send(200, "application/json", response);
 }
 
+// Status van alle meldingskanalen ophalen
+void handleGetNotifications() {
+  server.send(200, "application/json", getNotificationStatusJson());
+}
+
+// Statistieken van de instellingen-opslag ophalen
+void handleGetStorage() {
+  server.send(200, "application/json", getSettingsStoreJson());
+}
+
+// Het master dashboard (ESP32Hydro.html) draait op een andere origin
+void sendCorsHeaders() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+  server.sendHeader("Access-Control-Allow-Headers", "Content-Type");
+}
+
+void handleCorsPreflight() {
+  sendCorsHeaders();
+  server.send(204);
+}
+
+// Lijst van gewasprofielen ophalen
+void handleGetProfiles() {
+  sendCorsHeaders();
+  server.send(200, "application/json", getCropProfilesJson());
+}
+
+// Gewasprofiel opslaan; ontbrekende waarden komen uit het bestaande profiel of de huidige instellingen
+void handlePostProfile() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  String jsonStr = server.arg("plain");
+  DynamicJsonDocument doc(512);
+  
+  // Probeer JSON te parsen
+  DeserializationError error = deserializeJson(doc, jsonStr);
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  const char* name = doc["name"];
+  if (name == NULL || strlen(name) == 0 || strlen(name) >= CROP_PROFILE_NAME_LEN) {
+    server.send(400, "text/plain", "Profielnaam ontbreekt of is te lang");
+    return;
+  }
+  
+  CropProfile profile;
+  if (!getCropProfile(name, profile)) {
+    cropProfileFromSettings(profile);
+  }
+  strcpy(profile.name, name);
+  
+  if (doc.containsKey("temp_laag_grens")) {
+    profile.temp_laag_grens = doc["temp_laag_grens"];
+  }
+  if (doc.containsKey("temp_hoog_grens")) {
+    profile.temp_hoog_grens = doc["temp_hoog_grens"];
+  }
+  
+  // Cyclustijden in seconden, maximaal 65535 (ruim 18 uur)
+  const char* timeKeys[] = {"temp_laag_aan", "temp_laag_uit", "temp_midden_aan", "temp_midden_uit",
+                            "temp_hoog_aan", "temp_hoog_uit", "nacht_aan", "nacht_uit"};
+  uint16_t* timeFields[] = {&profile.temp_laag_aan, &profile.temp_laag_uit, &profile.temp_midden_aan,
+                            &profile.temp_midden_uit, &profile.temp_hoog_aan, &profile.temp_hoog_uit,
+                            &profile.nacht_aan, &profile.nacht_uit};
+  for (int i = 0; i < 8; i++) {
+    if (doc.containsKey(timeKeys[i])) {
+      long seconds = doc[timeKeys[i]];
+      if (seconds < 0 || seconds > 65535) {
+        server.send(400, "text/plain", String("Ongeldige waarde voor ") + timeKeys[i]);
+        return;
+      }
+      *timeFields[i] = seconds;
+    }
+  }
+  
+  String validationError;
+  if (!validateCropProfile(profile, validationError)) {
+    server.send(400, "text/plain", validationError);
+    return;
+  }
+  
+  if (!saveCropProfile(profile)) {
+    server.send(507, "text/plain", "Kon profiel niet opslaan (maximaal " + String(CROP_PROFILE_SLOTS) + " profielen)");
+    return;
+  }
+  
+  server.send(200, "application/json", getCropProfilesJson());
+}
+
+// Gewasprofiel activeren: {"name":"Sla"}
+void handleActivateProfile() {
+  sendCorsHeaders();
+  
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  StaticJsonDocument<128> doc;
+  DeserializationError error = deserializeJson(doc, server.arg("plain"));
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  const char* name = doc["name"];
+  if (!activateCropProfile(name)) {
+    server.send(404, "text/plain", "Profiel niet gevonden");
+    return;
+  }
+  
+  StaticJsonDocument<128> responseDoc;
+  responseDoc["status"] = "success";
+  responseDoc["active"] = settings.activeProfile;
+  
+  String response;
+  serializeJson(responseDoc, response);
+  server.send(200, "application/json", response);
+}
+
+// Gewasprofiel verwijderen: {"name":"Sla"}
+void handleDeleteProfile() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  StaticJsonDocument<128> doc;
+  DeserializationError error = deserializeJson(doc, server.arg("plain"));
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  if (!deleteCropProfile(doc["name"])) {
+    server.send(404, "text/plain", "Profiel niet gevonden");
+    return;
+  }
+  
+  server.send(200, "application/json", getCropProfilesJson());
+}
+
+// Toestand van de WiFi verbinding
+void handleGetWiFi() {
+  server.send(200, "application/json", getWiFiJson());
+}
+
+// Klokstatus: drift, synchronisatieplanning en geschiedenis
+void handleGetTime() {
+  server.send(200, "application/json", getClockJson());
+}
+
+// Weekkalender ophalen
+void handleGetCalendar() {
+  server.send(200, "application/json", getCalendarJson());
+}
+
+// Weekkalender vervangen: {"windows":[{"days":["za","zo"],"start":"08:00","end":"20:00","aan":180,"uit":600}]}
+void handlePostCalendar() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  DynamicJsonDocument doc(3072);
+  DeserializationError error = deserializeJson(doc, server.arg("plain"));
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  JsonArrayConst items = doc["windows"];
+  if (items.isNull() || items.size() > CALENDAR_MAX_WINDOWS) {
+    server.send(400, "text/plain", "Geef \"windows\" op met maximaal " + String(CALENDAR_MAX_WINDOWS) + " vensters");
+    return;
+  }
+  
+  CalendarWindow windows[CALENDAR_MAX_WINDOWS];
+  int count = 0;
+  String validationError;
+  for (JsonObjectConst item : items) {
+    if (!parseCalendarWindow(item, windows[count], validationError)) {
+      server.send(400, "text/plain", "Venster " + String(count + 1) + ": " + validationError);
+      return;
+    }
+    count++;
+  }
+  
+  if (!setCalendarWindows(windows, count, validationError)) {
+    server.send(400, "text/plain", validationError);
+    return;
+  }
+  
+  server.send(200, "application/json", getCalendarJson());
+}
+
 // Systeemstatus ophalen
 void handleGetStatus() {
   String response = getSystemStatusJson();
@@ -135,6 +404,16 @@ void handleGetSettings() {
   doc["nacht_aan"] = settings.nacht_aan;
   doc["nacht_uit"] = settings.nacht_uit;
   
+  // Volume modus (alleen met flowsensor)
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    doc["volumeModus"] = settings.volumeModus;
+    doc["temp_laag_liters"] = settings.temp_laag_liters;
+    doc["temp_midden_liters"] = settings.temp_midden_liters;
+    doc["temp_hoog_liters"] = settings.temp_hoog_liters;
+    doc["nacht_liters"] = settings.nacht_liters;
+    doc["volumeMaxAan"] = settings.volumeMaxAan;
+  #endif
+  
   // Huidige cyclustijden
   doc["currentCycleOn"] = currentCycleOn;
   doc["currentCycleOff"] = currentCycleOff;
@@ -167,56 +446,102 @@ void handlePostSettings() {
     const char* newName = doc["systeemnaam"];
     strncpy(settings.systeemnaam, newName, sizeof(settings.systeemnaam) - 1);
     settings.systeemnaam[sizeof(settings.systeemnaam) - 1] = '\0';
+    markSettingDirty(&settings.systeemnaam);
   }
   
   // Update temperatuurgrenzen
   if (doc.containsKey("temp_laag_grens")) {
     settings.temp_laag_grens = doc["temp_laag_grens"];
+    markSettingDirty(&settings.temp_laag_grens);
   }
   
   if (doc.containsKey("temp_hoog_grens")) {
     settings.temp_hoog_grens = doc["temp_hoog_grens"];
+    markSettingDirty(&settings.temp_hoog_grens);
   }
   
   // Update pompcycli tijden
   if (doc.containsKey("temp_laag_aan")) {
     settings.temp_laag_aan = doc["temp_laag_aan"];
+    markSettingDirty(&settings.temp_laag_aan);
   }
   
   if (doc.containsKey("temp_laag_uit")) {
     settings.temp_laag_uit = doc["temp_laag_uit"];
+    markSettingDirty(&settings.temp_laag_uit);
   }
   
   if (doc.containsKey("temp_midden_aan")) {
     settings.temp_midden_aan = doc["temp_midden_aan"];
+    markSettingDirty(&settings.temp_midden_aan);
   }
   
   if (doc.containsKey("temp_midden_uit")) {
     settings.temp_midden_uit = doc["temp_midden_uit"];
+    markSettingDirty(&settings.temp_midden_uit);
   }
   
   if (doc.containsKey("temp_hoog_aan")) {
     settings.temp_hoog_aan = doc["temp_hoog_aan"];
+    markSettingDirty(&settings.temp_hoog_aan);
   }
   
   if (doc.containsKey("temp_hoog_uit")) {
     settings.temp_hoog_uit = doc["temp_hoog_uit"];
+    markSettingDirty(&settings.temp_hoog_uit);
   }
   
   if (doc.containsKey("nacht_aan")) {
     settings.nacht_aan = doc["nacht_aan"];
+    markSettingDirty(&settings.nacht_aan);
   }
   
   if (doc.containsKey("nacht_uit")) {
     settings.nacht_uit = doc["nacht_uit"];
+    markSettingDirty(&settings.nacht_uit);
   }
   
   // Update bedrijfsmodus
   if (doc.containsKey("continuModus")) {
     settings.continuModus = doc["continuModus"];
+    markSettingDirty(&settings.continuModus);
   }
   
-  // Sla instellingen op in EEPROM
+  // Update volume modus
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    if (doc.containsKey("volumeModus")) {
+      settings.volumeModus = doc["volumeModus"];
+      markSettingDirty(&settings.volumeModus);
+    }
+    
+    // Validatie doelvolumes: tussen 0.1 en 1000 liter
+    const char* volumeKeys[] = {"temp_laag_liters", "temp_midden_liters", "temp_hoog_liters", "nacht_liters"};
+    float* volumeFields[] = {&settings.temp_laag_liters, &settings.temp_midden_liters,
+                             &settings.temp_hoog_liters, &settings.nacht_liters};
+    for (int i = 0; i < 4; i++) {
+      if (doc.containsKey(volumeKeys[i])) {
+        float liters = doc[volumeKeys[i]];
+        if (liters >= 0.1 && liters < 1000) {
+          *volumeFields[i] = liters;
+          markSettingDirty(volumeFields[i]);
+        }
+      }
+    }
+    
+    // Validatie tijdslimiet: tussen 10 seconden en 1 uur
+    if (doc.containsKey("volumeMaxAan")) {
+      int maxOn = doc["volumeMaxAan"];
+      if (maxOn >= 10 && maxOn <= 3600) {
+        settings.volumeMaxAan = maxOn;
+        markSettingDirty(&settings.volumeMaxAan);
+      }
+    }
+  #endif
+  
+  // Handmatig gewijzigde cyclustijden: het gewasprofiel geldt niet meer
+  checkActiveCropProfile();
+  
+  // Sla gewijzigde instellingen op in NVS
   saveSettings();
   
   // Bereken nieuwe pompcyclustijden
@@ -288,13 +613,28 @@ String getSystemStatusJson() {
   doc["overrideActive"] = manualOverride;
   doc["currentDateTime"] = getFullDateTimeString();
   doc["isNightMode"] = isNightMode();
+  doc["timeSynced"] = isClockSynced();
+  doc["clockQuality"] = getClockQualityName();
+  doc["clockSyncAge"] = getClockSyncAge();
+  doc["nightTransitionIn"] = getSecondsToNightTransition();
+  doc["calendarWindow"] = getActiveCalendarIndex();
   doc["continuModus"] = settings.continuModus;
   
   // Cyclustijden
   doc["currentCycleOn"] = currentCycleOn;
   doc["currentCycleOff"] = currentCycleOff;
   
+  // Volume modus
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    doc["volumeModus"] = settings.volumeModus;
+    doc["currentCycleLiters"] = currentCycleLiters;
+    doc["pumpCycleLiters"] = getPumpCycleLiters();
+    doc["volumeShortCycles"] = volumeShortCycles;
+  #endif
+  
   // Wifi informatie
+  doc["wifiState"] = getWiFiStateName();
+  doc["wifiRetryIn"] = getWiFiRetryIn();
   doc["wifiSignal"] = getWiFiSignalStrength();
   doc["wifiUptime"] = getWiFiUptime();
   
@@ -306,11 +646,24 @@ String getSystemStatusJson() {
     doc["flow_sensor_enabled"] = true;
     doc["flowRate"] = flowRate;
     doc["totalFlowVolume"] = totalLiters;
+    doc["lifetimeFlowVolume"] = getLifetimeLiters();
+    doc["todayFlowVolume"] = getTodayLiters();
     doc["noFlowDetected"] = !flowOk && pumpActive;
+    doc["flowAnomalies"] = getFlowAnomalies();
   #else
     doc["flow_sensor_enabled"] = false;
   #endif
   
+  #if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+    doc["mqttConnected"] = isMqttConnected();
+  #endif
+  
+  // Nog niet weggeschreven instellingen
+  doc["settingsPending"] = hasDirtySettings();
+  
+  // Actief gewasprofiel (leeg = handmatig ingesteld)
+  doc["activeProfile"] = settings.activeProfile;
+  
   String response;
   serializeJson(doc, response);
   return response;
@@ -351,6 +704,7 @@ void handleGetFlowSettings() {
   doc["minFlowRate"] = settings.minFlowRate;
   doc["flowAlertEnabled"] = settings.flowAlertEnabled;
   doc["pumpCapacityLPH"] = settings.pumpCapacityLPH;
+  doc["totalizerIntervalMin"] = settings.totalizerIntervalMin;
   
   #ifdef ENABLE_EMAIL_NOTIFICATION
     doc["emailUsername"] = settings.emailUsername;
@@ -384,10 +738,12 @@ void handlePostFlowSettings() {
   // Update flowsensor instellingen
   if (doc.containsKey("minFlowRate")) {
     settings.minFlowRate = doc["minFlowRate"];
+    markSettingDirty(&settings.minFlowRate);
   }
   
   if (doc.containsKey("flowAlertEnabled")) {
     settings.flowAlertEnabled = doc["flowAlertEnabled"];
+    markSettingDirty(&settings.flowAlertEnabled);
   }
 
   // Update pomp capaciteit
@@ -396,6 +752,17 @@ void handlePostFlowSettings() {
     // Validatie: tussen 200 en 3000 L/h
     if (newCapacity >= 200 && newCapacity <= 3000) {
       settings.pumpCapacityLPH = newCapacity;
+      markSettingDirty(&settings.pumpCapacityLPH);
+    }
+  }
+  
+  // Update opslaginterval van de volumeteller
+  if (doc.containsKey("totalizerIntervalMin")) {
+    int newInterval = doc["totalizerIntervalMin"];
+    // Validatie: tussen 1 minuut en 1 dag
+    if (newInterval >= 1 && newInterval <= 1440) {
+      settings.totalizerIntervalMin = newInterval;
+      markSettingDirty(&settings.totalizerIntervalMin);
     }
   }
   
@@ -405,22 +772,25 @@ void handlePostFlowSettings() {
       const char* username = doc["emailUsername"];
       strncpy(settings.emailUsername, username, sizeof(settings.emailUsername) - 1);
       settings.emailUsername[sizeof(settings.emailUsername) - 1] = '\0';
+      markSettingDirty(&settings.emailUsername);
     }
     
     if (doc.containsKey("emailPassword") && strlen(doc["emailPassword"]) > 0) {
       const char* password = doc["emailPassword"];
       strncpy(settings.emailPassword, password, sizeof(settings.emailPassword) - 1);
       settings.emailPassword[sizeof(settings.emailPassword) - 1] = '\0';
+      markSettingDirty(&settings.emailPassword);
     }
     
     if (doc.containsKey("emailRecipient")) {
       const char* recipient = doc["emailRecipient"];
       strncpy(settings.emailRecipient, recipient, sizeof(settings.emailRecipient) - 1);
       settings.emailRecipient[sizeof(settings.emailRecipient) - 1] = '\0';
+      markSettingDirty(&settings.emailRecipient);
     }
   #endif
   
-  // Sla instellingen op in EEPROM
+  // Sla gewijzigde instellingen op in NVS
   saveSettings();
   
   // Stuur bevestiging
@@ -435,8 +805,8 @@ void handlePostFlowSettings() {
 
 // Reset flowsensor teller
 void handleResetFlow() {
-  // Reset totaal aantal liters
-  totalLiters = 0;
+  // Reset totaal aantal liters (levensduur- en dagtellers blijven staan)
+  resetFlowCounter();
   
   // Stuur bevestiging
   DynamicJsonDocument responseDoc(256);
@@ -448,6 +818,91 @@ void handleResetFlow() {
   server.send(200, "application/json", response);
 }
 
+// Geleerde stromingsbasislijn vergeten (na onderhoud of pompwissel)
+void handleResetFlowBaseline() {
+  resetFlowAnomalyBaseline();
+  
+  // Stuur bevestiging
+  DynamicJsonDocument responseDoc(256);
+  responseDoc["status"] = "success";
+  responseDoc["message"] = "Basislijn waterstroming gereset";
+  
+  String response;
+  serializeJson(responseDoc, response);
+  server.send(200, "application/json", response);
+}
+
+// Aanloopstatistiek van de pomp ophalen
+void handleGetFlowRamp() {
+  String response = getFlowRampJson();
+  server.send(200, "application/json", response);
+}
+
+// Flow kalibratie ophalen
+void handleGetFlowCalibration() {
+  String response = getFlowCalibrationJson();
+  server.send(200, "application/json", response);
+}
+
+// Flow kalibratie bedienen
+// {"action":"start"}                     - start een kalibratierun
+// {"action":"finish","volumeLiters":2.0} - rond af met het gevulde volume
+// {"action":"cancel"}                    - breek de lopende run af
+// {"action":"delete","index":0}          - verwijder één kalibratiepunt
+// {"action":"clear"}                     - wis de volledige tabel
+void handlePostFlowCalibration() {
+  // Controleer of er JSON data is ontvangen
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  String jsonStr = server.arg("plain");
+  DynamicJsonDocument doc(256);
+  
+  // Probeer JSON te parsen
+  DeserializationError error = deserializeJson(doc, jsonStr);
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  String action = doc["action"] | "";
+  bool success = false;
+  String message;
+  
+  if (action == "start") {
+    success = startFlowCalibration();
+    message = success ? "Kalibratie gestart" : "Er loopt al een kalibratie";
+  } else if (action == "finish") {
+    float volume = doc["volumeLiters"] | 0.0;
+    success = finishFlowCalibration(volume, message);
+  } else if (action == "cancel") {
+    cancelFlowCalibration();
+    success = true;
+    message = "Kalibratie afgebroken";
+  } else if (action == "delete") {
+    success = deleteFlowCalibrationPoint(doc["index"] | -1);
+    message = success ? "Kalibratiepunt verwijderd" : "Ongeldige index";
+  } else if (action == "clear") {
+    clearFlowCalibration();
+    success = true;
+    message = "Kalibratietabel gewist";
+  } else {
+    server.send(400, "text/plain", "Onbekende actie");
+    return;
+  }
+  
+  // Stuur bevestiging
+  DynamicJsonDocument responseDoc(256);
+  responseDoc["status"] = success ? "success" : "error";
+  responseDoc["message"] = message;
+  
+  String response;
+  serializeJson(responseDoc, response);
+  server.send(200, "application/json", response);
+}
+
 #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
 // Test e-mail versturen
 void handleTestEmail() {
@@ -458,17 +913,199 @@ void handleTestEmail() {
   
   if (success) {
     responseDoc["status"] = "success";
-    responseDoc["message"] = "Test e-mail succesvol verzonden";
+    responseDoc["message"] = "Test e-mail in wachtrij geplaatst";
   } else {
     responseDoc["status"] = "error";
-    responseDoc["message"] = "Kon geen test e-mail versturen";
+    responseDoc["message"] = getLastEmailError();
   }
   
   String response;
   serializeJson(responseDoc, response);
   server.send(200, "application/json", response);
 }
+
+// E-mail wachtrij en verzendstatus ophalen
+void handleGetEmailStatus() {
+  server.send(200, "application/json", getEmailStatusJson());
+}
 #endif
 
 
-#endif
\ No newline at end of file
+#endif
+
+#if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+// Webhook instellingen ophalen
+void handleGetWebhookSettings() {
+  DynamicJsonDocument doc(256);
+  doc["webhookUrl"] = settings.webhookUrl;
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Webhook instellingen opslaan
+void handlePostWebhookSettings() {
+  // Controleer of er JSON data is ontvangen
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  String jsonStr = server.arg("plain");
+  DynamicJsonDocument doc(384);
+  
+  // Probeer JSON te parsen
+  DeserializationError error = deserializeJson(doc, jsonStr);
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  if (doc.containsKey("webhookUrl")) {
+    const char* url = doc["webhookUrl"];
+    if (url == NULL) {
+      url = "";
+    }
+    
+    // Alleen http(s) URL's of leeg (uitschakelen)
+    if (strlen(url) > 0 && strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) {
+      server.send(400, "text/plain", "Webhook URL moet met http:// of https:// beginnen");
+      return;
+    }
+    if (strlen(url) >= sizeof(settings.webhookUrl)) {
+      server.send(400, "text/plain", "Webhook URL is te lang");
+      return;
+    }
+    
+    strcpy(settings.webhookUrl, url);
+    markSettingDirty(&settings.webhookUrl);
+  }
+  
+  // Sla gewijzigde instellingen op in NVS
+  saveSettings();
+  setupWebhook();
+  
+  // Stuur bevestiging
+  DynamicJsonDocument responseDoc(256);
+  responseDoc["status"] = "success";
+  responseDoc["message"] = "Webhook instellingen opgeslagen";
+  
+  String response;
+  serializeJson(responseDoc, response);
+  server.send(200, "application/json", response);
+}
+
+// Test webhook versturen
+void handleTestWebhook() {
+  bool success = sendTestWebhook();
+  
+  DynamicJsonDocument responseDoc(256);
+  responseDoc["status"] = success ? "success" : "error";
+  responseDoc["message"] = success ? "Test melding in wachtrij geplaatst" : "Geen webhook URL ingesteld of wachtrij vol";
+  
+  String response;
+  serializeJson(responseDoc, response);
+  server.send(200, "application/json", response);
+}
+#endif
+
+#if defined(ENABLE_MQTT) && ENABLE_MQTT == true
+// MQTT instellingen ophalen
+void handleGetMqttSettings() {
+  DynamicJsonDocument doc(512);
+  
+  doc["mqttHost"] = settings.mqttHost;
+  doc["mqttPort"] = settings.mqttPort;
+  doc["mqttUser"] = settings.mqttUser;
+  doc["mqttPassword"] = ""; // Niet het wachtwoord terugsturen
+  doc["mqttBaseTopic"] = settings.mqttBaseTopic;
+  doc["mqttDiscovery"] = settings.mqttDiscovery;
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// MQTT instellingen opslaan en opnieuw verbinden
+void handlePostMqttSettings() {
+  // Controleer of er JSON data is ontvangen
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Geen JSON data ontvangen");
+    return;
+  }
+  
+  String jsonStr = server.arg("plain");
+  DynamicJsonDocument doc(512);
+  
+  // Probeer JSON te parsen
+  DeserializationError error = deserializeJson(doc, jsonStr);
+  if (error) {
+    server.send(400, "text/plain", "Ongeldige JSON data: " + String(error.c_str()));
+    return;
+  }
+  
+  if (doc.containsKey("mqttHost")) {
+    const char* host = doc["mqttHost"];
+    strncpy(settings.mqttHost, host ? host : "", sizeof(settings.mqttHost) - 1);
+    settings.mqttHost[sizeof(settings.mqttHost) - 1] = '\0';
+    markSettingDirty(&settings.mqttHost);
+  }
+  
+  if (doc.containsKey("mqttPort")) {
+    int port = doc["mqttPort"];
+    if (port > 0 && port <= 65535) {
+      settings.mqttPort = port;
+      markSettingDirty(&settings.mqttPort);
+    }
+  }
+  
+  if (doc.containsKey("mqttUser")) {
+    const char* user = doc["mqttUser"];
+    strncpy(settings.mqttUser, user ? user : "", sizeof(settings.mqttUser) - 1);
+    settings.mqttUser[sizeof(settings.mqttUser) - 1] = '\0';
+    markSettingDirty(&settings.mqttUser);
+  }
+  
+  if (doc.containsKey("mqttPassword") && strlen(doc["mqttPassword"]) > 0) {
+    const char* pass = doc["mqttPassword"];
+    strncpy(settings.mqttPassword, pass, sizeof(settings.mqttPassword) - 1);
+    settings.mqttPassword[sizeof(settings.mqttPassword) - 1] = '\0';
+    markSettingDirty(&settings.mqttPassword);
+  }
+  
+  if (doc.containsKey("mqttBaseTopic")) {
+    const char* base = doc["mqttBaseTopic"];
+    if (base != NULL && strlen(base) > 0 && strpbrk(base, "+#") == NULL) {
+      strncpy(settings.mqttBaseTopic, base, sizeof(settings.mqttBaseTopic) - 1);
+      settings.mqttBaseTopic[sizeof(settings.mqttBaseTopic) - 1] = '\0';
+      markSettingDirty(&settings.mqttBaseTopic);
+    }
+  }
+  
+  if (doc.containsKey("mqttDiscovery")) {
+    settings.mqttDiscovery = doc["mqttDiscovery"];
+    markSettingDirty(&settings.mqttDiscovery);
+  }
+  
+  // Sla gewijzigde instellingen op in NVS
+  saveSettings();
+  
+  // Verbind opnieuw met de nieuwe instellingen
+  setupMqtt();
+  
+  // Stuur bevestiging
+  DynamicJsonDocument responseDoc(256);
+  responseDoc["status"] = "success";
+  responseDoc["message"] = "MQTT instellingen opgeslagen";
+  
+  String response;
+  serializeJson(responseDoc, response);
+  server.send(200, "application/json", response);
+}
+
+// MQTT verbindingsstatus ophalen
+void handleGetMqttStatus() {
+  server.send(200, "application/json", getMqttStatusJson());
+}
+#endif
@@ -363,6 +363,46 @@ const char* WEBUI_HTML = R"rawliteral(
       </tr>
     </table>
     
+    <div id="volume-settings" style="display: none;">
+      <h3>Volume modus</h3>
+      <p style="margin-bottom: 10px; font-size: 14px; color: #666;">
+        In volume modus stopt de pomp zodra het ingestelde aantal liters is rondgepompt (gemeten met de flowsensor). De AAN-tijden hierboven worden dan niet gebruikt; de tijdslimiet is een vangnet.
+      </p>
+      <div class="settings-row">
+        <div class="settings-label">AAN-fase op basis van:</div>
+        <select id="volumeModus">
+          <option value="false">Tijd</option>
+          <option value="true">Volume</option>
+        </select>
+      </div>
+      <table>
+        <tr>
+          <th>Temperatuurbereik</th>
+          <th>Liters per cyclus</th>
+        </tr>
+        <tr>
+          <td>Laag</td>
+          <td><input type="number" id="temp_laag_liters" min="0.1" step="0.1"></td>
+        </tr>
+        <tr>
+          <td>Midden</td>
+          <td><input type="number" id="temp_midden_liters" min="0.1" step="0.1"></td>
+        </tr>
+        <tr>
+          <td>Hoog</td>
+          <td><input type="number" id="temp_hoog_liters" min="0.1" step="0.1"></td>
+        </tr>
+        <tr>
+          <td>Nacht</td>
+          <td><input type="number" id="nacht_liters" min="0.1" step="0.1"></td>
+        </tr>
+      </table>
+      <div class="settings-row">
+        <div class="settings-label">Tijdslimiet AAN:</div>
+        <input type="number" id="volumeMaxAan" min="0.5" max="60" step="0.5"> minuten
+      </div>
+    </div>
+    
     <div class="settings-save">
       <button onclick="saveSettings()">Instellingen opslaan</button>
     </div>
@@ -568,6 +608,16 @@ const char* WEBUI_HTML = R"rawliteral(
 
           // Update continue modus selectie
           document.getElementById('continuModus').value = data.continuModus.toString();
+          
+          // Volume modus (alleen aanwezig met flowsensor)
+          if (data.volumeModus !== undefined) {
+            document.getElementById('volumeModus').value = data.volumeModus.toString();
+            document.getElementById('temp_laag_liters').value = data.temp_laag_liters;
+            document.getElementById('temp_midden_liters').value = data.temp_midden_liters;
+            document.getElementById('temp_hoog_liters').value = data.temp_hoog_liters;
+            document.getElementById('nacht_liters').value = data.nacht_liters;
+            document.getElementById('volumeMaxAan').value = (data.volumeMaxAan / 60).toFixed(1);
+          }
         })
         .catch(error => {
           console.error('Fout bij het ophalen van instellingen:', error);
@@ -614,6 +664,9 @@ function checkModulesAvailable() {
           flowSensorData.style.display = 'block';
         }
         
+        // Toon volume modus instellingen
+        document.getElementById('volume-settings').style.display = 'block';
+        
         // Laad flow sensor instellingen
         fetchFlowSettings();
         
@@ -733,6 +786,16 @@ function fetchStatusWithFlow() {
         continuModus: document.getElementById('continuModus').value === 'true'
       };
       
+      // Volume modus alleen meesturen als de flowsensor beschikbaar is
+      if (document.getElementById('volume-settings').style.display !== 'none') {
+        settings.volumeModus = document.getElementById('volumeModus').value === 'true';
+        settings.temp_laag_liters = parseFloat(document.getElementById('temp_laag_liters').value);
+        settings.temp_midden_liters = parseFloat(document.getElementById('temp_midden_liters').value);
+        settings.temp_hoog_liters = parseFloat(document.getElementById('temp_hoog_liters').value);
+        settings.nacht_liters = parseFloat(document.getElementById('nacht_liters').value);
+        settings.volumeMaxAan = Math.round(parseFloat(document.getElementById('volumeMaxAan').value) * 60);
+      }
+      
       fetch('/api/settings', {
         method: 'POST',
         headers: {
@@ -798,7 +861,7 @@ function fetchStatusWithFlow() {
       .then(response => response.json())
       .then(data => {
         if (data.status === 'success') {
-          alert('Test e-mail succesvol verzonden!');
+          alert('Test e-mail in wachtrij geplaatst, wordt op de achtergrond verzonden.');
         } else {
           alert('Fout bij het versturen van test e-mail: ' + data.message);
         }
@@ -0,0 +1,281 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * Webhook.cpp
+ *
+ * Meldingskanaal dat elke waarschuwing als compact JSON-bericht naar een
+ * instelbare URL POST (bijv. Home Assistant, Node-RED, ntfy of een eigen
+ * server). Veel lichter dan e-mail: één HTTP-verzoek, zonder SMTP.
+ *
+ * Het versturen gebeurt in een eigen taak, zodat loop() nooit op het netwerk
+ * wacht. Mislukte verzoeken komen in een kleine herhaallijst en worden met
+ * oplopende wachttijd (5 s, 10 s, 20 s, ... tot 5 minuten) opnieuw
+ * geprobeerd. Zijn de wachtrij of de herhaallijst vol, dan vervalt de
+ * nieuwe resp. de oudste melding en wordt dat geteld.
+ *
+ * Voorbeeld bericht:
+ *   {"system":"Hydro Systeem 1","kind":"no_flow","subsystem":"Flow",
+ *    "title":"WAARSCHUWING: ...","critical":true,"time":1718000000,
+ *    "temperature":21.5,"flow":0.0}
+ */
+
+#include "Webhook.h"
+#include "Notification.h"
+#include <HTTPClient.h>
+
+#if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+
+struct WebhookJob {
+  char payload[WEBHOOK_PAYLOAD_LEN];
+  uint8_t attempts;
+  unsigned long nextAttempt;
+};
+
+static QueueHandle_t webhookQueue = NULL;
+static TaskHandle_t webhookTaskHandle = NULL;
+static SemaphoreHandle_t webhookMutex = NULL;
+
+// Kopie van de URL voor de taak (beschermd door webhookMutex)
+static char webhookUrl[sizeof(settings.webhookUrl)];
+
+// Statistieken (beschermd door webhookMutex)
+static uint32_t webhookSent = 0;
+static uint32_t webhookFailed = 0;       // Na alle pogingen opgegeven
+static uint32_t webhookDropped = 0;      // Wachtrij of herhaallijst vol
+static uint32_t webhookRetries = 0;
+static uint16_t webhookPendingRetries = 0;
+static int webhookLastCode = 0;
+static unsigned long webhookLastLatency = 0;
+static unsigned long webhookTotalLatency = 0;
+
+// Verstuur één verzoek; true bij een 2xx antwoord
+static bool postWebhook(const char* payload) {
+  char url[sizeof(webhookUrl)];
+  xSemaphoreTake(webhookMutex, portMAX_DELAY);
+  strcpy(url, webhookUrl);
+  xSemaphoreGive(webhookMutex);
+  
+  if (url[0] == '\0' || WiFi.status() != WL_CONNECTED) {
+    return false;
+  }
+  
+  unsigned long start = millis();
+  
+  HTTPClient http;
+  http.setConnectTimeout(WEBHOOK_TIMEOUT);
+  http.setTimeout(WEBHOOK_TIMEOUT);
+  
+  int code = -1;
+  if (http.begin(url)) {
+    http.addHeader("Content-Type", "application/json");
+    code = http.POST((uint8_t*)payload, strlen(payload));
+    http.end();
+  }
+  
+  unsigned long latency = millis() - start;
+  bool ok = code >= 200 && code < 300;
+  
+  xSemaphoreTake(webhookMutex, portMAX_DELAY);
+  webhookLastCode = code;
+  webhookLastLatency = latency;
+  if (ok) {
+    webhookSent++;
+    webhookTotalLatency += latency;
+  }
+  xSemaphoreGive(webhookMutex);
+  
+  if (!ok) {
+    Serial.print("Webhook mislukt, code ");
+    Serial.println(code);
+  }
+  return ok;
+}
+
+// Webhook taak: verstuurt nieuwe meldingen en verwerkt de herhaallijst
+static void webhookTask(void* parameter) {
+  WebhookJob retries[WEBHOOK_RETRY_SLOTS];
+  int retryCount = 0;
+  WebhookJob job;
+  
+  for (;;) {
+    // Wacht op een nieuwe melding, maar niet langer dan tot de eerstvolgende herhaalpoging
+    TickType_t wait = portMAX_DELAY;
+    if (retryCount > 0) {
+      unsigned long now = millis();
+      long soonest = WEBHOOK_RETRY_MAX;
+      for (int i = 0; i < retryCount; i++) {
+        long remaining = (long)(retries[i].nextAttempt - now);
+        if (remaining < soonest) {
+          soonest = remaining;
+        }
+      }
+      wait = soonest > 0 ? pdMS_TO_TICKS(soonest) : 0;
+    }
+    
+    bool received = xQueueReceive(webhookQueue, &job, wait) == pdTRUE;
+    
+    if (received && !postWebhook(job.payload)) {
+      job.attempts = 1;
+      job.nextAttempt = millis() + WEBHOOK_RETRY_BASE;
+      
+      if (retryCount >= WEBHOOK_RETRY_SLOTS) {
+        // Herhaallijst vol: oudste melding vervalt
+        for (int i = 1; i < retryCount; i++) {
+          retries[i - 1] = retries[i];
+        }
+        retryCount--;
+        xSemaphoreTake(webhookMutex, portMAX_DELAY);
+        webhookDropped++;
+        xSemaphoreGive(webhookMutex);
+      }
+      retries[retryCount++] = job;
+    }
+    
+    // Herhaalpogingen die aan de beurt zijn
+    for (int i = 0; i < retryCount; ) {
+      if ((long)(millis() - retries[i].nextAttempt) < 0) {
+        i++;
+        continue;
+      }
+      
+      xSemaphoreTake(webhookMutex, portMAX_DELAY);
+      webhookRetries++;
+      xSemaphoreGive(webhookMutex);
+      
+      bool done = postWebhook(retries[i].payload);
+      retries[i].attempts++;
+      
+      if (!done && retries[i].attempts < WEBHOOK_MAX_ATTEMPTS) {
+        unsigned long backoff = (unsigned long)WEBHOOK_RETRY_BASE << (retries[i].attempts - 1);
+        if (backoff > WEBHOOK_RETRY_MAX) {
+          backoff = WEBHOOK_RETRY_MAX;
+        }
+        retries[i].nextAttempt = millis() + backoff;
+        i++;
+        continue;
+      }
+      
+      if (!done) {
+        xSemaphoreTake(webhookMutex, portMAX_DELAY);
+        webhookFailed++;
+        xSemaphoreGive(webhookMutex);
+        Serial.println("FOUT: Webhook opgegeven na maximaal aantal pogingen");
+      }
+      
+      // Verwijder uit de herhaallijst
+      for (int k = i + 1; k < retryCount; k++) {
+        retries[k - 1] = retries[k];
+      }
+      retryCount--;
+    }
+    
+    xSemaphoreTake(webhookMutex, portMAX_DELAY);
+    webhookPendingRetries = retryCount;
+    xSemaphoreGive(webhookMutex);
+  }
+}
+
+// Zet een JSON-bericht in de wachtrij zonder te wachten
+static bool queueWebhook(const AlertEvent& event) {
+  StaticJsonDocument<WEBHOOK_PAYLOAD_LEN + 64> doc;
+  doc["system"] = settings.systeemnaam;
+  doc["kind"] = event.kind;
+  doc["subsystem"] = event.subsystem;
+  doc["title"] = event.subject;
+  doc["critical"] = event.critical;
+  doc["time"] = (uint32_t)event.time;
+  doc["temperature"] = currentTemp;
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true
+    doc["flow"] = flowRate;
+  #endif
+  
+  WebhookJob job;
+  serializeJson(doc, job.payload, sizeof(job.payload));
+  job.attempts = 0;
+  job.nextAttempt = 0;
+  
+  if (xQueueSend(webhookQueue, &job, 0) != pdTRUE) {
+    xSemaphoreTake(webhookMutex, portMAX_DELAY);
+    webhookDropped++;
+    xSemaphoreGive(webhookMutex);
+    return false;
+  }
+  return true;
+}
+
+// Meldingskanaal: waarschuwing als webhook
+static bool webhookSinkDeliver(const AlertEvent& event) {
+  if (webhookQueue == NULL || settings.webhookUrl[0] == '\0') {
+    return false;
+  }
+  return queueWebhook(event);
+}
+
+static void webhookSinkStatus(JsonObject obj) {
+  xSemaphoreTake(webhookMutex, portMAX_DELAY);
+  obj["configured"] = webhookUrl[0] != '\0';
+  obj["sent"] = webhookSent;
+  obj["failed"] = webhookFailed;
+  obj["dropped"] = webhookDropped;
+  obj["retries"] = webhookRetries;
+  obj["pendingRetries"] = webhookPendingRetries;
+  obj["lastHttpCode"] = webhookLastCode;
+  obj["lastLatencyMs"] = webhookLastLatency;
+  obj["avgLatencyMs"] = webhookSent > 0 ? webhookTotalLatency / webhookSent : 0;
+  xSemaphoreGive(webhookMutex);
+  obj["queued"] = uxQueueMessagesWaiting(webhookQueue);
+}
+
+static const NotificationSink webhookSink = { "webhook", webhookSinkDeliver, webhookSinkStatus };
+
+// Initialiseer het webhook kanaal; ook aanroepen na het wijzigen van de URL
+void setupWebhook() {
+  if (webhookQueue == NULL) {
+    webhookQueue = xQueueCreate(WEBHOOK_QUEUE_LENGTH, sizeof(WebhookJob));
+    webhookMutex = xSemaphoreCreateMutex();
+    
+    if (webhookQueue == NULL || webhookMutex == NULL) {
+      Serial.println("FOUT: Kan webhook wachtrij niet aanmaken");
+      webhookQueue = NULL;
+      return;
+    }
+    
+    // Stapel ruim genoeg voor HTTPClient met TLS en de herhaallijst
+    if (xTaskCreatePinnedToCore(webhookTask, "webhook", 8192, NULL, 1, &webhookTaskHandle, 0) != pdPASS) {
+      Serial.println("FOUT: Kan webhook taak niet starten");
+      webhookQueue = NULL;
+      return;
+    }
+    
+    registerNotificationSink(&webhookSink);
+  }
+  
+  xSemaphoreTake(webhookMutex, portMAX_DELAY);
+  strncpy(webhookUrl, settings.webhookUrl, sizeof(webhookUrl) - 1);
+  webhookUrl[sizeof(webhookUrl) - 1] = '\0';
+  xSemaphoreGive(webhookMutex);
+  
+  Serial.print("Webhook: ");
+  Serial.println(webhookUrl[0] != '\0' ? webhookUrl : "niet ingesteld");
+}
+
+// Verstuur een testmelding alleen via de webhook
+bool sendTestWebhook() {
+  AlertEvent event = { "test", "Systeem", "Test melding van het hydroponisch systeem", "", false, 0 };
+  time_t now = time(nullptr);
+  event.time = (now > 1577836800) ? now : 0;
+  return webhookSinkDeliver(event);
+}
+
+#endif // defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
@@ -0,0 +1,35 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ * 
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ * 
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ * 
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * Webhook.h
+ *
+ * Header voor het webhook meldingskanaal
+ */
+
+#ifndef WEBHOOK_H
+#define WEBHOOK_H
+
+#include "Settings.h"
+
+#if defined(ENABLE_WEBHOOK) && ENABLE_WEBHOOK == true
+  #define WEBHOOK_QUEUE_LENGTH 6          // Nieuwe meldingen die op verzending wachten
+  #define WEBHOOK_RETRY_SLOTS 4           // Meldingen die op een herhaalpoging wachten
+  #define WEBHOOK_MAX_ATTEMPTS 6
+  #define WEBHOOK_RETRY_BASE 5000         // Eerste herhaalpoging na 5 s, daarna verdubbeld
+  #define WEBHOOK_RETRY_MAX 300000        // Maximaal 5 minuten tussen pogingen
+  #define WEBHOOK_TIMEOUT 3000            // Verbinden en antwoord (ms)
+  #define WEBHOOK_PAYLOAD_LEN 320
+#endif
+
+#endif // WEBHOOK_H
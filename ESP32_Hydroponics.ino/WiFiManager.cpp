@@ -15,22 +15,261 @@
  * WiFiManager.cpp
  *
  * Beheer van WiFi verbinding met automatisch herstel en statuscontrole
+ *
+ * De verbinding wordt beheerd als toestandsmachine die nooit wacht: WiFi.begin()
+ * start een poging, de WiFi-taak meldt via WiFi.onEvent() of die gelukt of
+ * mislukt is, en checkWiFiConnection() verwerkt die meldingen in de hoofdlus.
+ * Pompbesturing en webserver lopen daardoor gewoon door terwijl de controller
+ * (opnieuw) verbinding zoekt.
+ *
+ * Het grootste deel van de verbindingstijd gaat op aan het scannen van alle
+ * kanalen. Daarom worden het accesspoint (BSSID) en het kanaal van elke
+ * geslaagde verbinding bewaard, in RTC geheugen (overleeft een herstart) en
+ * in NVS (overleeft ook een stroomonderbreking; alleen geschreven als er iets
+ * veranderd is). Een poging gaat dan eerst direct naar dat accesspoint op dat
+ * kanaal; lukt dat niet snel, dan volgt meteen een gewone poging met
+ * volledige scan. De tijd van opstarten tot online wordt gemeten en getoond
+ * in /api/wifi; test/sim_wifi_connect.cpp vergelijkt beide manieren.
+ *
+ * Na een mislukte ronde wordt steeds langer gewacht (verdubbelend tot een
+ * minuut), met een willekeurige spreiding. Valt een accesspoint weg, dan
+ * proberen alle controllers in de kas het zo niet tegelijk en elke 30
+ * seconden opnieuw, maar verspreid en minder vaak. Ook het eerste
+ * herverbinden na een verbroken verbinding wordt willekeurig uitgesteld.
+ * Na een mislukte ronde bestaat de volgende alleen uit een scan: die meldt
+ * in één poging of het accesspoint terug is, ook op een ander kanaal. Zo
+ * blijft het herstel na terugkomst van het accesspoint binnen ruim een
+ * minuut (test/sim_wifi_backoff.cpp controleert dit).
  */
 
 #include "Settings.h"
+#include <Preferences.h>
+#include <esp_system.h>
+#include <rom/crc.h>
+#include <stddef.h>
+
+#define WIFI_CONNECT_TIMEOUT_MS 20000   // Poging opgeven als er dan nog geen IP-adres is
+#define WIFI_DIRECT_TIMEOUT_MS 5000     // Directe poging (bekend accesspoint en kanaal) opgeven na
+#define WIFI_BACKOFF_BASE_MS 10000      // Wachttijd na de eerste mislukte ronde (bovengrens)
+#define WIFI_BACKOFF_MAX_MS 60000       // Wachttijd groeit niet verder dan 1 minuut
+#define WIFI_EVENT_GRACE_MS 500         // Verbreekmelding zo kort na de start hoort nog bij de vorige poging
+
+#define WIFI_CACHE_NAMESPACE "wifi"
+#define WIFI_CACHE_KEY "laatste"
+#define WIFI_CACHE_MAGIC 0x57494649     // "WIFI"
+
+// Ophalen van SSID en wachtwoord uit SettingsImpl.cpp
+extern const char* ssid;
+extern const char* password;
+
+// Toestand van de verbinding
+static WiFiState wifiState = WIFI_STATE_IDLE;
+static unsigned long wifiStateSince = 0;     // millis() bij het ingaan van de huidige toestand
+unsigned long wifiConnectTime = 0;           // Tijdstip van succesvolle verbinding
+
+// Meldingen van de WiFi-taak, verwerkt in de hoofdlus
+static portMUX_TYPE wifiEventMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool wifiGotIpEvent = false;
+static volatile bool wifiDisconnectEvent = false;
+static volatile uint8_t wifiDisconnectReason = 0;
+
+// Statistieken
+static unsigned long wifiAttempts = 0;       // Gestarte verbindingspogingen
+static unsigned long wifiFailures = 0;       // Mislukte pogingen (fout of time-out)
+static unsigned long wifiConnects = 0;       // Geslaagde verbindingen
+static unsigned long wifiDrops = 0;          // Verbroken na een geslaagde verbinding
+static uint8_t lastDisconnectReason = 0;     // Redencode van de WiFi-stack
+
+// Wachten tussen rondes
+static uint8_t wifiFailStreak = 0;           // Mislukte rondes op rij, 0 na een geslaagde verbinding
+static unsigned long wifiBackoffMs = 0;      // Bovengrens van de huidige wachttijd
+static unsigned long wifiRetryDelay = 0;     // Gekozen wachttijd voor de volgende ronde
+
+// Laatst gebruikte accesspoint. Geen IP-lease: die als vast adres instellen
+// zou DHCP overslaan, en dan verlengt niemand de lease meer.
+struct WiFiCache {
+  uint32_t magic;
+  uint32_t ssidCrc;          // Hoort bij dit netwerk; na wijzigen van de SSID ongeldig
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t crc;
+};
+
+RTC_NOINIT_ATTR static WiFiCache wifiRtcCache;
+static WiFiCache wifiCache;                  // Geldige kopie, of magic 0
+static const char* wifiCacheSource = "geen"; // Waar de cache bij opstarten vandaan kwam
+Preferences wifiPrefs;
 
-// WiFi verbindingsvariabelen
-unsigned long lastReconnectAttempt = 0;
-const int reconnectInterval = 30000; // 30 seconden tussen pogingen
-unsigned long wifiConnectTime = 0;   // Tijdstip van succesvolle verbinding
+// Direct verbinden en opstarttijd
+static bool attemptDirect = false;           // Huidige poging gaat direct naar het bekende accesspoint
+static unsigned long cycleStart = 0;         // millis() bij de eerste poging van deze ronde
+static unsigned long directConnects = 0;     // Geslaagd via directe poging
+static unsigned long directFailures = 0;     // Directe poging mislukt, terugval op scan
+static unsigned long scanConnects = 0;       // Geslaagd via volledige scan
+static unsigned long bootToOnlineMs = 0;     // Van opstarten tot eerste IP-adres, 0 = nog niet online
+static unsigned long lastConnectMs = 0;      // Duur van de laatste geslaagde ronde
+static bool lastConnectDirect = false;
+
+// Aangeroepen vanuit de WiFi-taak: alleen vastleggen
+static void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  portENTER_CRITICAL(&wifiEventMux);
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      wifiGotIpEvent = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      wifiDisconnectEvent = true;
+      wifiDisconnectReason = info.wifi_sta_disconnected.reason;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      wifiDisconnectEvent = true;
+      break;
+    default:
+      break;
+  }
+  portEXIT_CRITICAL(&wifiEventMux);
+}
+
+static void setWiFiState(WiFiState state) {
+  wifiState = state;
+  wifiStateSince = millis();
+}
+
+static uint32_t wifiCacheCrc(const WiFiCache& cache) {
+  return crc32_le(0, (const uint8_t*)&cache, offsetof(WiFiCache, crc));
+}
+
+static bool wifiCacheValid(const WiFiCache& cache) {
+  return cache.magic == WIFI_CACHE_MAGIC &&
+         cache.ssidCrc == crc32_le(0, (const uint8_t*)ssid, strlen(ssid)) &&
+         cache.channel >= 1 && cache.channel <= 14 &&
+         cache.crc == wifiCacheCrc(cache);
+}
+
+// Cache laden: RTC geheugen na een herstart, anders NVS
+static void loadWiFiCache() {
+  wifiCache.magic = 0;
+  
+  // Na stroomuitval of brownout bevat het RTC geheugen willekeurige data
+  esp_reset_reason_t reason = esp_reset_reason();
+  if (reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT && wifiCacheValid(wifiRtcCache)) {
+    wifiCache = wifiRtcCache;
+    wifiCacheSource = "rtc";
+    return;
+  }
+  
+  WiFiCache stored;
+  wifiPrefs.begin(WIFI_CACHE_NAMESPACE, true);
+  bool found = wifiPrefs.getBytes(WIFI_CACHE_KEY, &stored, sizeof(stored)) == sizeof(stored);
+  wifiPrefs.end();
+  
+  if (found && wifiCacheValid(stored)) {
+    wifiCache = stored;
+    wifiRtcCache = stored;
+    wifiCacheSource = "nvs";
+  }
+}
+
+// Na een geslaagde verbinding: accesspoint en kanaal vastleggen
+static void saveWiFiCache() {
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid == NULL) {
+    return;
+  }
+  
+  WiFiCache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.magic = WIFI_CACHE_MAGIC;
+  cache.ssidCrc = crc32_le(0, (const uint8_t*)ssid, strlen(ssid));
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.crc = wifiCacheCrc(cache);
+  
+  // RTC geheugen kost niets; flash alleen als er werkelijk iets veranderd is
+  wifiRtcCache = cache;
+  if (wifiCacheValid(wifiCache) && memcmp(&wifiCache, &cache, sizeof(cache)) == 0) {
+    return;
+  }
+  wifiCache = cache;
+  
+  wifiPrefs.begin(WIFI_CACHE_NAMESPACE, false);
+  if (wifiPrefs.putBytes(WIFI_CACHE_KEY, &cache, sizeof(cache)) != sizeof(cache)) {
+    Serial.println("Fout bij opslaan van WiFi gegevens");
+  }
+  wifiPrefs.end();
+}
+
+static String formatBssid(const uint8_t* bssid) {
+  char buffer[18];
+  snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X",
+           bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+  return String(buffer);
+}
+
+// Start een verbindingspoging (keert direct terug). Direct naar het bekende
+// accesspoint als dat kan, anders met een volledige scan.
+static void startWiFiAttempt(bool direct) {
+  portENTER_CRITICAL(&wifiEventMux);
+  wifiGotIpEvent = false;
+  wifiDisconnectEvent = false;
+  portEXIT_CRITICAL(&wifiEventMux);
+  
+  attemptDirect = direct && wifiCacheValid(wifiCache);
+  wifiAttempts++;
+  setWiFiState(WIFI_STATE_CONNECTING);
+  
+  Serial.print("Verbinden met WiFi netwerk: ");
+  Serial.print(ssid);
+  Serial.print(" (poging ");
+  Serial.print(wifiAttempts);
+  if (attemptDirect) {
+    Serial.print(", direct naar ");
+    Serial.print(formatBssid(wifiCache.bssid));
+    Serial.print(" kanaal ");
+    Serial.print(wifiCache.channel);
+  }
+  Serial.println(")");
+  
+  if (attemptDirect) {
+    WiFi.begin(ssid, password, wifiCache.channel, wifiCache.bssid);
+  } else {
+    WiFi.begin(ssid, password);
+  }
+}
 
-// Configureer en verbind met WiFi
+// Willekeurige wachttijd tussen min en max (ms)
+static unsigned long randomDelay(unsigned long minMs, unsigned long maxMs) {
+  return minMs + esp_random() % (maxMs - minMs + 1);
+}
+
+// Na een mislukte ronde: bovengrens verdubbelen, wachttijd in de bovenste helft daarvan
+static void scheduleWiFiRetry() {
+  if (wifiFailStreak < 255) {
+    wifiFailStreak++;
+  }
+  wifiBackoffMs = WIFI_BACKOFF_BASE_MS;
+  for (uint8_t i = 1; i < wifiFailStreak && wifiBackoffMs < WIFI_BACKOFF_MAX_MS; i++) {
+    wifiBackoffMs *= 2;
+  }
+  if (wifiBackoffMs > WIFI_BACKOFF_MAX_MS) {
+    wifiBackoffMs = WIFI_BACKOFF_MAX_MS;
+  }
+  wifiRetryDelay = randomDelay(wifiBackoffMs / 2, wifiBackoffMs);
+  setWiFiState(WIFI_STATE_WAITING);
+}
+
+// Nieuwe ronde: eerst direct, bij mislukken volgt de scan. Na een mislukte
+// ronde meteen de scan; de directe poging zou dan alleen 5 s op zijn time-out wachten.
+static void startWiFiCycle() {
+  cycleStart = millis();
+  startWiFiAttempt(wifiFailStreak == 0);
+}
+
+// Configureer WiFi en start de eerste verbindingspoging (wacht niet op verbinding)
 void setupWiFi() {
   Serial.println("\nWiFi verbinding configureren...");
   
-  // Ophalen van SSID en wachtwoord uit SettingsImpl.cpp
-  extern const char* ssid;
-  extern const char* password;
   extern bool useStaticIP;
   extern IPAddress staticIP;
   extern IPAddress gateway;
@@ -57,71 +296,179 @@ void setupWiFi() {
     }
   }
   
-  // Verbinden met WiFi netwerk
-  Serial.print("Verbinden met WiFi netwerk: ");
-  Serial.println(ssid);
-  
-  WiFi.setAutoReconnect(true);
-  WiFi.begin(ssid, password);
+  // Herverbinden regelt checkWiFiConnection(), niet de WiFi-stack zelf
+  WiFi.setAutoReconnect(false);
+  WiFi.onEvent(onWiFiEvent);
   
-  // Wacht maximaal 20 seconden op verbinding
-  const int maxWaitTime = 20000;
-  unsigned long startTime = millis();
+  loadWiFiCache();
   
-  while (WiFi.status() != WL_CONNECTED && millis() - startTime < maxWaitTime) {
-    delay(500);
-    Serial.print(".");
-  }
-  
-  // Controleer of we verbonden zijn
-  if (WiFi.status() == WL_CONNECTED) {
-    wifiConnectTime = millis();
-    Serial.println("\nVerbonden met WiFi!");
-    Serial.print("IP-adres: ");
-    Serial.println(WiFi.localIP());
-    Serial.print("RSSI: ");
-    Serial.print(WiFi.RSSI());
-    Serial.println(" dBm");
-  } else {
-    Serial.println("\nKon niet verbinden met WiFi. Systeem functioneert met beperkte functionaliteit.");
-    Serial.println("Zal periodiek proberen opnieuw te verbinden...");
-  }
+  startWiFiCycle();
 }
 
-// Controleer WiFi verbinding en herstel indien nodig
+// Verwerk WiFi meldingen en herstel de verbinding indien nodig (wacht nooit)
 void checkWiFiConnection() {
-  // Controleer of we verbonden zijn
-  if (WiFi.status() != WL_CONNECTED) {
-    // Als het tijd is voor een nieuwe verbindingspoging
-    if (millis() - lastReconnectAttempt > reconnectInterval) {
-      Serial.println("WiFi verbinding verbroken, opnieuw verbinden...");
-      
-      // Probeer opnieuw verbinding te maken
-      WiFi.disconnect();
-      delay(1000);
-      WiFi.reconnect();
-      
-      // Update tijdstip van laatste poging
-      lastReconnectAttempt = millis();
+  // Meldingen van de WiFi-taak ophalen
+  portENTER_CRITICAL(&wifiEventMux);
+  bool gotIp = wifiGotIpEvent;
+  bool disconnected = wifiDisconnectEvent;
+  uint8_t reason = wifiDisconnectReason;
+  wifiGotIpEvent = false;
+  wifiDisconnectEvent = false;
+  portEXIT_CRITICAL(&wifiEventMux);
+  
+  if (disconnected) {
+    lastDisconnectReason = reason;
+  }
+  
+  switch (wifiState) {
+    case WIFI_STATE_CONNECTING:
+      // WiFi.begin() verbreekt zelf een lopende poging; die melding komt soms pas na de start binnen
+      if (disconnected && millis() - wifiStateSince < WIFI_EVENT_GRACE_MS) {
+        disconnected = false;
+      }
       
-      // Wacht kort om verbinding te maken
-      for (int i = 0; i < 10; i++) {
-        if (WiFi.status() == WL_CONNECTED) {
-          Serial.println("WiFi verbinding hersteld!");
-          Serial.print("IP-adres: ");
-          Serial.println(WiFi.localIP());
-          wifiConnectTime = millis();
-          break;
+      if (gotIp && WiFi.status() == WL_CONNECTED) {
+        wifiConnects++;
+        wifiConnectTime = millis();
+        lastConnectMs = wifiConnectTime - cycleStart;
+        lastConnectDirect = attemptDirect;
+        if (attemptDirect) {
+          directConnects++;
+        } else {
+          scanConnects++;
+        }
+        if (bootToOnlineMs == 0) {
+          bootToOnlineMs = wifiConnectTime;
         }
-        delay(500);
-        Serial.print(".");
+        wifiFailStreak = 0;
+        wifiBackoffMs = 0;
+        setWiFiState(WIFI_STATE_CONNECTED);
+        saveWiFiCache();
+        Serial.print("Verbonden met WiFi in ");
+        Serial.print(lastConnectMs);
+        Serial.println(attemptDirect ? " ms (direct)" : " ms (scan)");
+        Serial.print("IP-adres: ");
+        Serial.println(WiFi.localIP());
+        Serial.print("RSSI: ");
+        Serial.print(WiFi.RSSI());
+        Serial.println(" dBm");
+      } else if (attemptDirect &&
+                 (disconnected || millis() - wifiStateSince > WIFI_DIRECT_TIMEOUT_MS)) {
+        // Accesspoint verplaatst of ander kanaal: meteen met scan verder
+        directFailures++;
+        Serial.println("Direct verbinden mislukt, opnieuw met volledige scan");
+        startWiFiAttempt(false);
+      } else if (disconnected || millis() - wifiStateSince > WIFI_CONNECT_TIMEOUT_MS) {
+        wifiFailures++;
+        scheduleWiFiRetry();
+        Serial.print("Kon niet verbinden met WiFi");
+        if (disconnected) {
+          Serial.print(" (reden ");
+          Serial.print(reason);
+          Serial.print(")");
+        }
+        Serial.print(". Systeem functioneert met beperkte functionaliteit, opnieuw over ");
+        Serial.print(wifiRetryDelay / 1000);
+        Serial.println(" s.");
+      }
+      break;
+      
+    case WIFI_STATE_CONNECTED:
+      if (disconnected || WiFi.status() != WL_CONNECTED) {
+        wifiDrops++;
+        Serial.print("WiFi verbinding verbroken (reden ");
+        Serial.print(lastDisconnectReason);
+        Serial.println("), opnieuw verbinden...");
+        // Niet direct: na een herstart van het accesspoint zouden alle controllers tegelijk komen
+        wifiRetryDelay = randomDelay(0, WIFI_BACKOFF_BASE_MS);
+        setWiFiState(WIFI_STATE_WAITING);
       }
+      break;
       
-      if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("Kon WiFi verbinding niet herstellen. Probeer later opnieuw.");
+    case WIFI_STATE_WAITING:
+      if (millis() - wifiStateSince >= wifiRetryDelay) {
+        startWiFiCycle();
       }
+      break;
+      
+    default:
+      break;
+  }
+  
+  #if defined(ENABLE_FLOW_SENSOR) && ENABLE_FLOW_SENSOR == true && defined(ENABLE_EMAIL_NOTIFICATION) && ENABLE_EMAIL_NOTIFICATION == true
+    // Verstuur bewaarde waarschuwingen zodra de verbinding (weer) beschikbaar is
+    static bool wasConnected = false;
+    bool connected = (wifiState == WIFI_STATE_CONNECTED);
+    if (connected && !wasConnected) {
+      emailOutboxOnReconnect();
     }
+    wasConnected = connected;
+    
+    if (connected) {
+      processEmailOutbox();
+    }
+  #endif
+}
+
+WiFiState getWiFiState() {
+  return wifiState;
+}
+
+// Seconden tot de volgende ronde, 0 als er niet gewacht wordt
+unsigned long getWiFiRetryIn() {
+  if (wifiState != WIFI_STATE_WAITING) {
+    return 0;
   }
+  unsigned long waited = millis() - wifiStateSince;
+  return waited >= wifiRetryDelay ? 0 : (wifiRetryDelay - waited + 999) / 1000;
+}
+
+const char* getWiFiStateName() {
+  switch (wifiState) {
+    case WIFI_STATE_CONNECTING: return "verbinden";
+    case WIFI_STATE_CONNECTED: return "verbonden";
+    case WIFI_STATE_WAITING: return "wachten";
+    default: return "uit";
+  }
+}
+
+// Toestand en statistieken van de verbinding
+String getWiFiJson() {
+  DynamicJsonDocument doc(1024);
+  
+  doc["state"] = getWiFiStateName();
+  doc["timeInState"] = (millis() - wifiStateSince) / 1000;
+  doc["attempts"] = wifiAttempts;
+  doc["failures"] = wifiFailures;
+  doc["connects"] = wifiConnects;
+  doc["drops"] = wifiDrops;
+  doc["lastDisconnectReason"] = lastDisconnectReason;
+  doc["failStreak"] = wifiFailStreak;
+  doc["backoff"] = wifiBackoffMs / 1000;
+  doc["retryIn"] = getWiFiRetryIn();
+  if (wifiState == WIFI_STATE_CONNECTED) {
+    doc["ip"] = WiFi.localIP().toString();
+    doc["rssi"] = WiFi.RSSI();
+  }
+  
+  // Direct verbinden met het bekende accesspoint
+  doc["bootToOnlineMs"] = bootToOnlineMs;
+  doc["lastConnectMs"] = lastConnectMs;
+  doc["lastConnectMode"] = lastConnectMs == 0 ? "" : (lastConnectDirect ? "direct" : "scan");
+  doc["directConnects"] = directConnects;
+  doc["directFailures"] = directFailures;
+  doc["scanConnects"] = scanConnects;
+  
+  JsonObject cache = doc.createNestedObject("cache");
+  cache["source"] = wifiCacheSource;
+  if (wifiCacheValid(wifiCache)) {
+    cache["bssid"] = formatBssid(wifiCache.bssid);
+    cache["channel"] = wifiCache.channel;
+  }
+  
+  String json;
+  serializeJson(doc, json);
+  return json;
 }
 
 // Haal WiFi-signaalsterkte op als string
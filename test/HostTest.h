@@ -0,0 +1,54 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/HostTest.h
+ *
+ * Minimale testhulp voor de PC-tests: CHECK telt fouten en meldt de regel,
+ * testResult() geeft de exitcode voor make.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+inline int hostTestChecks = 0;
+inline int hostTestFailures = 0;
+
+#define CHECK(condition) \
+  do { \
+    hostTestChecks++; \
+    if (!(condition)) { \
+      hostTestFailures++; \
+      printf("  FOUT %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+  do { \
+    hostTestChecks++; \
+    double hostValue = (value); \
+    if (fabs(hostValue - (expected)) > (tolerance)) { \
+      hostTestFailures++; \
+      printf("  FOUT %s:%d: %s = %g, verwacht %g (+/- %g)\n", __FILE__, __LINE__, #value, \
+             hostValue, (double)(expected), (double)(tolerance)); \
+    } \
+  } while (0)
+
+inline int testResult(const char* name) {
+  printf("%s: %d controles, %d fouten\n", name, hostTestChecks, hostTestFailures);
+  return hostTestFailures == 0 ? 0 : 1;
+}
+
+#endif // HOST_TEST_H
@@ -0,0 +1,148 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/bench_email_session.cpp
+ *
+ * Verbindingskosten per e-mail met en zonder hergebruik van de SMTP-sessie.
+ * De echte e-mail taak en outbox versturen tegen de nagebootste server uit
+ * stubs/ESP_Mail_Client.h, met deze aangenomen tijden voor de ESP32:
+ *   - TCP-verbinding 100 ms, volledige TLS-handshake 1500 ms, inloggen 300 ms
+ *   - verzenden van één bericht 400 ms
+ * Zonder hergebruik sluit de server de sessie na elk bericht, zoals de
+ * firmware deed voordat de sessie openbleef. Twee reeksen: vier
+ * waarschuwingen tegelijk in de wachtrij, en een outbox met zes bewaarde
+ * waarschuwingen die na herstel van de WiFi wordt geleegd.
+ *
+ * Een TLS-sessie hervatten (ticket of sessie-ID) zit er niet bij: dat kan
+ * ESP_Mail_Client niet, zie EmailNotification.cpp.
+ */
+
+#include "HostTest.h"
+#include "EmailNotification.h"
+#include "EmailOutbox.h"
+#include <WiFi.h>
+
+// Wat de e-mail modules buiten de e-mail nodig hebben
+TempSettings settings;
+float currentTemp = 21.5;
+float flowRate = 4.0;
+float totalLiters = 120.0;
+
+#define TICK_MS 100
+#define GIVE_UP_MS 600000UL
+
+// Uitslag van één reeks
+struct SessionRun {
+  unsigned long mails = 0;
+  unsigned long connects = 0;
+  unsigned long connectMs = 0;       // Totale tijd in connect()
+  unsigned long totalMs = 0;         // Van het eerste bericht tot het laatste verzonden is
+};
+
+static EmailJob makeJob(int i) {
+  EmailJob job = {};
+  snprintf(job.subject, sizeof(job.subject), "Waarschuwing %d", i);
+  strcpy(job.body, "Test");
+  job.queuedAt = millis();
+  return job;
+}
+
+// Begin met een gesloten sessie en een lege teller bij de server
+static void resetServer(bool reuse) {
+  hostRunTasks(60000);
+  hostSmtp.connects = 0;
+  hostSmtp.connectMs = 0;
+  hostSmtp.subjects.clear();
+  hostSmtp.closeAfterMail = !reuse;
+}
+
+static SessionRun finish(unsigned long start) {
+  SessionRun run;
+  run.mails = hostSmtp.subjects.size();
+  run.connects = hostSmtp.connects;
+  run.connectMs = hostSmtp.connectMs;
+  run.totalMs = hostMillis - start;
+  return run;
+}
+
+// Vier waarschuwingen tegelijk in de wachtrij
+static SessionRun runBurst(bool reuse) {
+  resetServer(reuse);
+  unsigned long start = hostMillis;
+  for (int i = 0; i < 4; i++) {
+    enqueueEmailJob(makeJob(i));
+  }
+  while (hostSmtp.subjects.size() < 4 && hostMillis - start < GIVE_UP_MS) {
+    hostRunTasks(TICK_MS);
+  }
+  return finish(start);
+}
+
+// Zes waarschuwingen in de outbox, daarna komt de WiFi terug
+static SessionRun runOutbox(bool reuse) {
+  resetServer(reuse);
+  WiFi.hostStatus = WL_DISCONNECTED;
+  for (int i = 0; i < OUTBOX_SLOTS; i++) {
+    emailOutboxStore(makeJob(10 + i));
+  }
+  WiFi.hostStatus = WL_CONNECTED;
+  emailOutboxOnReconnect();
+  
+  unsigned long start = hostMillis;
+  while (getEmailOutboxCount() > 0 && hostMillis - start < GIVE_UP_MS) {
+    processEmailOutbox();
+    hostRunTasks(TICK_MS);
+  }
+  return finish(start);
+}
+
+static void report(const char* name, const SessionRun& run) {
+  printf("%-26s %9lu %12lu %14lu %11.1f\n", name, run.mails, run.connects,
+         run.mails > 0 ? run.connectMs / run.mails : 0, run.totalMs / 1000.0);
+}
+
+int main() {
+  strcpy(settings.emailUsername, "kas@example.nl");
+  strcpy(settings.emailPassword, "geheim-wachtwoord");
+  strcpy(settings.emailRecipient, "teler@example.nl");
+  hostMillis = 1000;
+  WiFi.hostStatus = WL_CONNECTED;
+  setupEmailNotification();
+  CHECK(emailClientReady);
+  
+  printf("%-26s %9s %12s %14s %11s\n", "", "berichten", "verbindingen", "verbinden (ms)", "totaal (s)");
+  
+  SessionRun burstOld = runBurst(false);
+  report("wachtrij, zonder", burstOld);
+  SessionRun burst = runBurst(true);
+  report("wachtrij, met hergebruik", burst);
+  
+  SessionRun outboxOld = runOutbox(false);
+  report("outbox, zonder", outboxOld);
+  SessionRun outbox = runOutbox(true);
+  report("outbox, met hergebruik", outbox);
+  printf("(verbinden: gemiddelde tijd in connect() per bericht)\n");
+  
+  // Met hergebruik één TLS-handshake per reeks
+  CHECK(burstOld.mails == 4 && burst.mails == 4);
+  CHECK(burstOld.connects == 4);
+  CHECK(burst.connects == 1);
+  CHECK(burst.totalMs < burstOld.totalMs);
+  CHECK(outboxOld.mails == OUTBOX_SLOTS && outbox.mails == OUTBOX_SLOTS);
+  CHECK(outboxOld.connects == OUTBOX_SLOTS);
+  CHECK(outbox.connects == 1);
+  CHECK(outbox.totalMs <= outboxOld.totalMs);
+  
+  return testResult("bench_email_session");
+}
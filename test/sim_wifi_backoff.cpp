@@ -0,0 +1,264 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/sim_wifi_backoff.cpp
+ *
+ * Simulatie van een kas met meerdere controllers waarvan het accesspoint een
+ * tijd wegvalt. Elke controller draait de echte toestandsmachine uit
+ * WiFiManager.cpp (in een eigen proces, zodat de statische toestand per
+ * controller apart is) tegen een gesimuleerd accesspoint:
+ *   - onbereikbaar: een directe poging krijgt geen antwoord (WiFiManager geeft
+ *     hem na 5 s op), een poging met scan meldt na 3 s "geen AP gevonden"
+ *   - bereikbaar: direct verbonden na 0,3 s, met scan na 2,5 s
+ * Ter vergelijking wordt de firmware van vóór de backoff nagebootst: direct
+ * na het wegvallen opnieuw, daarna elke 30 s een ronde.
+ *
+ * Controleert dat de backoff minder pogingen doet en een lagere piek geeft
+ * dan de vaste wachttijd, en dat elke controller na terugkomst van het
+ * accesspoint binnen RECOVERY_LIMIT_MS weer verbonden is. Zonder argumenten
+ * voor een uitval van 2, 10 en 30 minuten.
+ *
+ * Gebruik: sim_wifi_backoff [controllers] [uitval in s] [seed]
+ */
+
+#include "HostTest.h"
+#include "Settings.h"
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Wat WiFiManager.cpp buiten de WiFi-stack nodig heeft
+TempSettings settings;
+const char* ssid = "Kas";
+const char* password = "wachtwoord";
+bool useStaticIP = false;
+IPAddress staticIP;
+IPAddress gateway;
+IPAddress subnet;
+IPAddress dns;
+void emailOutboxOnReconnect() {}
+void processEmailOutbox() {}
+
+#define TICK_MS 10
+#define SETTLE_MS 60000UL        // Eerst verbinden en rustig draaien, dan valt het accesspoint weg
+#define AFTER_MS 900000UL        // Na terugkomst van het accesspoint nog zo lang volgen
+#define DIRECT_OK_MS 300
+#define SCAN_OK_MS 2500
+#define SCAN_FAIL_MS 3000
+#define OLD_RETRY_MS 30000UL     // Vaste wachttijd van de firmware zonder backoff
+#define RECOVERY_LIMIT_MS 70000  // Wachttijd van hooguit 1 minuut plus een mislukte en een geslaagde scan
+
+// Wat één controller meldt: starttijden van pogingen (ms na het wegvallen) en hersteltijd
+struct ControllerRun {
+  std::vector<long> attempts;
+  long recoveredMs = -1;         // Na terugkomst van het accesspoint, -1 = niet gelukt
+};
+
+// Eén controller met de echte WiFiManager.cpp; draait in een eigen proces
+static ControllerRun runController(unsigned seed, unsigned long outageMs) {
+  ControllerRun run;
+  srand(seed);
+  hostMillis = 0;
+  
+  unsigned long dropAt = SETTLE_MS;
+  unsigned long backAt = dropAt + outageMs;
+  unsigned long endAt = backAt + AFTER_MS;
+  unsigned long seen = 0;
+  bool pending = false;
+  bool dropped = false;
+  
+  setupWiFi();
+  
+  while (hostMillis < endAt) {
+    hostMillis += TICK_MS;
+    bool apUp = hostMillis < dropAt || hostMillis >= backAt;
+    
+    if (!dropped && hostMillis >= dropAt) {
+      dropped = true;
+      if (WiFi.status() == WL_CONNECTED) {
+        WiFi.hostEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 200);   // Beacon time-out
+      }
+      pending = false;
+    }
+    
+    // Nieuwe poging van WiFiManager
+    if (WiFi.hostAttempts != seen) {
+      seen = WiFi.hostAttempts;
+      pending = true;
+      if (dropped) {
+        run.attempts.push_back((long)(hostMillis - dropAt));
+      }
+    }
+    
+    // Antwoord van het accesspoint
+    if (pending) {
+      unsigned long elapsed = hostMillis - WiFi.hostAttemptStart;
+      if (apUp && elapsed >= (WiFi.hostAttemptDirect ? DIRECT_OK_MS : SCAN_OK_MS)) {
+        WiFi.hostEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+        pending = false;
+      } else if (!apUp && !WiFi.hostAttemptDirect && elapsed >= SCAN_FAIL_MS) {
+        WiFi.hostEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 201);   // Geen AP gevonden
+        pending = false;
+      }
+    }
+    
+    checkWiFiConnection();
+    
+    if (dropped && hostMillis >= backAt && getWiFiState() == WIFI_STATE_CONNECTED) {
+      run.recoveredMs = hostMillis - backAt;
+      break;
+    }
+  }
+  return run;
+}
+
+// Nabootsing van de vaste wachttijd: elke ronde is direct (5 s) plus scan (3 s)
+static ControllerRun runFixedController(unsigned long outageMs) {
+  ControllerRun run;
+  long round = 0;
+  
+  while (true) {
+    if (round >= (long)outageMs) {
+      run.attempts.push_back(round);
+      run.recoveredMs = round - outageMs + DIRECT_OK_MS;
+      return run;
+    }
+    run.attempts.push_back(round);
+    if (round + 5000 >= (long)outageMs) {
+      // Accesspoint komt terug tijdens de directe poging: de scan lukt
+      run.attempts.push_back(round + 5000);
+      run.recoveredMs = round + 5000 + SCAN_OK_MS - outageMs;
+      return run;
+    }
+    run.attempts.push_back(round + 5000);
+    round += 5000 + SCAN_FAIL_MS + OLD_RETRY_MS;
+  }
+}
+
+// Controller in een kindproces draaien en de uitslag via een pipe ophalen
+static ControllerRun forkController(unsigned seed, unsigned long outageMs) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    exit(1);
+  }
+  
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    ControllerRun run = runController(seed, outageMs);
+    long count = run.attempts.size();
+    if (write(fds[1], &run.recoveredMs, sizeof(long)) < 0 ||
+        write(fds[1], &count, sizeof(long)) < 0 ||
+        (count > 0 && write(fds[1], run.attempts.data(), count * sizeof(long)) < 0)) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  
+  close(fds[1]);
+  ControllerRun run;
+  long count = 0;
+  FILE* in = fdopen(fds[0], "rb");
+  if (fread(&run.recoveredMs, sizeof(long), 1, in) == 1 && fread(&count, sizeof(long), 1, in) == 1) {
+    run.attempts.resize(count);
+    if (count > 0 && fread(run.attempts.data(), sizeof(long), count, in) != (size_t)count) {
+      run.attempts.clear();
+    }
+  }
+  fclose(in);
+  waitpid(pid, nullptr, 0);
+  return run;
+}
+
+// Samenvatting over alle controllers
+struct Summary {
+  long total = 0;
+  long duringOutage = 0;
+  int peak = 0;                  // Meeste pogingen in één seconde
+  long worst = 0;                // Langste hersteltijd (ms)
+  int failed = 0;                // Niet verbonden voor het einde van de simulatie
+};
+
+static Summary report(const char* name, const std::vector<ControllerRun>& runs, unsigned long outageMs) {
+  Summary summary;
+  double sum = 0;
+  std::vector<int> perSecond((outageMs + AFTER_MS) / 1000 + 1, 0);
+  
+  for (const ControllerRun& run : runs) {
+    for (long t : run.attempts) {
+      summary.total++;
+      if (t < (long)outageMs) {
+        summary.duringOutage++;
+      }
+      if (t / 1000 < (long)perSecond.size()) {
+        perSecond[t / 1000]++;
+      }
+    }
+    if (run.recoveredMs < 0) {
+      summary.failed++;
+    } else {
+      sum += run.recoveredMs;
+      summary.worst = std::max(summary.worst, run.recoveredMs);
+    }
+  }
+  
+  summary.peak = *std::max_element(perSecond.begin(), perSecond.end());
+  int recovered = runs.size() - summary.failed;
+  printf("%-14s %9ld %14ld %12d %12.0f %12.0f", name, summary.total, summary.duringOutage, summary.peak,
+         recovered > 0 ? sum / recovered / 1000.0 : 0.0, summary.worst / 1000.0);
+  if (summary.failed) {
+    printf("  (%d niet verbonden)", summary.failed);
+  }
+  printf("\n");
+  return summary;
+}
+
+// Eén uitval voor alle controllers, met en zonder backoff
+static void runScenario(int controllers, unsigned long outageMs, unsigned seed) {
+  printf("%d controllers, accesspoint %lu s onbereikbaar\n", controllers, outageMs / 1000);
+  printf("%-14s %9s %14s %12s %12s %12s\n", "", "pogingen", "tijdens uitval", "piek per s",
+         "herstel gem", "herstel max");
+  
+  std::vector<ControllerRun> fixed;
+  std::vector<ControllerRun> backoff;
+  for (int i = 0; i < controllers; i++) {
+    fixed.push_back(runFixedController(outageMs));
+    backoff.push_back(forkController(seed * 1000 + i, outageMs));
+  }
+  
+  Summary old = report("vast 30 s", fixed, outageMs);
+  Summary now = report("backoff", backoff, outageMs);
+  printf("\n");
+  
+  CHECK(now.failed == 0);
+  CHECK(now.worst <= RECOVERY_LIMIT_MS);
+  CHECK(now.peak < old.peak || controllers == 1);
+  // Bij een korte uitval valt er weinig te sparen
+  CHECK(now.duringOutage < old.duringOutage || outageMs < 120000);
+}
+
+int main(int argc, char** argv) {
+  int controllers = argc > 1 ? atoi(argv[1]) : 20;
+  unsigned seed = argc > 3 ? atoi(argv[3]) : 1;
+  
+  if (argc > 2) {
+    runScenario(controllers, atol(argv[2]) * 1000UL, seed);
+  } else {
+    for (unsigned long outage : { 120, 600, 1800 }) {
+      runScenario(controllers, outage * 1000UL, seed);
+    }
+  }
+  return testResult("sim_wifi_backoff");
+}
@@ -0,0 +1,150 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/sim_wifi_connect.cpp
+ *
+ * Tijd van opstarten tot online, direct naar het bewaarde accesspoint tegen
+ * een volledige scan. De echte WiFiManager.cpp start een reeks keren op
+ * tegen een gesimuleerd accesspoint, met dezelfde tijden als
+ * sim_wifi_backoff.cpp (tot het IP-adres er is):
+ *   - direct naar het juiste accesspoint op het juiste kanaal: 0,3 s
+ *   - met scan over alle kanalen: 2,5 s
+ *   - direct naar een accesspoint dat er niet (meer) is: geen antwoord
+ * Een herstart is opnieuw setupWiFi() met een andere reset-reden. Het RTC
+ * geheugen is op de PC een gewone variabele en blijft dus staan, zoals op de
+ * ESP32; bij een reset door stroomuitval negeert WiFiManager het.
+ *
+ * Ter vergelijking: de firmware van vóór de cache scande bij elke start.
+ */
+
+#include "HostTest.h"
+#include "Settings.h"
+#include <Preferences.h>
+
+// Wat WiFiManager.cpp buiten de WiFi-stack nodig heeft
+TempSettings settings;
+const char* ssid = "Kas";
+const char* password = "wachtwoord";
+bool useStaticIP = false;
+IPAddress staticIP;
+IPAddress gateway;
+IPAddress subnet;
+IPAddress dns;
+void emailOutboxOnReconnect() {}
+void processEmailOutbox() {}
+
+#define TICK_MS 10
+#define DIRECT_OK_MS 300
+#define SCAN_OK_MS 2500
+#define DIRECT_TIMEOUT_MS 5000   // WIFI_DIRECT_TIMEOUT_MS in WiFiManager.cpp
+#define GIVE_UP_MS 60000UL
+
+// Uitslag van één keer opstarten
+struct BootRun {
+  long onlineMs = -1;            // Van setupWiFi() tot verbonden, -1 = niet gelukt
+  bool direct = false;           // Verbonden via de directe poging
+  unsigned long attempts = 0;
+  long nvsWrites = 0;            // Schrijfacties naar NVS tijdens het opstarten
+};
+
+// Start WiFiManager opnieuw en beantwoord de pogingen tot hij verbonden is
+static BootRun boot(esp_reset_reason_t reason) {
+  BootRun run;
+  hostResetReason = reason;
+  hostMillis = 0;
+  WiFi.hostStatus = WL_DISCONNECTED;
+  WiFi.hostAttempts = 0;
+  long writesBefore = hostNvsWrites;
+  unsigned long seen = 0;
+  bool pending = false;
+  
+  setupWiFi();
+  
+  while (hostMillis < GIVE_UP_MS) {
+    hostMillis += TICK_MS;
+    
+    if (WiFi.hostAttempts != seen) {
+      seen = WiFi.hostAttempts;
+      pending = true;
+    }
+    
+    // Direct alleen als accesspoint en kanaal kloppen; anders geen antwoord
+    if (pending) {
+      unsigned long elapsed = hostMillis - WiFi.hostAttemptStart;
+      bool reachable = !WiFi.hostAttemptDirect ||
+                       (WiFi.hostAttemptChannel == WiFi.hostChannel &&
+                        memcmp(WiFi.hostAttemptBssid, WiFi.hostBssid, sizeof(WiFi.hostBssid)) == 0);
+      if (reachable && elapsed >= (WiFi.hostAttemptDirect ? DIRECT_OK_MS : SCAN_OK_MS)) {
+        WiFi.hostEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+        pending = false;
+      }
+    }
+    
+    checkWiFiConnection();
+    
+    if (getWiFiState() == WIFI_STATE_CONNECTED) {
+      run.onlineMs = hostMillis;
+      run.direct = WiFi.hostAttemptDirect;
+      break;
+    }
+  }
+  run.attempts = WiFi.hostAttempts;
+  run.nvsWrites = hostNvsWrites - writesBefore;
+  return run;
+}
+
+static void report(const char* name, const BootRun& run) {
+  printf("%-34s %8s %10.1f %10.1f %8lu\n", name, run.direct ? "direct" : "scan",
+         run.onlineMs / 1000.0, SCAN_OK_MS / 1000.0, run.attempts);
+}
+
+int main() {
+  hostNvs.clear();
+  printf("%-34s %8s %10s %10s %8s\n", "", "manier", "online (s)", "zonder (s)", "pogingen");
+  
+  // Nog niets bewaard: volledige scan, daarna accesspoint en kanaal in RTC en NVS
+  BootRun first = boot(ESP_RST_POWERON);
+  report("eerste start, geen cache", first);
+  CHECK(!first.direct);
+  CHECK(first.onlineMs <= SCAN_OK_MS + TICK_MS);
+  CHECK(first.nvsWrites == 1);
+  
+  BootRun restart = boot(ESP_RST_SW);
+  report("herstart, cache in RTC", restart);
+  CHECK(restart.direct);
+  CHECK(restart.onlineMs <= DIRECT_OK_MS + TICK_MS);
+  CHECK(restart.nvsWrites == 0);   // Niets veranderd, niets naar flash
+  
+  BootRun power = boot(ESP_RST_POWERON);
+  report("stroomuitval, cache in NVS", power);
+  CHECK(power.direct);
+  CHECK(power.onlineMs <= DIRECT_OK_MS + TICK_MS);
+  
+  // Accesspoint vervangen en op een ander kanaal: directe poging loopt vast, dan de scan
+  WiFi.hostBssid[5] = 0x02;
+  WiFi.hostChannel = 11;
+  BootRun moved = boot(ESP_RST_SW);
+  report("accesspoint vervangen, ander kanaal", moved);
+  CHECK(!moved.direct);
+  CHECK(moved.attempts == 2);
+  CHECK(moved.onlineMs <= DIRECT_TIMEOUT_MS + SCAN_OK_MS + 2 * TICK_MS);
+  CHECK(moved.nvsWrites == 1);
+  
+  BootRun after = boot(ESP_RST_SW);
+  report("herstart daarna", after);
+  CHECK(after.direct);
+  CHECK(after.onlineMs <= DIRECT_OK_MS + TICK_MS);
+  
+  return testResult("sim_wifi_connect");
+}
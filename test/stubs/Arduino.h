@@ -0,0 +1,145 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/Arduino.h
+ *
+ * Minimale vervanging van de Arduino core om modules van de sketch op een PC
+ * te compileren. Alleen wat de geteste modules gebruiken; de tijd staat stil
+ * tenzij de test hostMillis zelf verzet.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string>
+#include <algorithm>
+
+// "timezone" botst met de glibc variabele van dezelfde naam
+#define timezone sketch_timezone
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define PROGMEM
+#define F(x) (x)
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+#define FALLING 2
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+template<class T> T constrain(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+
+// Gesimuleerde tijd, door de test te verzetten
+inline unsigned long hostMillis = 0;
+inline unsigned long millis() { return hostMillis; }
+inline unsigned long micros() { return hostMillis * 1000UL; }
+inline void delay(unsigned long ms) { hostMillis += ms; }
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return LOW; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+
+inline uint32_t esp_random() { return ((uint32_t)rand() << 16) ^ (uint32_t)rand(); }
+inline long random(long high) { return high > 0 ? esp_random() % high : 0; }
+inline long random(long low, long high) { return low + random(high - low); }
+
+class String {
+ public:
+  std::string s;
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& x) : s(x) {}
+  String(int v) : s(std::to_string(v)) {}
+  String(unsigned v) : s(std::to_string(v)) {}
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v) : s(std::to_string(v)) {}
+  String(long long v) : s(std::to_string(v)) {}
+  String(unsigned long long v) : s(std::to_string(v)) {}
+  String(float v, int = 2) : s(std::to_string(v)) {}
+  String(double v, int = 2) : s(std::to_string(v)) {}
+  const char* c_str() const { return s.c_str(); }
+  size_t length() const { return s.size(); }
+  bool reserve(size_t n) { s.reserve(n); return true; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator!=(const String& o) const { return s != o.s; }
+  int toInt() const { return atoi(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  bool isEmpty() const { return s.empty(); }
+  bool startsWith(const char* p) const { return s.rfind(p, 0) == 0; }
+  bool equals(const char* p) const { return s == p; }
+  String substring(int a, int b = -1) const { return String(s.substr(a, b < 0 ? std::string::npos : b - a)); }
+  int indexOf(char c) const { size_t p = s.find(c); return p == std::string::npos ? -1 : (int)p; }
+};
+inline String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+inline String operator+(const String& a, const char* b) { return String(a.s + b); }
+inline String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+
+// Seriële uitvoer wordt weggegooid, zodat alleen de testresultaten zichtbaar zijn
+class Print {
+ public:
+  template<class T> size_t print(T) { return 0; }
+  template<class T> size_t print(T, int) { return 0; }
+  template<class T> size_t println(T) { return 0; }
+  template<class T> size_t println(T, int) { return 0; }
+  size_t println() { return 0; }
+  size_t printf(const char*, ...) { return 0; }
+  size_t write(const uint8_t*, size_t) { return 0; }
+};
+class HardwareSerial : public Print {
+ public:
+  void begin(long) {}
+};
+inline HardwareSerial Serial;
+
+class IPAddress {
+ public:
+  uint32_t addr = 0;
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t value) : addr(value) {}
+  operator uint32_t() const { return addr; }
+  uint8_t operator[](int i) const { return (addr >> (8 * i)) & 0xFF; }
+  String toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+  }
+};
+
+#include "esp_stubs.h"
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,217 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/ArduinoJson.h
+ *
+ * JSON-documenten die alleen onthouden wat erin gezet wordt, zodat
+ * serializeJson() de velden geeft die een module opbouwt. Lezen (as<>,
+ * operator |, deserializeJson) geeft altijd de standaardwaarde.
+ */
+
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+#include <Arduino.h>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Eén waarde, object of array; waarden staan er al als JSON-tekst in
+struct HostJsonNode {
+  enum Kind { NUL, VALUE, OBJECT, ARRAY } kind = NUL;
+  std::string value;
+  std::vector<std::pair<std::string, std::shared_ptr<HostJsonNode>>> members;
+  std::vector<std::shared_ptr<HostJsonNode>> items;
+  
+  std::shared_ptr<HostJsonNode> member(const std::string& key) {
+    if (kind != OBJECT) {
+      *this = HostJsonNode();
+      kind = OBJECT;
+    }
+    for (auto& m : members) {
+      if (m.first == key) {
+        return m.second;
+      }
+    }
+    members.emplace_back(key, std::make_shared<HostJsonNode>());
+    return members.back().second;
+  }
+  
+  std::shared_ptr<HostJsonNode> item() {
+    if (kind != ARRAY) {
+      *this = HostJsonNode();
+      kind = ARRAY;
+    }
+    items.push_back(std::make_shared<HostJsonNode>());
+    return items.back();
+  }
+  
+  // Leden die alleen gelezen zijn (nog NUL) komen niet in de uitvoer
+  std::string json() const {
+    std::string out;
+    if (kind == VALUE) {
+      return value;
+    } else if (kind == OBJECT) {
+      for (auto& m : members) {
+        if (m.second->kind != NUL) {
+          out += (out.empty() ? "\"" : ",\"") + m.first + "\":" + m.second->json();
+        }
+      }
+      return "{" + out + "}";
+    } else if (kind == ARRAY) {
+      for (auto& i : items) {
+        out += (out.empty() ? "" : ",") + i->json();
+      }
+      return "[" + out + "]";
+    }
+    return "null";
+  }
+};
+
+inline std::string hostJsonQuote(const char* text) {
+  std::string out = "\"";
+  for (; *text; text++) {
+    if (*text == '"' || *text == '\\') {
+      out += '\\';
+      out += *text;
+    } else if ((uint8_t)*text < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", (uint8_t)*text);
+      out += escape;
+    } else {
+      out += *text;
+    }
+  }
+  return out + "\"";
+}
+
+template<class T> std::string hostJsonText(const T& value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    return value ? "true" : "false";
+  } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+    return std::to_string((long long)value);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", (double)value);
+    return text;
+  } else if constexpr (std::is_same_v<T, String>) {
+    return hostJsonQuote(value.c_str());
+  } else if constexpr (std::is_convertible_v<const T&, const char*>) {
+    const char* text = value;
+    return text ? hostJsonQuote(text) : "null";
+  } else {
+    return "null";
+  }
+}
+
+class JsonArray;
+class JsonObject;
+
+class JsonVariant {
+ public:
+  JsonVariant() : node(std::make_shared<HostJsonNode>()) {}
+  JsonVariant operator[](const char* key) const { return JsonVariant(node->member(key)); }
+  JsonVariant operator[](const String& key) const { return JsonVariant(node->member(key.s)); }
+  JsonVariant operator[](int) const { return JsonVariant(); }
+  template<class T> JsonVariant& operator=(const T& value) {
+    node->kind = HostJsonNode::VALUE;
+    node->value = hostJsonText(value);
+    return *this;
+  }
+  template<class T> operator T() const { return T(); }
+  template<class T> T as() const { return T(); }
+  template<class T> bool is() const { return false; }
+  template<class T> T operator|(T fallback) const { return fallback; }
+  const char* operator|(const char* fallback) const { return fallback; }
+  bool isNull() const { return node->kind == HostJsonNode::NUL; }
+  bool containsKey(const char*) const { return false; }
+  size_t size() const { return 0; }
+  JsonArray createNestedArray(const char* key = nullptr);
+  JsonObject createNestedObject(const char* key = nullptr);
+  template<class T> bool add(T value) {
+    JsonVariant(node->item()) = value;
+    return true;
+  }
+  template<class T> T to() {
+    *node = HostJsonNode();
+    node->kind = std::is_same_v<T, JsonArray> ? HostJsonNode::ARRAY : HostJsonNode::OBJECT;
+    T result;
+    static_cast<JsonVariant&>(result).node = node;
+    return result;
+  }
+  JsonVariant* begin() const { return nullptr; }
+  JsonVariant* end() const { return nullptr; }
+  
+  std::string hostJson() const { return node->json(); }
+ 
+ protected:
+  explicit JsonVariant(std::shared_ptr<HostJsonNode> n) : node(n) {}
+  std::shared_ptr<HostJsonNode> node;
+};
+
+class JsonObject : public JsonVariant {
+ public:
+  JsonObject() {}
+  explicit JsonObject(std::shared_ptr<HostJsonNode> n) : JsonVariant(n) { n->kind = HostJsonNode::OBJECT; }
+};
+class JsonArray : public JsonVariant {
+ public:
+  JsonArray() {}
+  explicit JsonArray(std::shared_ptr<HostJsonNode> n) : JsonVariant(n) { n->kind = HostJsonNode::ARRAY; }
+  JsonObject createNestedObject() { return JsonObject(node->item()); }
+};
+inline JsonArray JsonVariant::createNestedArray(const char* key) {
+  return JsonArray(key ? node->member(key) : node->item());
+}
+inline JsonObject JsonVariant::createNestedObject(const char* key) {
+  return JsonObject(key ? node->member(key) : node->item());
+}
+
+typedef JsonVariant JsonVariantConst;
+class JsonObjectConst : public JsonVariant {
+ public:
+  JsonObjectConst() {}
+  JsonObjectConst(const JsonVariant&) {}
+};
+class JsonArrayConst : public JsonVariant {
+ public:
+  JsonArrayConst() {}
+  JsonArrayConst(const JsonVariant&) {}
+};
+
+class JsonDocument : public JsonVariant {
+ public:
+  void clear() { *node = HostJsonNode(); }
+  bool overflowed() const { return false; }
+  size_t memoryUsage() const { return 0; }
+};
+class DynamicJsonDocument : public JsonDocument {
+ public:
+  DynamicJsonDocument(size_t) {}
+};
+template<size_t N> class StaticJsonDocument : public JsonDocument {};
+
+class DeserializationError {
+ public:
+  const char* c_str() const { return "host"; }
+  explicit operator bool() const { return true; }
+};
+inline DeserializationError deserializeJson(JsonDocument&, const String&) { return DeserializationError(); }
+inline DeserializationError deserializeJson(JsonDocument&, const char*) { return DeserializationError(); }
+inline size_t serializeJson(const JsonDocument& doc, String& output) {
+  output = String(doc.hostJson());
+  return output.length();
+}
+
+#endif // HOST_ARDUINOJSON_H
@@ -0,0 +1,40 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/EEPROM.h
+ *
+ * EEPROM als geheugenbuffer, zodat een test een oud EEPROM-beeld kan laden.
+ */
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <Arduino.h>
+
+class EEPROMClass {
+ public:
+  uint8_t data[4096] = {};
+  
+  bool begin(size_t size) { return size <= sizeof(data); }
+  void end() {}
+  bool commit() { return true; }
+  uint8_t read(int address) { return data[address]; }
+  void write(int address, uint8_t value) { data[address] = value; }
+  size_t length() { return sizeof(data); }
+  template<class T> T& get(int address, T& value) { memcpy(&value, data + address, sizeof(T)); return value; }
+  template<class T> const T& put(int address, const T& value) { memcpy(data + address, &value, sizeof(T)); return value; }
+};
+inline EEPROMClass EEPROM;
+
+#endif // HOST_EEPROM_H
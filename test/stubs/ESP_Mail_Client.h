@@ -0,0 +1,132 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/ESP_Mail_Client.h
+ *
+ * ESP_Mail_Client tegen een nagebootste SMTP-server (hostSmtp). De test
+ * bepaalt hoe lang verbinden (TCP, TLS-handshake, inloggen) en verzenden
+ * duren en of een verbinding in de time-out loopt; connect() en sendMail()
+ * verzetten hostMillis met die tijd, zoals de echte calls de e-mail taak
+ * ophouden. De server houdt bij wat hij ontvangt.
+ */
+
+#ifndef HOST_ESP_MAIL_CLIENT_H
+#define HOST_ESP_MAIL_CLIENT_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Nagebootste SMTP-server
+struct HostSmtpServer {
+  // Duur van elke stap (ms)
+  unsigned long tcpMs = 100;          // TCP-verbinding
+  unsigned long tlsMs = 1500;         // Volledige TLS-handshake
+  unsigned long loginMs = 300;        // Begroeting, EHLO en AUTH
+  unsigned long sendMs = 400;         // MAIL FROM tot en met het einde van DATA
+  
+  // Script
+  int timeoutConnects = 0;            // Zoveel volgende verbindingen krijgen geen antwoord
+  bool closeAfterMail = false;        // Server sluit de sessie na elk bericht
+  
+  // Wat de server zag
+  std::string host;
+  uint16_t port = 0;
+  bool sessionOpen = false;
+  unsigned long connects = 0;         // Geslaagde verbindingen
+  unsigned long timeouts = 0;
+  unsigned long connectMs = 0;        // Totale tijd in connect(), ook de time-outs
+  std::vector<unsigned long> connectAt;   // Begin van elke verbindingspoging
+  std::vector<std::string> subjects;      // Ontvangen berichten
+};
+inline HostSmtpServer hostSmtp;
+
+struct Session_Config {
+  struct { String host_name; uint16_t port = 0; } server;
+  struct { String email; String password; String user_domain; } login;
+  struct { String ntp_server; float gmt_offset = 0; int day_light_offset = 0; } time;
+};
+
+namespace Content_Transfer_Encoding {
+  static constexpr const char* enc_7bit = "7bit";
+}
+
+enum esp_mail_smtp_priority {
+  esp_mail_smtp_priority_high = 1,
+  esp_mail_smtp_priority_normal = 3,
+  esp_mail_smtp_priority_low = 5
+};
+
+struct SMTP_Message {
+  struct { String name; String email; } sender;
+  String subject;
+  struct { String content; String charSet; String transfer_encoding; } text;
+  esp_mail_smtp_priority priority = esp_mail_smtp_priority_normal;
+  void addRecipient(const char*, const char*) {}
+};
+
+class SMTPSession {
+ public:
+  void debug(int) {}
+  void setTCPTimeout(unsigned long seconds) { timeoutSec = seconds; }
+  
+  // Geen antwoord: de verbinding wacht de hele TCP time-out
+  bool connect(Session_Config* config, bool = true) {
+    hostSmtp.host = config->server.host_name.c_str();
+    hostSmtp.port = config->server.port;
+    hostSmtp.connectAt.push_back(millis());
+    
+    if (hostSmtp.timeoutConnects > 0) {
+      hostSmtp.timeoutConnects--;
+      hostSmtp.timeouts++;
+      hostSmtp.connectMs += timeoutSec * 1000;
+      hostMillis += timeoutSec * 1000;
+      error = "Connection timeout";
+      return false;
+    }
+    
+    unsigned long duration = hostSmtp.tcpMs + hostSmtp.tlsMs + hostSmtp.loginMs;
+    hostSmtp.connectMs += duration;
+    hostMillis += duration;
+    hostSmtp.connects++;
+    hostSmtp.sessionOpen = true;
+    return true;
+  }
+  
+  bool connected() { return hostSmtp.sessionOpen; }
+  bool isLoggedIn() { return hostSmtp.sessionOpen; }
+  bool closeSession() { hostSmtp.sessionOpen = false; return true; }
+  String errorReason() { return String(error.c_str()); }
+  
+  std::string error;
+  unsigned long timeoutSec = 30;
+};
+
+class ESP_Mail_Client {
+ public:
+  bool sendMail(SMTPSession* smtp, SMTP_Message* message, bool closeSession = true) {
+    if (!hostSmtp.sessionOpen) {
+      smtp->error = "Not connected";
+      return false;
+    }
+    hostMillis += hostSmtp.sendMs;
+    hostSmtp.subjects.push_back(message->subject.c_str());
+    if (closeSession || hostSmtp.closeAfterMail) {
+      hostSmtp.sessionOpen = false;
+    }
+    return true;
+  }
+};
+inline ESP_Mail_Client MailClient;
+
+#endif // HOST_ESP_MAIL_CLIENT_H
@@ -0,0 +1,90 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/Preferences.h
+ *
+ * NVS als std::map per namespace, met een instelbare schrijffout om
+ * stroomuitval midden in een reeks schrijfacties na te bootsen.
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+// Inhoud van de "flash": sleutel is "namespace/key"
+inline std::map<std::string, std::vector<uint8_t>> hostNvs;
+inline long hostNvsWrites = 0;         // Geslaagde schrijfacties
+inline long hostNvsFailAfter = -1;     // Na zoveel schrijfacties mislukt alles (-1 = nooit)
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool = false, const char* = nullptr) { space = name; return true; }
+  void end() {}
+  bool clear() {
+    for (auto it = hostNvs.begin(); it != hostNvs.end();) {
+      it = it->first.rfind(space + "/", 0) == 0 ? hostNvs.erase(it) : std::next(it);
+    }
+    return true;
+  }
+  bool remove(const char* key) { return hostNvs.erase(path(key)) > 0; }
+  bool isKey(const char* key) { return hostNvs.count(path(key)) > 0; }
+  
+  size_t putBytes(const char* key, const void* value, size_t length) {
+    if (hostNvsFailAfter >= 0 && hostNvsWrites >= hostNvsFailAfter) {
+      return 0;
+    }
+    hostNvsWrites++;
+    hostNvs[path(key)] = std::vector<uint8_t>((const uint8_t*)value, (const uint8_t*)value + length);
+    return length;
+  }
+  size_t getBytesLength(const char* key) {
+    auto it = hostNvs.find(path(key));
+    return it == hostNvs.end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char* key, void* buffer, size_t length) {
+    auto it = hostNvs.find(path(key));
+    if (it == hostNvs.end() || it->second.size() > length) {
+      return 0;
+    }
+    memcpy(buffer, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+  
+  size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUShort(const char* key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint8_t getUChar(const char* key, uint8_t fallback = 0) { return get(key, fallback); }
+  uint16_t getUShort(const char* key, uint16_t fallback = 0) { return get(key, fallback); }
+  uint32_t getUInt(const char* key, uint32_t fallback = 0) { return get(key, fallback); }
+  
+  size_t putString(const char* key, const char* value) {
+    return putBytes(key, value, strlen(value) + 1) ? strlen(value) : 0;
+  }
+  size_t getString(const char* key, char* buffer, size_t length) { return getBytes(key, buffer, length); }
+  
+ private:
+  std::string space;
+  
+  std::string path(const char* key) { return space + "/" + key; }
+  
+  template<class T> T get(const char* key, T fallback) {
+    T value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : fallback;
+  }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,91 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/WiFi.h
+ *
+ * WiFi-stack zonder netwerk. Uit zichzelf nooit verbonden; de simulatie van
+ * het herverbinden ziet via hostAttempts welke pogingen WiFiManager.cpp
+ * start (en bij een directe poging naar welk accesspoint en kanaal) en
+ * levert de meldingen van een gesimuleerd accesspoint met hostEvent().
+ */
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+
+typedef enum { WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL = 1, WL_CONNECTED = 3, WL_CONNECT_FAILED = 4, WL_DISCONNECTED = 6 } wl_status_t;
+typedef enum { WIFI_OFF, WIFI_STA } wifi_mode_t;
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_START, ARDUINO_EVENT_WIFI_STA_CONNECTED, ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP, ARDUINO_EVENT_WIFI_STA_LOST_IP
+} arduino_event_id_t;
+typedef struct {
+  struct { uint8_t reason; } wifi_sta_disconnected;
+} arduino_event_info_t;
+typedef void (*WiFiEventFuncCb)(arduino_event_id_t, arduino_event_info_t);
+
+class WiFiClass {
+ public:
+  // Voor de simulatie: gestarte pogingen en de verbinding zoals de test die zet
+  unsigned long hostAttempts = 0;
+  unsigned long hostAttemptStart = 0;
+  bool hostAttemptDirect = false;
+  int32_t hostAttemptChannel = 0;
+  uint8_t hostAttemptBssid[6] = {};
+  wl_status_t hostStatus = WL_DISCONNECTED;
+  WiFiEventFuncCb hostCallback = nullptr;
+  uint8_t hostBssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };   // Accesspoint waarmee verbonden wordt
+  int32_t hostChannel = 6;
+  
+  // Melding van de WiFi-taak nabootsen
+  void hostEvent(arduino_event_id_t event, uint8_t reason = 0) {
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+      hostStatus = WL_CONNECTED;
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP) {
+      hostStatus = WL_DISCONNECTED;
+    }
+    if (hostCallback) {
+      arduino_event_info_t info;
+      info.wifi_sta_disconnected.reason = reason;
+      hostCallback(event, info);
+    }
+  }
+  
+  bool mode(wifi_mode_t) { return true; }
+  wl_status_t status() { return hostStatus; }
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress()) { return true; }
+  void setAutoReconnect(bool) {}
+  wl_status_t begin(const char*, const char*, int32_t channel = 0, const uint8_t* bssid = nullptr, bool = true) {
+    hostAttempts++;
+    hostAttemptStart = millis();
+    hostAttemptDirect = bssid != nullptr;
+    hostAttemptChannel = channel;
+    memcpy(hostAttemptBssid, bssid ? bssid : hostBssid, sizeof(hostAttemptBssid));
+    hostStatus = WL_DISCONNECTED;
+    return hostStatus;
+  }
+  bool disconnect(bool = false, bool = false) { hostStatus = WL_DISCONNECTED; return true; }
+  IPAddress localIP() { return hostStatus == WL_CONNECTED ? IPAddress(192, 168, 0, 50) : IPAddress(); }
+  IPAddress gatewayIP() { return IPAddress(192, 168, 0, 1); }
+  IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+  IPAddress dnsIP(uint8_t = 0) { return IPAddress(192, 168, 0, 1); }
+  int8_t RSSI() { return -60; }
+  uint8_t* BSSID() { return hostStatus == WL_CONNECTED ? hostBssid : nullptr; }
+  int32_t channel() { return hostChannel; }
+  int onEvent(WiFiEventFuncCb callback, arduino_event_id_t = ARDUINO_EVENT_WIFI_STA_START) { hostCallback = callback; return 0; }
+};
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,208 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/stubs/esp_stubs.h
+ *
+ * ESP-IDF en FreeRTOS functies die de geteste modules gebruiken.
+ */
+
+#ifndef HOST_ESP_STUBS_H
+#define HOST_ESP_STUBS_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <ucontext.h>
+#include <deque>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+inline int64_t esp_timer_get_time() { return (int64_t)hostMillis * 1000; }
+
+typedef void (*shutdown_handler_t)(void);
+inline esp_err_t esp_register_shutdown_handler(shutdown_handler_t) { return ESP_OK; }
+
+typedef enum {
+  ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO
+} esp_reset_reason_t;
+
+// Reden van de "laatste herstart", door de test in te stellen
+inline esp_reset_reason_t hostResetReason = ESP_RST_POWERON;
+inline esp_reset_reason_t esp_reset_reason() { return hostResetReason; }
+
+// Eén kern, geen taken: kritieke secties zijn leeg
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+inline void portENTER_CRITICAL(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE*) {}
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE*) {}
+
+// Grootste vrije heap-blok, door de test in te stellen
+#define MALLOC_CAP_8BIT (1 << 2)
+inline size_t hostLargestFreeBlock = 110000;
+inline size_t heap_caps_get_largest_free_block(uint32_t) { return hostLargestFreeBlock; }
+
+// FreeRTOS, één tik is 1 ms. Taken lopen coöperatief: een taak draait tot
+// hij wacht (xQueueReceive, vTaskDelay) en gaat pas verder als de test
+// hostRunTasks() aanroept. Een mutex is daardoor altijd vrij.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+struct HostQueue {
+  size_t itemSize;
+  UBaseType_t length;
+  std::deque<std::vector<uint8_t>> items;
+};
+typedef HostQueue* QueueHandle_t;
+typedef int* SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+struct HostTask {
+  ucontext_t context;
+  std::vector<char> stack;
+  TaskFunction_t function;
+  void* parameter;
+  bool started = false;
+  unsigned long wakeAt = 0;           // Verder na dit tijdstip (ULONG_MAX = nooit)
+  QueueHandle_t waitQueue = nullptr;  // Of zodra hier een bericht in staat
+};
+typedef HostTask* TaskHandle_t;
+
+inline std::vector<HostTask*> hostTasks;
+inline HostTask* hostCurrentTask = nullptr;
+inline ucontext_t hostMainContext;
+
+// Terug naar de test; de taak gaat verder als hostRunTasks() hem weer oppakt
+inline void hostTaskYield() {
+  HostTask* task = hostCurrentTask;
+  hostCurrentTask = nullptr;
+  swapcontext(&task->context, &hostMainContext);
+}
+
+inline void hostTaskEntry() {
+  HostTask* task = hostCurrentTask;
+  task->function(task->parameter);
+  task->wakeAt = ULONG_MAX;           // Een taak hoort niet te eindigen
+  task->waitQueue = nullptr;
+}
+
+// Laat de taken ms milliseconden lopen; de tijd springt naar het volgende
+// moment waarop een taak verder kan
+inline void hostRunTasks(unsigned long ms) {
+  unsigned long until = hostMillis + ms;
+  
+  for (;;) {
+    bool ran = false;
+    for (size_t i = 0; i < hostTasks.size(); i++) {
+      HostTask* task = hostTasks[i];
+      bool ready = task->wakeAt <= hostMillis || (task->waitQueue && !task->waitQueue->items.empty());
+      if (!ready) {
+        continue;
+      }
+      if (!task->started) {
+        getcontext(&task->context);
+        task->context.uc_stack.ss_sp = task->stack.data();
+        task->context.uc_stack.ss_size = task->stack.size();
+        task->context.uc_link = &hostMainContext;
+        makecontext(&task->context, hostTaskEntry, 0);
+        task->started = true;
+      }
+      hostCurrentTask = task;
+      swapcontext(&hostMainContext, &task->context);
+      ran = true;
+    }
+    if (ran) {
+      continue;
+    }
+    if (hostMillis >= until) {
+      return;
+    }
+    unsigned long next = until;
+    for (HostTask* task : hostTasks) {
+      next = std::min(next, task->wakeAt);
+    }
+    hostMillis = next;
+  }
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char*, uint32_t stackDepth,
+                                          void* parameter, UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+  HostTask* task = new HostTask();
+  task->stack.resize(std::max<uint32_t>(stackDepth, 65536));   // Op de PC ruimer dan op de ESP32
+  task->function = function;
+  task->parameter = parameter;
+  hostTasks.push_back(task);
+  if (handle) {
+    *handle = task;
+  }
+  return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  if (hostCurrentTask == nullptr) {
+    hostMillis += ticks;
+    return;
+  }
+  hostCurrentTask->wakeAt = hostMillis + ticks;
+  hostTaskYield();
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, size_t itemSize) {
+  return new HostQueue{ itemSize, length, {} };
+}
+
+// Niet wachten op ruimte: de sketch stuurt alleen met wachttijd 0
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t) {
+  if (queue->items.size() >= queue->length) {
+    return pdFALSE;
+  }
+  const uint8_t* bytes = (const uint8_t*)item;
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+  if (queue->items.empty() && wait > 0 && hostCurrentTask != nullptr) {
+    HostTask* task = hostCurrentTask;
+    task->waitQueue = queue;
+    task->wakeAt = wait == portMAX_DELAY ? ULONG_MAX : hostMillis + wait;
+    hostTaskYield();
+    task->waitQueue = nullptr;
+  }
+  if (queue->items.empty()) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) { return queue->items.size(); }
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) { return queue->length - queue->items.size(); }
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new int(0); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+
+#endif // HOST_ESP_STUBS_H
@@ -0,0 +1,176 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/test_calendar.cpp
+ *
+ * Vergelijkt de weekkalender met een eenvoudige referentie die elk venster
+ * rechtstreeks op de lokale tijd naloopt: eerst voor willekeurige vensters
+ * op elke minuut van de week, daarna een heel jaar lang via
+ * getActiveCalendarIndex() met een gesimuleerde klok, in tijdzones met
+ * zomertijd op het noordelijk en zuidelijk halfrond. Daarbij wordt ook
+ * geteld hoe vaak de kalender de klok opnieuw moet lezen.
+ */
+
+#include "HostTest.h"
+#include "Calendar.h"
+
+// Wat Calendar.cpp buiten de kalender nodig heeft
+TempSettings settings;
+void markSettingDirty(const void*) {}
+void saveSettings() {}
+void updatePumpCycleTimes() {}
+
+// Gesimuleerde klok
+static time_t hostNow = 0;
+static uint32_t hostClockGeneration = 1;
+static unsigned long hostClockReads = 0;
+
+time_t getClockEpoch() { return hostNow; }
+uint32_t getClockGeneration() { return hostClockGeneration; }
+bool getClockTime(struct tm &timeinfo) {
+  hostClockReads++;
+  localtime_r(&hostNow, &timeinfo);
+  return true;
+}
+
+// Referentie: geldt venster w op deze dag en minuut? Een venster dat over
+// middernacht loopt, begint op een ingestelde dag en eindigt de dag erna.
+static bool referenceCovers(const CalendarWindow &w, int day, int minute) {
+  int yesterday = (day + 6) % 7;
+  if (w.end > w.start) {
+    return (w.days & (1 << day)) && minute >= w.start && minute < w.end;
+  }
+  return ((w.days & (1 << day)) && minute >= w.start) ||
+         ((w.days & (1 << yesterday)) && minute < w.end);
+}
+
+// Eerste venster in de lijst dat geldt, -1 als geen
+static int reference(const CalendarWindow* windows, int count, int day, int minute) {
+  for (int i = 0; i < count; i++) {
+    if (referenceCovers(windows[i], day, minute)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static CalendarWindow window(uint8_t days, int start, int end) {
+  CalendarWindow w = {};
+  w.days = days;
+  w.start = start;
+  w.end = end;
+  w.aan = 60;
+  w.uit = 600;
+  return w;
+}
+
+// Willekeurige vensters: elke minuut van de week tegen de referentie
+static void checkRandomWindows(int sets) {
+  CalendarTransition list[CALENDAR_MAX_TRANSITIONS];
+  srand(45);
+  
+  for (int set = 0; set < sets; set++) {
+    CalendarWindow windows[CALENDAR_MAX_WINDOWS];
+    int count = 1 + rand() % CALENDAR_MAX_WINDOWS;
+    for (int i = 0; i < count; i++) {
+      // Vaak op het hele uur, zodat begin en einde van vensters samenvallen
+      int start = rand() % 2 ? (rand() % 24) * 60 : rand() % 1440;
+      int end = rand() % 2 ? (rand() % 24) * 60 : rand() % 1440;
+      windows[i] = window(1 + rand() % 127, start, end);
+    }
+    
+    int n = buildCalendarTransitions(windows, count, list);
+    int errors = 0;
+    for (int minute = 0; minute < CALENDAR_MINUTES_PER_WEEK; minute++) {
+      int expected = reference(windows, count, minute / 1440, minute % 1440);
+      int got = n > 0 ? list[findCalendarTransition(list, n, minute)].window : -1;
+      if (got != expected) {
+        errors++;
+      }
+    }
+    CHECK(errors == 0);
+    CHECK(n <= CALENDAR_MAX_TRANSITIONS);
+  }
+}
+
+// Een jaar lang elke 30 s de actieve index vergelijken; geeft het aantal klokleesacties
+static unsigned long checkYear(const char* tz, const CalendarWindow* windows, int count) {
+  setenv("TZ", tz, 1);
+  tzset();
+  hostClockGeneration++;
+  
+  String error;
+  CHECK(setCalendarWindows(windows, count, error));
+  
+  struct tm start = {};
+  start.tm_year = 2026 - 1900;
+  start.tm_mday = 1;
+  start.tm_isdst = -1;
+  hostNow = mktime(&start);
+  time_t stop = hostNow + 365 * 86400L;
+  hostClockReads = 0;
+  
+  int errors = 0;
+  for (; hostNow < stop; hostNow += 30) {
+    struct tm local;
+    localtime_r(&hostNow, &local);
+    int expected = reference(windows, count, local.tm_wday, local.tm_hour * 60 + local.tm_min);
+    if (getActiveCalendarIndex() != expected) {
+      if (errors < 5) {
+        char text[48];
+        strftime(text, sizeof(text), "%a %Y-%m-%d %H:%M:%S %Z", &local);
+        printf("  %s: verwacht %d, kreeg %d\n", text, expected, getActiveCalendarIndex());
+      }
+      errors++;
+    }
+  }
+  CHECK(errors == 0);
+  return hostClockReads;
+}
+
+int main() {
+  printf("Willekeurige vensters, elke minuut van de week\n");
+  checkRandomWindows(300);
+  
+  // Nacht, weekend, een venster dat door de nacht overlapt wordt en twee
+  // vensters in het uur van de zomer- en wintertijdwissel op zondag
+  CalendarWindow windows[] = {
+    window(0x7F, 22 * 60, 6 * 60),
+    window(0x41, 8 * 60, 20 * 60),
+    window(0x02, 2 * 60 + 30, 3 * 60),
+    window(0x01, 2 * 60 + 30, 2 * 60 + 45),
+    window(0x01, 2 * 60, 2 * 60 + 15),
+    window(0x3E, 12 * 60, 12 * 60),
+  };
+  int count = sizeof(windows) / sizeof(windows[0]);
+  
+  // Per week zijn er hooguit zoveel overgangen; een paar extra rond elke tijdwissel
+  CalendarTransition list[CALENDAR_MAX_TRANSITIONS];
+  unsigned long perWeek = buildCalendarTransitions(windows, count, list);
+  unsigned long limit = 53 * perWeek + 2 * 100;
+  
+  const char* zones[] = {
+    "CET-1CEST,M3.5.0,M10.5.0/3",            // Nederland
+    "EST5EDT,M3.2.0,M11.1.0",                // Noord-Amerika, wissel op een ander moment
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",          // Zuidelijk halfrond: zomertijd over de jaarwisseling
+    "UTC0",
+  };
+  for (const char* zone : zones) {
+    printf("Heel jaar in %s\n", zone);
+    unsigned long reads = checkYear(zone, windows, count);
+    CHECK(reads <= limit);
+  }
+  
+  return testResult("test_calendar");
+}
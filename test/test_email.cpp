@@ -0,0 +1,168 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/test_email.cpp
+ *
+ * De echte e-mail taak uit EmailNotification.cpp tegen de nagebootste
+ * SMTP-server uit stubs/ESP_Mail_Client.h: een bericht via de wachtrij
+ * versturen, een volle wachtrij, een herhaalpoging na een time-out en drie
+ * mislukte pogingen. Elke stap wordt gecontroleerd aan wat de server
+ * ontving en aan de velden van getEmailStatusJson().
+ */
+
+#include "HostTest.h"
+#include "EmailNotification.h"
+#include "EmailOutbox.h"
+#include "EmailTemplate.h"
+#include <WiFi.h>
+
+// Wat de e-mail modules buiten de e-mail nodig hebben
+TempSettings settings;
+float currentTemp = 21.5;
+float flowRate = 4.0;
+float totalLiters = 120.0;
+
+#define SESSION_IDLE_MS 10000    // EMAIL_SESSION_IDLE in EmailNotification.cpp
+#define RETRY_DELAY_MS 15000     // EMAIL_RETRY_DELAY
+#define TCP_TIMEOUT_MS 10000     // EMAIL_TCP_TIMEOUT
+#define CONNECT_MS (hostSmtp.tcpMs + hostSmtp.tlsMs + hostSmtp.loginMs)
+
+// Een veld op het hoogste niveau van getEmailStatusJson(), als JSON-tekst
+static std::string statusField(const char* name) {
+  std::string json = getEmailStatusJson().c_str();
+  std::string key = std::string("\"") + name + "\":";
+  size_t pos = json.find("{" + key);
+  if (pos == std::string::npos) {
+    pos = json.find("," + key);
+  }
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos += key.size() + 1;
+  size_t end = json[pos] == '"' ? json.find('"', pos + 1) + 1 : json.find_first_of(",}", pos);
+  return json.substr(pos, end - pos);
+}
+
+static long statusNumber(const char* name) {
+  return atol(statusField(name).c_str());
+}
+
+static EmailJob makeJob(const char* subject, bool isTest) {
+  EmailJob job = {};
+  strncpy(job.subject, subject, sizeof(job.subject) - 1);
+  strcpy(job.body, "Test");
+  job.isTest = isTest;
+  job.queuedAt = millis();
+  return job;
+}
+
+int main() {
+  strcpy(settings.emailUsername, "kas@example.nl");
+  strcpy(settings.emailPassword, "geheim-wachtwoord");
+  strcpy(settings.emailRecipient, "teler@example.nl");
+  hostMillis = 1000;
+  WiFi.hostStatus = WL_CONNECTED;
+  
+  setupEmailNotification();
+  hostRunTasks(0);
+  CHECK(emailClientReady);
+  CHECK(statusField("emailReady") == "true");
+  CHECK(statusNumber("queueSize") == 4);
+  
+  // Eén bericht: verbinden, verzenden en de sessie openhouden
+  printf("Testmail via de wachtrij\n");
+  CHECK(sendTestEmail());
+  CHECK(statusNumber("queued") == 1);
+  hostRunTasks(5000);
+  CHECK(hostSmtp.subjects.size() == 1);
+  CHECK(hostSmtp.subjects.back() == EMAIL_TPL_TEST_SUBJECT);
+  CHECK(hostSmtp.host == "smtp.gmail.com");
+  CHECK(hostSmtp.port == 465);
+  CHECK(statusNumber("queued") == 0);
+  CHECK(statusNumber("sent") == 1);
+  CHECK(statusNumber("failed") == 0);
+  CHECK(statusNumber("retries") == 0);
+  CHECK(statusNumber("connects") == 1);
+  CHECK(statusNumber("lastConnectMs") == (long)CONNECT_MS);
+  CHECK(statusNumber("lastSendMs") == (long)(CONNECT_MS + hostSmtp.sendMs));
+  CHECK(statusNumber("heapBlockMin") == (long)hostLargestFreeBlock);
+  CHECK(statusField("sending") == "false");
+  CHECK(statusField("sessionOpen") == "true");
+  CHECK(statusField("lastEmailError") == "\"\"");
+  
+  // Geen nieuw bericht: de taak sluit de sessie na de wachttijd
+  hostRunTasks(SESSION_IDLE_MS);
+  CHECK(!hostSmtp.sessionOpen);
+  CHECK(statusField("sessionOpen") == "false");
+  
+  // Zes berichten in één keer: vier passen, twee worden geweigerd
+  printf("Volle wachtrij\n");
+  for (int i = 0; i < 6; i++) {
+    char subject[24];
+    snprintf(subject, sizeof(subject), "Bericht %d", i);
+    CHECK(enqueueEmailJob(makeJob(subject, true)) == (i < 4));
+  }
+  CHECK(getEmailQueueSpace() == 0);
+  CHECK(statusNumber("queued") == 4);
+  CHECK(statusNumber("dropped") == 2);
+  CHECK(statusField("lastEmailError") == "\"E-mail wachtrij vol\"");
+  hostRunTasks(10000);
+  CHECK(hostSmtp.subjects.size() == 5);
+  CHECK(hostSmtp.subjects.back() == "Bericht 3");
+  CHECK(getEmailQueueSpace() == 4);
+  CHECK(statusNumber("sent") == 5);
+  CHECK(statusNumber("connects") == 2);
+  CHECK(statusNumber("sessionReuses") == 3);
+  CHECK(statusField("lastEmailError") == "\"\"");
+  hostRunTasks(SESSION_IDLE_MS);
+  
+  // Eerste verbinding krijgt geen antwoord: na de time-out en de wachttijd opnieuw
+  printf("Herhaalpoging na een time-out\n");
+  hostSmtp.timeoutConnects = 1;
+  size_t attempts = hostSmtp.connectAt.size();
+  CHECK(sendTestEmail());
+  hostRunTasks(TCP_TIMEOUT_MS);
+  CHECK(hostSmtp.timeouts == 1);
+  CHECK(statusField("sending") == "true");
+  CHECK(statusNumber("retries") == 1);
+  CHECK(statusField("lastEmailError") == "\"Kan niet verbinden met e-mailserver\"");
+  hostRunTasks(RETRY_DELAY_MS + 5000);
+  CHECK(hostSmtp.connectAt.size() == attempts + 2);
+  CHECK(hostSmtp.connectAt[attempts + 1] - hostSmtp.connectAt[attempts] == TCP_TIMEOUT_MS + RETRY_DELAY_MS);
+  CHECK(hostSmtp.subjects.size() == 6);
+  CHECK(statusNumber("sent") == 6);
+  CHECK(statusNumber("failed") == 0);
+  CHECK(statusField("sending") == "false");
+  CHECK(statusField("lastEmailError") == "\"\"");
+  hostRunTasks(SESSION_IDLE_MS);
+  
+  // Server blijft weg: drie pogingen met verdubbelde wachttijd, dan naar de outbox
+  printf("Drie pogingen zonder antwoord\n");
+  hostSmtp.timeoutConnects = 3;
+  attempts = hostSmtp.connectAt.size();
+  CHECK(enqueueEmailJob(makeJob("Flow te laag", false)));
+  hostRunTasks(3 * TCP_TIMEOUT_MS + 3 * RETRY_DELAY_MS + 5000);
+  CHECK(hostSmtp.connectAt.size() == attempts + 3);
+  CHECK(hostSmtp.connectAt[attempts + 1] - hostSmtp.connectAt[attempts] == TCP_TIMEOUT_MS + RETRY_DELAY_MS);
+  CHECK(hostSmtp.connectAt[attempts + 2] - hostSmtp.connectAt[attempts + 1] == TCP_TIMEOUT_MS + 2 * RETRY_DELAY_MS);
+  CHECK(hostSmtp.subjects.size() == 6);
+  CHECK(statusNumber("sent") == 6);
+  CHECK(statusNumber("failed") == 1);
+  CHECK(statusNumber("retries") == 3);
+  CHECK(statusField("sending") == "false");
+  CHECK(statusField("lastEmailError") == "\"Kan niet verbinden met e-mailserver\"");
+  CHECK(getEmailOutboxCount() == 1);
+  
+  return testResult("test_email");
+}
@@ -0,0 +1,198 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/test_flow_anomaly.cpp
+ *
+ * Speelt opgenomen pulsreeksen (map traces, één regel per seconde) af door
+ * de rekenkern van FlowAnomaly.cpp en controleert welke afwijkingen wanneer
+ * gemeld en weer hersteld worden. Daarnaast korte synthetische reeksen voor
+ * het inleren, de hysterese en het opnieuw leren na een blijvende drift.
+ */
+
+#include "HostTest.h"
+#include "FlowAnomaly.h"
+#include "Notification.h"
+#include <vector>
+
+// Wat FlowAnomaly.cpp buiten de rekenkern nodig heeft
+TempSettings settings;
+bool pumpActive = true;
+unsigned long pumpStartTime = 0;
+unsigned long pumpStopTime = 0;
+int notifyAlert(AlertEvent&) { return 0; }
+unsigned long getFlowCheckDelay() { return FLOW_CHECK_DELAY; }
+
+#define PULSES_PER_LITER 450.0
+
+// Verloop van één afgespeelde reeks
+struct Replay {
+  int raised[3] = {0, 0, 0};        // Aantal keer gemeld per klasse
+  long firstRaised[3] = {-1, -1, -1};
+  long lastCleared[3] = {-1, -1, -1};
+  uint8_t finalActive = 0;
+};
+
+static int bitIndex(uint8_t bit) {
+  return bit == FLOW_ANOMALY_DRIFT ? 0 : (bit == FLOW_ANOMALY_DROP ? 1 : 2);
+}
+
+static std::vector<float> loadTrace(const char* path) {
+  std::vector<float> samples;
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    printf("  Kan %s niet openen\n", path);
+    return samples;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    samples.push_back(atoi(line) * 60.0 / PULSES_PER_LITER);
+  }
+  fclose(file);
+  return samples;
+}
+
+static Replay replay(FlowStateStats &stats, const std::vector<float> &samples, long offset = 0) {
+  Replay result;
+  for (size_t i = 0; i < samples.size(); i++) {
+    uint8_t previous = stats.active;
+    uint8_t active = flowStatsUpdate(stats, samples[i]);
+    for (uint8_t bit = FLOW_ANOMALY_DRIFT; bit <= FLOW_ANOMALY_NOISE; bit <<= 1) {
+      int index = bitIndex(bit);
+      if ((active & bit) && !(previous & bit)) {
+        result.raised[index]++;
+        if (result.firstRaised[index] < 0) {
+          result.firstRaised[index] = offset + i;
+        }
+      }
+      if (!(active & bit) && (previous & bit)) {
+        result.lastCleared[index] = offset + i;
+      }
+    }
+  }
+  result.finalActive = stats.active;
+  return result;
+}
+
+static std::vector<float> constantFlow(float lpm, int seconds, float jitter, unsigned seed) {
+  std::vector<float> samples;
+  srand(seed);
+  for (int i = 0; i < seconds; i++) {
+    samples.push_back(lpm * (1.0 + jitter * ((rand() % 2001) - 1000) / 1000.0));
+  }
+  return samples;
+}
+
+// Verstoppend filter: drift wordt gemeld terwijl de stroming nog ruim boven de helft ligt
+static void testClogging() {
+  printf("Verstopping (traces/clogging.csv)\n");
+  std::vector<float> trace = loadTrace("traces/clogging.csv");
+  CHECK(trace.size() == 3900);
+  
+  FlowStateStats stats = {};
+  Replay result = replay(stats, trace);
+  
+  // 0-900 s normaal, daarna in 2400 s van 6 naar 3 L/min
+  CHECK(result.firstRaised[0] > 900);
+  CHECK(result.firstRaised[0] < 900 + 1400);   // Voor de stroming onder 4,25 L/min zakt
+  CHECK(result.raised[0] == 1);
+  CHECK(result.raised[2] == 0);
+  
+  // Zakt de stroming uiteindelijk 40% weg, dan volgt ook de val, maar pas na de drift
+  CHECK(result.raised[1] <= 1);
+  CHECK(result.raised[1] == 0 || result.firstRaised[1] > result.firstRaised[0] + 300);
+  CHECK(result.finalActive & FLOW_ANOMALY_DRIFT);
+  CHECK_NEAR(stats.baseline.mean, 6.0, 0.2);   // Verstopping is niet de nieuwe norm geworden
+}
+
+// Lucht in het systeem: ruis wordt gemeld, één keer, en na herstel weer ingetrokken
+static void testAirLock() {
+  printf("Luchtbel (traces/airlock.csv)\n");
+  std::vector<float> trace = loadTrace("traces/airlock.csv");
+  CHECK(trace.size() == 2100);
+  
+  FlowStateStats stats = {};
+  Replay result = replay(stats, trace);
+  
+  // 0-900 s normaal, 900-1200 s onrustig, daarna rustig
+  CHECK(result.firstRaised[2] >= 900);
+  CHECK(result.firstRaised[2] < 960);
+  CHECK(result.raised[2] == 1);
+  CHECK(result.lastCleared[2] > 1200);
+  CHECK(result.raised[0] == 0);
+  CHECK(result.finalActive == 0);
+  CHECK_NEAR(stats.baseline.mean, 6.0, 0.2);
+}
+
+// Een afwijkend begin (vullen van de leidingen) mag de basislijn niet vastzetten
+static void testWarmupSeed() {
+  printf("Inleren met afwijkend begin\n");
+  FlowStateStats stats = {};
+  std::vector<float> priming = constantFlow(1.5, 5, 0.0, 1);
+  std::vector<float> steady = constantFlow(6.0, 1800, 0.03, 2);
+  
+  replay(stats, priming);
+  Replay result = replay(stats, steady, priming.size());
+  
+  CHECK(result.raised[0] == 0);
+  CHECK(result.finalActive == 0);
+  CHECK_NEAR(stats.baseline.mean, 6.0, 0.1);
+}
+
+// Een gemiddelde rond de driftgrens mag het alarm niet steeds opnieuw laten afgaan
+static void testHysteresis() {
+  printf("Hysterese rond de driftgrens\n");
+  FlowStateStats stats = {};
+  replay(stats, constantFlow(6.0, 900, 0.01, 3));
+  float limit = stats.baseline.mean * (1.0 - ANOMALY_DRIFT_FRACTION);
+  
+  // Schommelt elke halve minuut 4% rond de grens
+  std::vector<float> hovering;
+  for (int i = 0; i < 1200; i++) {
+    hovering.push_back(limit * ((i / 30) % 2 == 0 ? 0.96 : 1.04));
+  }
+  Replay result = replay(stats, hovering, 900);
+  
+  CHECK(result.raised[0] == 1);
+  CHECK(result.lastCleared[0] < 0);
+}
+
+// Een blijvend ander niveau wordt na ANOMALY_RELEARN_SAMPLES alsnog geleerd
+static void testRelearn() {
+  printf("Nieuw niveau na lange rustige drift\n");
+  FlowStateStats stats = {};
+  replay(stats, constantFlow(6.0, 900, 0.03, 4));
+  Replay result = replay(stats, constantFlow(4.0, 3 * 3600, 0.03, 5), 900);
+  
+  CHECK(result.raised[0] == 1);
+  CHECK(result.firstRaised[0] < 900 + 120);
+  CHECK(result.lastCleared[0] > 900 + ANOMALY_RELEARN_SAMPLES);
+  CHECK(result.finalActive == 0);
+  CHECK_NEAR(stats.baseline.mean, 4.0, 0.5);
+  
+  // Een nieuwe afwijking ten opzichte van het nieuwe niveau wordt weer gemeld
+  result = replay(stats, constantFlow(2.5, 600, 0.03, 6));
+  CHECK(result.finalActive & FLOW_ANOMALY_DRIFT);
+}
+
+int main() {
+  testClogging();
+  testAirLock();
+  testWarmupSeed();
+  testHysteresis();
+  testRelearn();
+  return testResult("test_flow_anomaly");
+}
@@ -0,0 +1,157 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/test_flow_totals.cpp
+ *
+ * Stuurt een bekend aantal pulsen door de interruptroutine terwijl
+ * checkFlowRate() net als in loop() om de paar milliseconden draait, en
+ * controleert dat flowrate, cyclusvolume, volumetellers (ook na een herstart
+ * uit NVS) en een kalibratierun precies dat volume terugvinden.
+ */
+
+#include "HostTest.h"
+#include "FlowSensor.h"
+#include "FlowCalibration.h"
+#include "FlowTotalizer.h"
+#include "Notification.h"
+
+// Wat de flowmodules buiten de flowsensor nodig hebben
+TempSettings settings;
+bool pumpActive = false;
+unsigned long pumpStartTime = 0;
+unsigned long pumpStopTime = 0;
+int notifyAlert(AlertEvent&) { return 0; }
+void markSettingDirty(const void*) {}
+void saveSettings() {}
+
+// Tellers van FlowTotalizer.cpp, om een herstart na te bootsen
+extern double lifetimeLiters;
+extern double todayLiters;
+extern float flowFrequencyHz;
+
+#define PULSES_PER_LITER 450.0
+
+// Laat de pomp een tijd draaien met een vaste pulsfrequentie. loop() draait
+// elke 1 tot 3 ms, zoals zonder blokkerende aanroepen in de hoofdlus.
+static long runFlow(float lpm, unsigned long durationMs) {
+  double pulsesPerMs = lpm / 60.0 * PULSES_PER_LITER / 1000.0;
+  double pending = 0.0;
+  long pulses = 0;
+  unsigned long end = hostMillis + durationMs;
+  unsigned long nextLoop = hostMillis;
+  
+  while (hostMillis < end) {
+    pending += pulsesPerMs;
+    while (pending >= 1.0) {
+      flowPulseCounter();
+      pending -= 1.0;
+      pulses++;
+    }
+    if (hostMillis >= nextLoop) {
+      checkFlowRate();
+      nextLoop = hostMillis + 1 + rand() % 3;
+    }
+    hostMillis++;
+  }
+  return pulses;
+}
+
+static void startPump() {
+  pumpActive = true;
+  pumpStartTime = hostMillis;
+}
+
+static void stopPump() {
+  pumpActive = false;
+  pumpStopTime = hostMillis;
+  runFlow(0.0, 2000);    // Lopend meetvenster afronden
+}
+
+// Alle pulsen komen terug in totaal, cyclusvolume en levensduurteller
+static void testKnownVolume() {
+  printf("Bekend volume bij 6 L/min en 0,5 L/min\n");
+  double startTotal = totalLiters;
+  double startLifetime = getLifetimeLiters();
+  
+  startPump();
+  long pulses = runFlow(6.0, 10 * 60000UL);
+  CHECK_NEAR(flowRate, 6.0, 0.15);
+  CHECK_NEAR(flowFrequencyHz, 45.0, 1.0);
+  double cycleLiters = getPumpCycleLiters();
+  stopPump();
+  
+  double expected = pulses / PULSES_PER_LITER;
+  CHECK_NEAR(expected, 60.0, 0.01);
+  CHECK_NEAR(totalLiters - startTotal, expected, 0.01);
+  CHECK_NEAR(getLifetimeLiters() - startLifetime, expected, 0.01);
+  CHECK_NEAR(cycleLiters, expected, 0.2);   // Hooguit het lopende venster ontbreekt
+  
+  // Lage stroming: 3,75 Hz mag niet als een paar losse pulsen per 100 ms gemeten worden
+  startPump();
+  pulses = runFlow(0.5, 4 * 60000UL);
+  CHECK_NEAR(flowFrequencyHz, 3.75, 1.0);
+  CHECK_NEAR(flowRate, 0.5, 0.14);
+  stopPump();
+  
+  CHECK_NEAR(totalLiters - startTotal, expected + pulses / PULSES_PER_LITER, 0.01);
+}
+
+// Het weggeschreven journaal geeft na een herstart hetzelfde volume terug
+static void testPersistedTotals() {
+  printf("Volumeteller na herstart\n");
+  
+  // Na het schrijfinterval zonder nieuwe pulsen een record laten schrijven
+  startPump();
+  runFlow(3.0, 60000UL);
+  stopPump();
+  runFlow(0.0, (unsigned long)settings.totalizerIntervalMin * 60000UL + 1000);
+  double lifetime = getLifetimeLiters();
+  double sinceReset = totalLiters;
+  CHECK(getTotalizerWriteCount() > 0);
+  
+  lifetimeLiters = 0.0;
+  todayLiters = 0.0;
+  totalLiters = 0.0;
+  setupFlowTotalizer();
+  
+  CHECK_NEAR(getLifetimeLiters(), lifetime, 0.001);
+  CHECK_NEAR(totalLiters, sinceReset, 0.001);
+}
+
+// Een kalibratierun telt alle pulsen en vindt de werkelijke K-factor terug
+static void testCalibrationRun() {
+  printf("Kalibratierun\n");
+  String message;
+  
+  CHECK(startFlowCalibration());
+  startPump();
+  long pulses = runFlow(3.0, 2 * 60000UL);
+  stopPump();
+  CHECK(finishFlowCalibration(pulses / PULSES_PER_LITER, message));
+  
+  CHECK(settings.flowCalPoints == 1);
+  CHECK_NEAR(settings.flowCalK[0], PULSES_PER_LITER, 1.0);
+  CHECK_NEAR(settings.flowCalFreq[0], 22.5, 0.5);
+}
+
+int main() {
+  srand(27);
+  hostMillis = 1000;
+  setupFlowSensor();
+  
+  testKnownVolume();
+  testPersistedTotals();
+  testCalibrationRun();
+  return testResult("test_flow_totals");
+}
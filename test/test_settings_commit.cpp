@@ -0,0 +1,151 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/test_settings_commit.cpp
+ *
+ * Laat de stroom uitvallen na elke afzonderlijke NVS-schrijfactie van een
+ * opslagactie met één en met meerdere velden, en controleert na de herstart
+ * dat de instellingen helemaal oud of helemaal nieuw zijn en dat een
+ * onderbroken opslagactie niet als beschadiging (CRC-fout) wordt gezien.
+ * Daarna: een ongeldige waarde die loadSettings() herstelt, komt ook in NVS,
+ * en een wijziging die alleen in RAM staat, geeft geen CRC-fout.
+ */
+
+#include "HostTest.h"
+#include "SettingsStore.h"
+#include <Preferences.h>
+
+TempSettings settings;
+
+// NVS en instellingen zoals ze vóór de opslagactie waren
+static std::map<std::string, std::vector<uint8_t>> savedNvs;
+static TempSettings savedSettings;
+
+// Herstart: RAM kwijt, alleen NVS blijft
+static void reboot() {
+  hostNvsFailAfter = -1;
+  settings = TempSettings();
+  settingsStoreLoad();
+}
+
+// Zet de opgeslagen toestand terug en laad die, zodat ook de module zelf bij is
+static void restore() {
+  hostNvs = savedNvs;
+  reboot();
+}
+
+// Voer een opslagactie uit waarbij na 'writes' schrijfacties de stroom uitvalt
+static int commitWithPowerLoss(void (*change)(), long writes) {
+  restore();
+  change();
+  hostNvsFailAfter = hostNvsWrites + writes;
+  int result = settingsStoreCommit();
+  reboot();
+  return result;
+}
+
+static void changeName() {
+  strcpy(settings.systeemnaam, "Kas Noord");
+  markSettingDirty(&settings.systeemnaam);
+}
+
+static void changeSeveral() {
+  strcpy(settings.systeemnaam, "Kas Zuid");
+  settings.temp_laag_aan = 300;
+  settings.minFlowRate = 3.5;
+  markSettingDirty(&settings.systeemnaam);
+  markSettingDirty(&settings.temp_laag_aan);
+  markSettingDirty(&settings.minFlowRate);
+}
+
+// Stroomuitval na elke schrijfactie tot de opslagactie zonder uitval lukt
+static void checkEveryCut(const char* name, void (*change)(), bool (*isNew)(), bool (*isOld)()) {
+  printf("%s\n", name);
+  
+  for (long writes = 0; writes < 16; writes++) {
+    int result = commitWithPowerLoss(change, writes);
+    
+    // Geen beschadiging: een CRC-fout markeert alle velden om opnieuw op te slaan
+    CHECK(!hasDirtySettings());
+    // Helemaal oud of helemaal nieuw; na het journaal (eerste schrijfactie) nieuw
+    CHECK(writes == 0 ? isOld() : isNew());
+    
+    if (result >= 0) {
+      return;
+    }
+  }
+  CHECK(false);   // Opslagactie lukte nooit
+}
+
+static bool nameIsNew() { return strcmp(settings.systeemnaam, "Kas Noord") == 0; }
+static bool nameIsOld() { return strcmp(settings.systeemnaam, savedSettings.systeemnaam) == 0; }
+
+static bool severalAreNew() {
+  return strcmp(settings.systeemnaam, "Kas Zuid") == 0 && settings.temp_laag_aan == 300 &&
+         settings.minFlowRate == 3.5f;
+}
+static bool severalAreOld() {
+  return nameIsOld() && settings.temp_laag_aan == savedSettings.temp_laag_aan &&
+         settings.minFlowRate == savedSettings.minFlowRate;
+}
+
+int main() {
+  // Begin met opgeslagen standaardwaarden
+  hostNvs.clear();
+  settings = TempSettings();
+  settingsStoreLoad();
+  savedNvs = hostNvs;
+  savedSettings = settings;
+  
+  checkEveryCut("Eén veld, stroomuitval na elke schrijfactie", changeName, nameIsNew, nameIsOld);
+  checkEveryCut("Drie velden, stroomuitval na elke schrijfactie", changeSeveral, severalAreNew, severalAreOld);
+  
+  // Echte beschadiging (veld gewijzigd buiten een opslagactie) wordt wel gemeld
+  printf("Beschadigd veld zonder journaal\n");
+  restore();
+  Preferences prefs;
+  prefs.begin(SETTINGS_NAMESPACE, false);
+  prefs.remove("txn");
+  prefs.putUInt("tLaagAan", 999);
+  reboot();
+  CHECK(hasDirtySettings());
+  
+  // Ongeldige waarde in NVS: loadSettings() herstelt die en slaat het herstel op
+  printf("Hersteld veld wordt opgeslagen\n");
+  restore();
+  settings.volumeMaxAan = 5;
+  markSettingDirty(&settings.volumeMaxAan);
+  CHECK(settingsStoreCommit() >= 0);
+  settings = TempSettings();
+  loadSettings();
+  CHECK(settings.volumeMaxAan == TempSettings().volumeMaxAan);
+  CHECK(hasDirtySettings());
+  CHECK(settingsStoreCommit() >= 0);
+  reboot();
+  CHECK(!hasDirtySettings());
+  CHECK(settings.volumeMaxAan == TempSettings().volumeMaxAan);
+  
+  // Niet gemarkeerde wijziging: niet opgeslagen, en de CRC gaat over wat wel in NVS staat
+  printf("Wijziging alleen in RAM\n");
+  restore();
+  settings.temp_hoog_uit = 777;
+  changeName();
+  CHECK(settingsStoreCommit() == 1);
+  reboot();
+  CHECK(!hasDirtySettings());
+  CHECK(nameIsNew());
+  CHECK(settings.temp_hoog_uit == savedSettings.temp_hoog_uit);
+  
+  return testResult("test_settings_commit");
+}
@@ -0,0 +1,207 @@
+/*
+ * ESP32 Hydroponisch Systeem Controller
+ *
+ * Copyright (C) 2024 AXISKOM
+ * Website: https://axiskom.nl
+ *
+ * Dit programma is vrije software: je mag het herdistribueren en/of wijzigen
+ * onder de voorwaarden van de GNU General Public License zoals gepubliceerd door
+ * de Free Software Foundation, ofwel versie 3 van de licentie, of
+ * (naar jouw keuze) een latere versie.
+ *
+ * Deze software is ontwikkeld als onderdeel van het AXISKOM kennisplatform
+ * voor zelfredzaamheid en zelfvoorzienend leven.
+ *
+ * test/test_settings_migration.cpp
+ *
+ * Laadt EEPROM-beelden van 512 bytes zoals de firmware van vóór de
+ * NVS-opslag ze schreef (met en zonder flowsensor en e-mail) via
+ * settingsStoreLoad() in een lege NVS, en controleert dat elke instelling
+ * uit het beeld overkomt, dat wat niet in het beeld stond de standaardwaarde
+ * houdt (ook als er achter de oude indeling nog bytes staan) en dat een
+ * herstart daarna dezelfde waarden uit NVS leest.
+ */
+
+#include "HostTest.h"
+#include "SettingsStore.h"
+#include <Preferences.h>
+
+TempSettings settings;
+
+#define LEGACY_IMAGE_SIZE 512   // EEPROM_SIZE van de oude firmware
+
+// De oude TempSettings, per combinatie van modules waarmee gebouwd werd
+struct BaselineCore {
+  uint16_t magic = EEPROM_MAGIC;
+  int temp_laag_aan = 150;
+  int temp_laag_uit = 900;
+  int temp_midden_aan = 140;
+  int temp_midden_uit = 700;
+  int temp_hoog_aan = 130;
+  int temp_hoog_uit = 400;
+  int nacht_aan = 45;
+  int nacht_uit = 1500;
+  float temp_laag_grens = 16.5;
+  float temp_hoog_grens = 27.0;
+  char systeemnaam[32] = "Toren Zolder";
+  bool continuModus = true;
+};
+
+struct BaselineFlow : BaselineCore {
+  float minFlowRate = 2.5;
+  bool flowSensorDebug = true;
+  bool flowAlertEnabled = false;
+  int pumpCapacityLPH = 800;
+};
+
+struct BaselineFlowEmail : BaselineFlow {
+  char emailUsername[64] = "kas@example.nl";
+  char emailPassword[64] = "geheim-wachtwoord";
+  char emailRecipient[64] = "teler@example.nl";
+  bool emailDebug = true;
+};
+
+// Lege NVS en het gegeven beeld in de EEPROM-emulatie; de rest leest als 0
+template<class T> static void loadImage(const T* image) {
+  hostNvs.clear();
+  memset(EEPROM.data, 0, sizeof(EEPROM.data));
+  if (image) {
+    static_assert(sizeof(T) <= LEGACY_IMAGE_SIZE, "Beeld past niet in de oude EEPROM");
+    memcpy(EEPROM.data, image, sizeof(T));
+  }
+  settings = TempSettings();
+}
+
+// Herstart: RAM kwijt, EEPROM gewist, alleen NVS blijft
+static void reboot() {
+  memset(EEPROM.data, 0, sizeof(EEPROM.data));
+  settings = TempSettings();
+  CHECK(settingsStoreLoad());
+}
+
+static void checkCore(const BaselineCore &old) {
+  CHECK(settings.temp_laag_aan == old.temp_laag_aan);
+  CHECK(settings.temp_laag_uit == old.temp_laag_uit);
+  CHECK(settings.temp_midden_aan == old.temp_midden_aan);
+  CHECK(settings.temp_midden_uit == old.temp_midden_uit);
+  CHECK(settings.temp_hoog_aan == old.temp_hoog_aan);
+  CHECK(settings.temp_hoog_uit == old.temp_hoog_uit);
+  CHECK(settings.nacht_aan == old.nacht_aan);
+  CHECK(settings.nacht_uit == old.nacht_uit);
+  CHECK(settings.temp_laag_grens == old.temp_laag_grens);
+  CHECK(settings.temp_hoog_grens == old.temp_hoog_grens);
+  CHECK(strcmp(settings.systeemnaam, old.systeemnaam) == 0);
+  CHECK(settings.continuModus == old.continuModus);
+}
+
+static void checkFlow(const BaselineFlow &old) {
+  CHECK(settings.minFlowRate == old.minFlowRate);
+  CHECK(settings.flowSensorDebug == old.flowSensorDebug);
+  CHECK(settings.flowAlertEnabled == old.flowAlertEnabled);
+  CHECK(settings.pumpCapacityLPH == old.pumpCapacityLPH);
+}
+
+static void checkFlowDefaults() {
+  TempSettings defaults;
+  CHECK(settings.minFlowRate == defaults.minFlowRate);
+  CHECK(settings.flowAlertEnabled == defaults.flowAlertEnabled);
+  CHECK(settings.pumpCapacityLPH == defaults.pumpCapacityLPH);
+}
+
+static void checkEmail(const BaselineFlowEmail &old) {
+  CHECK(strcmp(settings.emailUsername, old.emailUsername) == 0);
+  CHECK(strcmp(settings.emailPassword, old.emailPassword) == 0);
+  CHECK(strcmp(settings.emailRecipient, old.emailRecipient) == 0);
+  CHECK(settings.emailDebug == old.emailDebug);
+}
+
+static void checkEmailDefaults() {
+  TempSettings defaults;
+  CHECK(strcmp(settings.emailUsername, defaults.emailUsername) == 0);
+  CHECK(strcmp(settings.emailRecipient, defaults.emailRecipient) == 0);
+}
+
+// Velden die pas na de oude indeling kwamen
+static void checkNewDefaults() {
+  TempSettings defaults;
+  CHECK(settings.flowCalPoints == 0);
+  CHECK(settings.totalizerIntervalMin == defaults.totalizerIntervalMin);
+  CHECK(settings.volumeModus == false);
+  CHECK(settings.temp_midden_liters == defaults.temp_midden_liters);
+  CHECK(settings.volumeMaxAan == defaults.volumeMaxAan);
+  CHECK(settings.webhookUrl[0] == '\0');
+  CHECK(settings.activeProfile[0] == '\0');
+  CHECK(settings.calendarCount == 0);
+}
+
+int main() {
+  // Geen oude instellingen: standaardwaarden, daarna gewoon NVS
+  printf("Leeg EEPROM-beeld\n");
+  loadImage<BaselineCore>(nullptr);
+  CHECK(!settingsStoreLoad());
+  CHECK(strcmp(settings.systeemnaam, TempSettings().systeemnaam) == 0);
+  CHECK(settings.temp_laag_aan == TempSettings().temp_laag_aan);
+  reboot();
+  CHECK(settings.temp_laag_uit == TempSettings().temp_laag_uit);
+  
+  printf("Flowsensor en e-mail aan\n");
+  BaselineFlowEmail full;
+  loadImage(&full);
+  CHECK(settingsStoreLoad());
+  checkCore(full);
+  checkFlow(full);
+  checkEmail(full);
+  checkNewDefaults();
+  reboot();
+  checkCore(full);
+  checkFlow(full);
+  checkEmail(full);
+  checkNewDefaults();
+  
+  printf("Flowsensor aan, e-mail uit\n");
+  BaselineFlow flow;
+  flow.minFlowRate = 0.8;
+  flow.pumpCapacityLPH = 2400;
+  loadImage(&flow);
+  CHECK(settingsStoreLoad());
+  checkCore(flow);
+  checkFlow(flow);
+  checkEmailDefaults();
+  checkNewDefaults();
+  reboot();
+  checkFlow(flow);
+  
+  printf("Flowsensor en e-mail uit\n");
+  BaselineCore core;
+  strcpy(core.systeemnaam, "Kas 2");
+  core.continuModus = false;
+  loadImage(&core);
+  CHECK(settingsStoreLoad());
+  checkCore(core);
+  checkFlowDefaults();
+  checkEmailDefaults();
+  checkNewDefaults();
+  reboot();
+  checkCore(core);
+  checkFlowDefaults();
+  
+  // Systeemnaam zonder afsluitende nul mag niet doorlopen in de volgende velden
+  printf("Systeemnaam zonder afsluitende nul\n");
+  memset(full.systeemnaam, 'x', sizeof(full.systeemnaam));
+  loadImage(&full);
+  CHECK(settingsStoreLoad());
+  CHECK(strlen(settings.systeemnaam) == sizeof(settings.systeemnaam) - 1);
+  checkFlow(full);
+  
+  // Achter de oude indeling stond nooit iets; wat daar staat wordt niet overgenomen
+  printf("Bytes achter de oude indeling\n");
+  strcpy(full.systeemnaam, "Toren Zolder");
+  loadImage(&full);
+  memset(EEPROM.data + sizeof(full), 0x5A, LEGACY_IMAGE_SIZE - sizeof(full));
+  CHECK(settingsStoreLoad());
+  checkCore(full);
+  checkEmail(full);
+  checkNewDefaults();
+  
+  return testResult("test_settings_migration");
+}